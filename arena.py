@@ -0,0 +1,65 @@
+"""
+arena.py
+
+A population of variable-length genomes packed into one contiguous buffer.
+
+Each genome occupies a row of ``stride`` bytes, zero padded past its length,
+so native routines can walk the whole population without touching Python
+objects. ``stride`` is rounded up to ``ALIGN`` bytes so rows can be read as
+whole 64-bit words (or 256-bit vectors).
+"""
+from __future__ import annotations
+
+import ctypes
+from typing import Iterator, List, Optional, Sequence
+
+import numpy as np
+
+ALIGN = 32
+
+
+class PopulationArena:
+    """Contiguous, fixed-stride storage for a population of genomes."""
+
+    def __init__(self, data: np.ndarray, lengths: np.ndarray):
+        if data.ndim != 2 or data.dtype != np.uint8:
+            raise ValueError("Arena data must be a 2D uint8 array")
+        if data.shape[1] % 8 != 0:
+            raise ValueError("Arena stride must be a multiple of 8 bytes")
+        self.data = np.ascontiguousarray(data)
+        self.lengths = np.ascontiguousarray(lengths, dtype=np.uint32)
+
+    @classmethod
+    def from_population(cls, population: Sequence[bytes], stride: Optional[int] = None) -> PopulationArena:
+        """Packs a list of genomes. Genomes longer than an explicit stride are truncated."""
+        longest = max((len(p) for p in population), default=0)
+        if stride is None:
+            stride = max(ALIGN, -(-longest // ALIGN) * ALIGN)
+        buffer = b"".join(p[:stride].ljust(stride, b"\0") for p in population)
+        data = np.frombuffer(buffer, dtype=np.uint8).reshape(len(population), stride).copy()
+        lengths = np.fromiter((min(len(p), stride) for p in population), dtype=np.uint32, count=len(population))
+        return cls(data, lengths)
+
+    @property
+    def stride(self) -> int:
+        return self.data.shape[1]
+
+    def __len__(self) -> int:
+        return self.data.shape[0]
+
+    def __getitem__(self, index: int) -> bytes:
+        return self.data[index, :self.lengths[index]].tobytes()
+
+    def __iter__(self) -> Iterator[bytes]:
+        for i in range(len(self)):
+            yield self[i]
+
+    def to_population(self) -> List[bytes]:
+        return list(self)
+
+    def data_ptr(self) -> ctypes.POINTER(ctypes.c_uint8):
+        """Pointer to the first row, for passing to vm_core."""
+        return self.data.ctypes.data_as(ctypes.POINTER(ctypes.c_uint8))
+
+    def lengths_ptr(self) -> ctypes.POINTER(ctypes.c_uint32):
+        return self.lengths.ctypes.data_as(ctypes.POINTER(ctypes.c_uint32))
@@ -1,11 +1,15 @@
 from progress.bar import Bar
 
+from score_stats import ScoreStats
+
 class RunnerProgress(Bar) :
-    suffix = "%(phase)s | Generation: %(current_generation)d | Fitness: %(prev_score).2f | Avg: %(avg)ds"
+    suffix = "%(phase)s | Generation: %(current_generation)d | Fitness: %(prev_score).2f | Median: %(prev_median).0f | Best: %(prev_best).0f | Avg: %(avg)ds"
 
     def __init__(self, *args, **kwargs) :
         super().__init__(*args, **kwargs)
-        self.prev_score : int = 0
+        self.prev_score : float = 0
+        self.prev_median : float = 0
+        self.prev_best : float = 0
         self.current_generation : int = 0
 
     def next_generation(self, generation: int) :
@@ -13,8 +17,10 @@ class RunnerProgress(Bar) :
         self.phase = f"Testing"
         self.next()
 
-    def perform_selection(self, avg_score: float) :
-        self.prev_score = avg_score
+    def perform_selection(self, stats: ScoreStats) :
+        self.prev_score = stats.mean
+        self.prev_median = stats.median
+        self.prev_best = stats.max
         self.phase = f"Selection"
         self.update()
 
@@ -0,0 +1,70 @@
+"""
+behaviour.py
+
+Fixed-length behaviour descriptors for maze runs, used by novelty search and
+MAP-Elites.
+
+A descriptor summarises *what a program did* rather than how well it scored:
+where the player ended up, how much of the maze it visited and where, how
+long it ran and which move syscalls it issued.
+
+Descriptor functions share the signature ``(result, maze, program) -> tuple``
+so the evaluator can be asked for any of them.
+"""
+from __future__ import annotations
+
+from typing import TYPE_CHECKING, Tuple
+
+if TYPE_CHECKING:
+    from maze_game import Maze
+    from misc import VMResult
+
+# Side of the coarse occupancy grid the visited cells are binned into
+OCCUPANCY_GRID = 4
+MOVE_DIRECTIONS = ('w', 'a', 's', 'd')
+
+# end y, end x, visited fraction, steps fraction, 4 move fractions, occupancy grid
+DESCRIPTOR_DIM = 2 + 1 + 1 + len(MOVE_DIRECTIONS) + OCCUPANCY_GRID * OCCUPANCY_GRID
+
+Descriptor = Tuple[float, ...]
+
+
+def maze_descriptor(result: VMResult, maze: Maze, _program: bytes = b"", max_steps: int = 500) -> Descriptor:
+    """
+    Describes a finished maze run with DESCRIPTOR_DIM values, each in [0, 1].
+    """
+    height, width = maze.height, maze.width
+    visited = maze.visited_cells
+    moves = maze.total_steps or 1
+
+    occupancy = [0] * (OCCUPANCY_GRID * OCCUPANCY_GRID)
+    for y, x in visited:
+        occupancy[(y * OCCUPANCY_GRID // height) * OCCUPANCY_GRID + x * OCCUPANCY_GRID // width] += 1
+    cells = len(visited)
+
+    return (
+        maze.player_y / height,
+        maze.player_x / width,
+        min(1.0, cells / (height * width / 2)),
+        min(1.0, result.steps / max_steps),
+        *(maze.move_counts[d] / moves for d in MOVE_DIRECTIONS),
+        *(count / cells for count in occupancy),
+    )
+
+
+# end y, end x, effective program length (instructions), syscalls issued
+FEATURE_NAMES = ("end_y", "end_x", "effective_length", "syscalls")
+
+
+def maze_features(result: VMResult, maze: Maze, program: bytes = b"") -> Descriptor:
+    """
+    Raw MAP-Elites features of a maze run. The effective program length is the
+    number of instructions up to where execution stopped, a cheap stand-in for
+    the part of the genome that is not dead code.
+    """
+    return (
+        float(maze.player_y),
+        float(maze.player_x),
+        float(min(result.rt.pc, len(program)) // 2),
+        float(result.syscalls),
+    )
@@ -0,0 +1,289 @@
+#!/usr/bin/env python3
+"""
+bench_compare.py
+
+Benchmark regression tracker. Reruns the benchmark suites (bench_vm for the
+C interpreter, bench_ga.py for whole GA generations) and compares every
+metric with the baseline stored in bench_baseline.json, using a one-sided
+Mann-Whitney U test on the raw samples. A metric is flagged when it is
+significantly worse (p < --alpha) by more than --threshold percent.
+
+Everything runs locally; nothing is downloaded.
+
+Usage:
+  python3 bench_compare.py record                 # rerun suites, overwrite the baseline
+  python3 bench_compare.py compare                # rerun suites, diff against the baseline
+  python3 bench_compare.py compare --suite vm     # only the interpreter suite
+  python3 bench_compare.py compare --current results.json
+
+`compare` exits with status 1 when any metric regressed, so it can gate
+changes to vm_core.c or genetics.py.
+"""
+from __future__ import annotations
+
+import argparse
+import json
+import math
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+from typing import Any, Dict, List, Tuple
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BASELINE = os.path.join(HERE, "bench_baseline.json")
+BENCH_VM = os.path.join(HERE, "bench_vm")
+BENCH_VM_SOURCES = ("bench_vm.c", "vm_core.c", "vm_core.h")
+SUITES = ("vm", "ga")
+
+# metric name -> {"samples": [...], "higher_is_better": bool, "unit": str}
+Metrics = Dict[str, Dict[str, Any]]
+
+
+# --- Suites ---
+
+def _build_bench_vm() -> None:
+    """Rebuilds bench_vm when it is missing or older than its sources."""
+    sources = [os.path.join(HERE, s) for s in BENCH_VM_SOURCES]
+    if os.path.exists(BENCH_VM) and os.path.getmtime(BENCH_VM) >= max(os.path.getmtime(s) for s in sources):
+        return
+    cc = os.environ.get("CC", "cc")
+    subprocess.run([cc, "-O2", "-o", BENCH_VM, sources[0], sources[1], "-lm"], check=True, cwd=HERE)
+
+
+def run_vm_suite(args: argparse.Namespace) -> Metrics:
+    _build_bench_vm()
+    out = subprocess.run([BENCH_VM, "--repetitions", str(args.repetitions), "--seed", "1",
+                          "--best", os.path.join(HERE, "BEST.asm")],
+                         check=True, capture_output=True, text=True, cwd=HERE).stdout
+    metrics: Metrics = {}
+    for corpus in json.loads(out)["corpora"]:
+        metrics[f"vm/{corpus['name']}/instructions_per_second"] = {
+            "samples": corpus["instructions_per_second"]["samples"],
+            "higher_is_better": True,
+            "unit": "instr/s",
+        }
+        metrics[f"vm/{corpus['name']}/ns_per_run"] = {
+            "samples": corpus["ns_per_run"]["samples"],
+            "higher_is_better": False,
+            "unit": "ns",
+        }
+    return metrics
+
+
+def run_ga_suite(args: argparse.Namespace) -> Metrics:
+    out = subprocess.run([sys.executable, os.path.join(HERE, "bench_ga.py"),
+                          "--seed", "1", "--population", str(args.ga_population),
+                          "--generations", str(args.ga_generations),
+                          "--repetitions", str(args.repetitions),
+                          "--backend", *args.ga_backends],
+                         check=True, capture_output=True, text=True, cwd=HERE).stdout
+    metrics: Metrics = {}
+    for backend, result in json.loads(out)["backends"].items():
+        runs = result["runs"]
+        metrics[f"ga/{backend}/genomes_per_second"] = {
+            "samples": [r["genomes_per_second"] for r in runs],
+            "higher_is_better": True,
+            "unit": "genomes/s",
+        }
+        for phase in ("evaluate", "select", "crossover", "mutate"):
+            metrics[f"ga/{backend}/{phase}_seconds"] = {
+                "samples": [r["seconds"][phase] for r in runs],
+                "higher_is_better": False,
+                "unit": "s",
+            }
+    return metrics
+
+
+def _commit() -> str:
+    """HEAD the results were measured at, with -dirty for uncommitted changes; "" outside git."""
+    try:
+        return subprocess.run(["git", "describe", "--always", "--dirty", "--abbrev=40"], check=True,
+                              capture_output=True, text=True, cwd=HERE).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def run_suites(args: argparse.Namespace) -> Dict[str, Any]:
+    metrics: Metrics = {}
+    for suite in args.suite:
+        print(f"--- Running {suite} suite ---", file=sys.stderr)
+        metrics.update(run_vm_suite(args) if suite == "vm" else run_ga_suite(args))
+    return {
+        "host": {
+            "machine": platform.machine(),
+            "python": platform.python_version(),
+            "cpu_count": os.cpu_count(),
+        },
+        "commit": _commit(),
+        "timestamp": int(time.time()),
+        "metrics": metrics,
+    }
+
+
+# --- Statistics ---
+
+def _ranks(values: List[float]) -> Tuple[List[float], List[int]]:
+    """Average ranks (1-based) of values, and the sizes of tied groups."""
+    order = sorted(range(len(values)), key=lambda i: values[i])
+    ranks = [0.0] * len(values)
+    ties = []
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[order[k]] = (i + j) / 2 + 1
+        ties.append(j - i + 1)
+        i = j + 1
+    return ranks, ties
+
+
+def _exact_u_cdf(u: float, n1: int, n2: int) -> float:
+    """P(U <= u) under the null hypothesis, without ties, by counting rank arrangements."""
+    # counts[i][j][s]: arrangements of i x's and j y's with U statistic s
+    max_u = n1 * n2
+    prev = [[1] + [0] * max_u for _ in range(n2 + 1)]  # i = 0: U is always 0
+    for i in range(1, n1 + 1):
+        cur = [[0] * (max_u + 1) for _ in range(n2 + 1)]
+        cur[0][0] = 1
+        for j in range(1, n2 + 1):
+            for s in range(max_u + 1):
+                # The largest value is an x (beats all j y's) or a y
+                total = cur[j - 1][s]
+                if s >= j:
+                    total += prev[j][s - j]
+                cur[j][s] = total
+        prev = cur
+    counts = prev[n2]
+    return sum(counts[:int(math.floor(u)) + 1]) / math.comb(n1 + n2, n1)
+
+
+def mann_whitney_less(x: List[float], y: List[float]) -> float:
+    """
+    One-sided Mann-Whitney U test: p-value for "x tends to be smaller than y".
+    Exact for small samples without ties, normal approximation (with tie and
+    continuity correction) otherwise.
+    """
+    n1, n2 = len(x), len(y)
+    if n1 == 0 or n2 == 0:
+        return 1.0
+    ranks, ties = _ranks(list(x) + list(y))
+    u = sum(ranks[:n1]) - n1 * (n1 + 1) / 2  # U of x: pairs where x beats y
+    if n1 * n2 <= 400 and all(t == 1 for t in ties):
+        return _exact_u_cdf(u, n1, n2)
+    n = n1 + n2
+    mean = n1 * n2 / 2
+    tie_term = sum(t ** 3 - t for t in ties) / (n * (n - 1))
+    variance = n1 * n2 / 12 * ((n + 1) - tie_term)
+    if variance <= 0:
+        return 1.0
+    z = (u - mean + 0.5) / math.sqrt(variance)
+    return 0.5 * math.erfc(-z / math.sqrt(2))
+
+
+def compare(baseline: Metrics, current: Metrics, alpha: float, threshold: float) -> List[Dict[str, Any]]:
+    rows = []
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline or name not in current:
+            rows.append({"name": name, "verdict": "new" if name in current else "missing"})
+            continue
+        base, cur = baseline[name]["samples"], current[name]["samples"]
+        higher = current[name]["higher_is_better"]
+        base_median, cur_median = statistics.median(base), statistics.median(cur)
+        change = (cur_median - base_median) / base_median * 100 if base_median else 0.0
+        # Worse means lower throughput, or higher time
+        p_worse = mann_whitney_less(cur, base) if higher else mann_whitney_less(base, cur)
+        p_better = mann_whitney_less(base, cur) if higher else mann_whitney_less(cur, base)
+        worse_by = -change if higher else change
+        if p_worse < alpha and worse_by > threshold:
+            verdict = "SLOWER"
+        elif p_better < alpha and -worse_by > threshold:
+            verdict = "faster"
+        else:
+            verdict = "~"
+        rows.append({
+            "name": name, "unit": current[name]["unit"], "baseline": base_median, "current": cur_median,
+            "change": change, "p": min(p_worse, p_better), "verdict": verdict,
+        })
+    return rows
+
+
+def print_table(rows: List[Dict[str, Any]]) -> None:
+    width = max([len(r["name"]) for r in rows] + [9])
+    print(f"{'benchmark':{width}s} {'baseline':>12s} {'current':>12s} {'change':>8s} {'p':>7s}  verdict")
+    for r in rows:
+        if "baseline" not in r:
+            print(f"{r['name']:{width}s} {'':>12s} {'':>12s} {'':>8s} {'':>7s}  {r['verdict']}")
+            continue
+        print(f"{r['name']:{width}s} {r['baseline']:12.4g} {r['current']:12.4g} {r['change']:+7.1f}% "
+              f"{r['p']:7.3f}  {r['verdict']}")
+
+
+# --- Driver ---
+
+def _load(path: str) -> Dict[str, Any]:
+    with open(path, "r", encoding="utf-8") as f:
+        return json.load(f)
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Compare benchmark results against the stored baseline.")
+    ap.add_argument("command", choices=["record", "compare"])
+    ap.add_argument("--suite", nargs="+", choices=SUITES, default=list(SUITES))
+    ap.add_argument("--baseline", default=BASELINE, help="Baseline results file.")
+    ap.add_argument("--current", default=None,
+                    help="Compare these saved results instead of rerunning the suites.")
+    ap.add_argument("--save", default=None, help="Also write the fresh results to this file.")
+    ap.add_argument("--repetitions", type=int, default=10, help="Samples per benchmark.")
+    ap.add_argument("--ga-population", type=int, default=200)
+    ap.add_argument("--ga-generations", type=int, default=3)
+    ap.add_argument("--ga-backends", nargs="+", default=["serial", "thread"],
+                    help="bench_ga.py backends to run (the process backend is slow and noisy).")
+    ap.add_argument("--alpha", type=float, default=0.01, help="Significance level of the one-sided test.")
+    ap.add_argument("--threshold", type=float, default=5.0,
+                    help="Ignore changes smaller than this many percent, even if significant.")
+    args = ap.parse_args()
+
+    try:
+        results = _load(args.current) if args.current else run_suites(args)
+    except (OSError, subprocess.CalledProcessError, ValueError) as e:
+        print(f"Error running benchmarks: {e}", file=sys.stderr)
+        sys.exit(2)
+    if args.save:
+        with open(args.save, "w", encoding="utf-8") as f:
+            json.dump(results, f, indent=1)
+
+    if args.command == "record":
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump(results, f, indent=1)
+        print(f"Recorded {len(results['metrics'])} metrics at {results.get('commit') or 'unknown commit'} "
+              f"to {args.baseline}")
+        return
+
+    try:
+        baseline = _load(args.baseline)
+    except FileNotFoundError:
+        print(f"Error: No baseline at '{args.baseline}', run 'bench_compare.py record' first", file=sys.stderr)
+        sys.exit(2)
+    if baseline.get("host") != results.get("host"):
+        print(f"Warning: baseline was recorded on {baseline.get('host')}, not {results.get('host')}",
+              file=sys.stderr)
+    print(f"Baseline commit: {baseline.get('commit') or 'unknown'}, current: {results.get('commit') or 'unknown'}")
+
+    # Only compare the suites that were run
+    prefixes = tuple(f"{s}/" for s in args.suite)
+    base_metrics = {k: v for k, v in baseline["metrics"].items() if k.startswith(prefixes)}
+    rows = compare(base_metrics, results["metrics"], args.alpha, args.threshold)
+    print_table(rows)
+    regressions = [r["name"] for r in rows if r["verdict"] == "SLOWER"]
+    if regressions:
+        print(f"\n{len(regressions)} significant regression(s): {', '.join(regressions)}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
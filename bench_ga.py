@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+bench_ga.py
+
+End-to-end generation throughput benchmark of the genetic algorithm.
+
+Runs a fixed number of generations of a fixed-size population on fixed-size
+mazes, fully seeded, and times each phase: maze generation, population
+initialization, evaluation (runner.test), selection, crossover and mutation.
+Each backend is run `--repetitions` times from the same seed; the final
+population's hash must then match across repetitions and backends, which
+doubles as a reproducibility check.
+
+Usage:
+  python3 bench_ga.py --seed 1 --population 1000 --generations 5 --backend serial thread process
+  python3 bench_ga.py --output bench_ga.json
+"""
+from __future__ import annotations
+
+import argparse
+import hashlib
+import json
+import os
+import platform
+import random
+import statistics
+import sys
+import time
+from collections import defaultdict
+from typing import Any, Dict, List
+
+from genetics import GeneticAlgo
+from maze_game import Maze
+from runner import BACKENDS, make_lengths, random_program_bytes, test
+
+PHASES = ("mazes", "init", "evaluate", "select", "reproduce", "crossover", "mutate")
+
+
+class _PhaseTimer:
+    """Accumulates wall time per phase."""
+
+    def __init__(self):
+        self.seconds: Dict[str, float] = defaultdict(float)
+
+    def wrap(self, phase: str, func):
+        def timed(*args, **kwargs):
+            start = time.perf_counter()
+            try:
+                return func(*args, **kwargs)
+            finally:
+                self.seconds[phase] += time.perf_counter() - start
+        return timed
+
+
+def run_once(args: argparse.Namespace, backend: str) -> Dict[str, Any]:
+    """One seeded run. Returns the seconds spent per phase and a hash of the final population."""
+    timer = _PhaseTimer()
+    random.seed(args.seed)
+
+    mazes = timer.wrap("mazes", lambda: [Maze(width=args.maze_size, height=args.maze_size)
+                                         for _ in range(args.mazes)])()
+    population = timer.wrap("init", lambda: [random_program_bytes(words) for words in
+                                             make_lengths(args.population, None, args.min_words, args.max_words)])()
+
+    ga = GeneticAlgo(mutation_rate=args.mutation_rate, crossover_rate=args.crossover_rate, test_func=test)
+    # Crossover and mutation run inside _reproduce; time them where they are called
+    ga._crossover_point = timer.wrap("crossover", ga._crossover_point)
+    ga._mutate_counted = timer.wrap("mutate", ga._mutate_counted)
+    evaluate = timer.wrap("evaluate", ga._evaluate)
+    select = timer.wrap("select", ga._select)
+    reproduce = timer.wrap("reproduce", ga._reproduce)
+
+    evaluated = 0
+    start = time.perf_counter()
+    for generation in range(args.generations):
+        scored = evaluate(population, maze_test_set=mazes, endian="big", log=False,
+                          backend=backend, processes=args.processes)
+        evaluated += len(scored)
+        if generation + 1 == args.generations:
+            break
+        population, _ = reproduce(select(scored))
+    total = time.perf_counter() - start
+
+    digest = hashlib.blake2b(digest_size=16)
+    for genome in population:
+        digest.update(len(genome).to_bytes(4, "little"))
+        digest.update(genome)
+    return {
+        "seconds": {phase: timer.seconds.get(phase, 0.0) for phase in PHASES},
+        "total_seconds": total,
+        "evaluated": evaluated,
+        "genomes_per_second": evaluated / total if total > 0 else 0.0,
+        "evaluations_per_second": evaluated / timer.seconds["evaluate"] if timer.seconds["evaluate"] > 0 else 0.0,
+        "mean_score": ga.score_stats.mean,
+        "population_hash": digest.hexdigest(),
+    }
+
+
+def _summary(values: List[float]) -> Dict[str, float]:
+    return {
+        "mean": statistics.fmean(values),
+        "median": statistics.median(values),
+        "stddev": statistics.stdev(values) if len(values) > 1 else 0.0,
+        "min": min(values),
+        "max": max(values),
+    }
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Benchmark whole GA generations with fixed seeds.")
+    ap.add_argument("--seed", type=int, default=1, help="Seed for mazes, population and evolution.")
+    ap.add_argument("--population", type=int, default=1000)
+    ap.add_argument("--generations", type=int, default=5)
+    ap.add_argument("--maze-size", type=int, default=15, help="Width and height of the mazes.")
+    ap.add_argument("--mazes", type=int, default=100, help="Number of mazes in the test set.")
+    ap.add_argument("--min-words", type=int, default=4)
+    ap.add_argument("--max-words", type=int, default=64)
+    ap.add_argument("--mutation-rate", type=float, default=0.01)
+    ap.add_argument("--crossover-rate", type=float, default=0.8)
+    ap.add_argument("--backend", nargs="+", choices=BACKENDS, default=list(BACKENDS),
+                    help="Evaluation backends to compare.")
+    ap.add_argument("--processes", type=int, default=None, help="Pool size of the thread and process backends.")
+    ap.add_argument("--warmup", type=int, default=0, help="Untimed runs per backend.")
+    ap.add_argument("--repetitions", type=int, default=3, help="Timed runs per backend.")
+    ap.add_argument("--output", type=str, default=None, help="Write the JSON report here instead of stdout.")
+    args = ap.parse_args()
+    if args.repetitions < 1:
+        ap.error("--repetitions must be at least 1")
+
+    report: Dict[str, Any] = {
+        "benchmark": "ga_generation",
+        "seed": args.seed,
+        "population": args.population,
+        "generations": args.generations,
+        "maze_size": args.maze_size,
+        "mazes": args.mazes,
+        "words": [args.min_words, args.max_words],
+        "mutation_rate": args.mutation_rate,
+        "crossover_rate": args.crossover_rate,
+        "warmup": args.warmup,
+        "repetitions": args.repetitions,
+        "python": platform.python_version(),
+        "cpu_count": os.cpu_count(),
+        "timestamp": int(time.time()),
+        "backends": {},
+    }
+    hashes = set()
+    for backend in args.backend:
+        for _ in range(args.warmup):
+            run_once(args, backend)
+        runs = []
+        for _ in range(args.repetitions):
+            runs.append(run_once(args, backend))
+            print(f"{backend:8s} {runs[-1]['genomes_per_second']:10.1f} genomes/s", file=sys.stderr)
+        hashes.update(r["population_hash"] for r in runs)
+        report["backends"][backend] = {
+            "runs": runs,
+            "genomes_per_second": _summary([r["genomes_per_second"] for r in runs]),
+            "evaluations_per_second": _summary([r["evaluations_per_second"] for r in runs]),
+            "seconds": {phase: _summary([r["seconds"][phase] for r in runs]) for phase in PHASES},
+        }
+    report["reproducible"] = len(hashes) == 1
+
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+    if not report["reproducible"]:
+        print("Warning: final populations differ between runs with the same seed", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
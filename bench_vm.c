@@ -0,0 +1,372 @@
+// Build: cc -O2 -o bench_vm bench_vm.c vm_core.c -lm
+// Run:   ./bench_vm [--warmup N] [--repetitions N] [--min-time-ms N] [--seed N]
+//                   [--random-count N] [--best PATH] [--corpus NAME]... [--output FILE]
+//
+// Micro-benchmark of run_c. Each corpus is run `warmup` times untimed, then
+// `repetitions` timed samples are taken, each repeating the corpus enough times
+// to last at least `min-time-ms`. Results (instructions/s and runs/s per sample,
+// with mean, median, standard deviation and extremes) are printed as JSON.
+//
+// Syscalls are handled the way runner.py's systable would, minus their side
+// effects: EXIT (0) ends a run, PUTC (1) and the maze syscalls (0x10-0x15) are
+// acknowledged and resumed, any other id ends the run as an unknown syscall.
+#include "vm_core.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_CORPORA 8
+
+// hello.asm, assembled with asm.py
+static const uint8_t HELLO_PROGRAM[] = {
+    0xf0, 0xff, 0x01, 0x68, 0x02, 0x65, 0x03, 0x6c, 0x04, 0x6c, 0x05, 0x6f, 0x06, 0x20, 0x07, 0x77,
+    0x08, 0x6f, 0x09, 0x72, 0x0a, 0x6c, 0x0b, 0x64, 0x0c, 0x0a, 0x00, 0x00, 0x3c, 0x03, 0x22, 0x2e,
+    0x12, 0x01, 0x55, 0x0f, 0x06, 0x01, 0x0f, 0x02, 0x11, 0x00, 0x18, 0x13, 0x5e, 0x00, 0x01, 0x00,
+};
+
+typedef struct {
+    const char* name;
+    uint8_t** programs;
+    int* lengths;
+    int count;
+    uint32_t max_steps;
+} Corpus;
+
+typedef struct {
+    int warmup;
+    int repetitions;
+    double min_time_ms;
+    uint64_t seed;
+    int random_count;
+    const char* best_path;
+    const char* output_path;
+    const char* only[BENCH_MAX_CORPORA];
+    int only_count;
+} Options;
+
+// --- Corpora ---
+
+static uint64_t splitmix(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int corpus_alloc(Corpus* c, const char* name, int count, uint32_t max_steps) {
+    c->name = name;
+    c->count = count;
+    c->max_steps = max_steps;
+    c->programs = (uint8_t**)calloc((size_t)count, sizeof(uint8_t*));
+    c->lengths = (int*)calloc((size_t)count, sizeof(int));
+    return c->programs && c->lengths ? 0 : -1;
+}
+
+static void corpus_free(Corpus* c) {
+    for (int i = 0; i < c->count; i++) free(c->programs[i]);
+    free(c->programs);
+    free(c->lengths);
+}
+
+static int corpus_from_bytes(Corpus* c, const char* name, const uint8_t* bytes, int length, uint32_t max_steps) {
+    if (corpus_alloc(c, name, 1, max_steps) != 0) return -1;
+    c->programs[0] = (uint8_t*)malloc((size_t)length);
+    if (!c->programs[0]) return -1;
+    memcpy(c->programs[0], bytes, (size_t)length);
+    c->lengths[0] = length;
+    return 0;
+}
+
+// Assembles `count` instructions given as mnemonic + up to three operands
+typedef struct {
+    const char* mnemonic;
+    uint16_t op1, op2, op3;
+} Line;
+
+static int corpus_from_lines(Corpus* c, const char* name, const Line* lines, int count, uint32_t max_steps) {
+    uint8_t program[256];
+    for (int i = 0; i < count; i++) {
+        Instruction instr;
+        char* error = NULL;
+        memset(&instr, 0, sizeof(instr));
+        if (assemble_instruction(lines[i].mnemonic, lines[i].op1, lines[i].op2, lines[i].op3, &instr, &error) != 0) {
+            fprintf(stderr, "bench_vm: %s\n", error ? error : "assembly failed");
+            free(error);
+            return -1;
+        }
+        memcpy(program + i * INSTRUCTION_LENGTH, &instr, INSTRUCTION_LENGTH);
+    }
+    return corpus_from_bytes(c, name, program, count * INSTRUCTION_LENGTH, max_steps);
+}
+
+// BEST.asm holds the best evolved genome as one line of hex
+static int corpus_from_hex_file(Corpus* c, const char* name, const char* path, uint32_t max_steps) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    uint8_t* bytes = NULL;
+    int length = 0, capacity = 0, high = -1, ch;
+    while ((ch = fgetc(f)) != EOF) {
+        int nibble;
+        if (ch >= '0' && ch <= '9') nibble = ch - '0';
+        else if (ch >= 'a' && ch <= 'f') nibble = ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'F') nibble = ch - 'A' + 10;
+        else continue;
+        if (high < 0) { high = nibble; continue; }
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            uint8_t* grown = (uint8_t*)realloc(bytes, (size_t)capacity);
+            if (!grown) { free(bytes); fclose(f); return -1; }
+            bytes = grown;
+        }
+        bytes[length++] = (uint8_t)(high << 4 | nibble);
+        high = -1;
+    }
+    fclose(f);
+    int rc = length > 0 ? corpus_from_bytes(c, name, bytes, length, max_steps) : -1;
+    free(bytes);
+    return rc;
+}
+
+// Random genomes shaped like runner.py's initial population: 8 to 64 words
+static int corpus_random(Corpus* c, const char* name, int count, uint64_t seed, uint32_t max_steps) {
+    if (corpus_alloc(c, name, count, max_steps) != 0) return -1;
+    uint64_t rng = seed;
+    for (int i = 0; i < count; i++) {
+        int words = 8 + (int)(splitmix(&rng) % 57);
+        int length = words * INSTRUCTION_LENGTH;
+        c->programs[i] = (uint8_t*)malloc((size_t)length);
+        if (!c->programs[i]) return -1;
+        for (int b = 0; b < length; b++) c->programs[i][b] = (uint8_t)splitmix(&rng);
+        c->lengths[i] = length;
+    }
+    return 0;
+}
+
+// ALU, memory and branch instructions in a tight loop, run until max_steps
+static const Line LOOP_PROGRAM[] = {
+    {"MOV_REG_IMM", 5, 4, 0},      // R5 = loop start
+    {"MOV_REG_IMM", 1, 0, 0},
+    {"ADD", 1, 3, 1},              // loop: R1 += R3 + 1
+    {"XOR", 2, 1, 0},
+    {"MOV_REG_REG_SHL", 4, 2, 1},
+    {"ST_MEM_REG", 4, 6, 0},
+    {"LD_REG_MEM", 7, 6, 0},
+    {"JMP", 5, 0, 0},
+};
+
+// Every other instruction returns to the host for a PUTC
+static const Line SYSCALL_PROGRAM[] = {
+    {"MOV_REG_IMM", 5, 2, 0},      // R5 = loop start
+    {"SYSCALL", 1, 0, 0},          // loop: PUTC
+    {"JMP", 5, 0, 0},
+};
+
+// --- Measurement ---
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static inline int syscall_resumes(int id) {
+    return id == 1 || (id >= 0x10 && id <= 0x15);
+}
+
+// Runs every program of a corpus once. Returns the instructions executed.
+static uint64_t run_corpus(const Corpus* c, uint64_t* syscalls) {
+    uint64_t steps = 0;
+    for (int i = 0; i < c->count; i++) {
+        VMState state;
+        memset(&state, 0, sizeof(state));
+        state.interrupt = INTERRUPT_NONE;
+        for (;;) {
+            run_c(&state, c->programs[i], c->lengths[i], (int)c->max_steps, false);
+            if (state.interrupt < 0) break;
+            (*syscalls)++;
+            if (!syscall_resumes(state.interrupt)) break;
+        }
+        steps += state.steps;
+    }
+    return steps;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_samples(FILE* out, const char* name, const double* samples, int n) {
+    double* sorted = (double*)malloc(sizeof(double) * (size_t)n);
+    double mean = 0.0, m2 = 0.0;
+    for (int i = 0; i < n; i++) {
+        double delta = samples[i] - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (samples[i] - mean);
+        if (sorted) sorted[i] = samples[i];
+    }
+    double stddev = n > 1 ? sqrt(m2 / (n - 1)) : 0.0;
+    double median = mean;
+    if (sorted) {
+        qsort(sorted, (size_t)n, sizeof(double), compare_doubles);
+        median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    }
+    fprintf(out, "      \"%s\": {\"mean\": %.6g, \"median\": %.6g, \"stddev\": %.6g, \"cv\": %.6g, "
+                 "\"min\": %.6g, \"max\": %.6g, \"samples\": [",
+            name, mean, median, stddev, mean > 0 ? stddev / mean : 0.0,
+            sorted ? sorted[0] : mean, sorted ? sorted[n - 1] : mean);
+    for (int i = 0; i < n; i++) fprintf(out, "%s%.6g", i ? ", " : "", samples[i]);
+    fprintf(out, "]}");
+    free(sorted);
+}
+
+static int bench_corpus(FILE* out, const Corpus* c, const Options* opt, int first) {
+    uint64_t syscalls = 0;
+    for (int i = 0; i < opt->warmup; i++) run_corpus(c, &syscalls);
+
+    // Calibrate how many passes over the corpus make one sample last min_time_ms
+    double start = now_ns();
+    run_corpus(c, &syscalls);
+    double once_ms = (now_ns() - start) / 1e6;
+    int passes = once_ms > 0 ? (int)ceil(opt->min_time_ms / once_ms) : 1;
+    if (passes < 1) passes = 1;
+
+    double* ips = (double*)malloc(sizeof(double) * (size_t)opt->repetitions);
+    double* rps = (double*)malloc(sizeof(double) * (size_t)opt->repetitions);
+    double* ns_per_run = (double*)malloc(sizeof(double) * (size_t)opt->repetitions);
+    if (!ips || !rps || !ns_per_run) {
+        free(ips); free(rps); free(ns_per_run);
+        return -1;
+    }
+    uint64_t steps_per_pass = 0, syscalls_per_pass = 0;
+    for (int r = 0; r < opt->repetitions; r++) {
+        uint64_t steps = 0;
+        syscalls = 0;
+        start = now_ns();
+        for (int p = 0; p < passes; p++) steps += run_corpus(c, &syscalls);
+        double elapsed = now_ns() - start;
+        double runs = (double)passes * c->count;
+        ips[r] = (double)steps / (elapsed / 1e9);
+        rps[r] = runs / (elapsed / 1e9);
+        ns_per_run[r] = elapsed / runs;
+        steps_per_pass = steps / (uint64_t)passes;
+        syscalls_per_pass = syscalls / (uint64_t)passes;
+    }
+
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"name\": \"%s\",\n", c->name);
+    fprintf(out, "      \"programs\": %d,\n", c->count);
+    fprintf(out, "      \"max_steps\": %u,\n", c->max_steps);
+    fprintf(out, "      \"passes_per_sample\": %d,\n", passes);
+    fprintf(out, "      \"instructions_per_pass\": %llu,\n", (unsigned long long)steps_per_pass);
+    fprintf(out, "      \"syscalls_per_pass\": %llu,\n", (unsigned long long)syscalls_per_pass);
+    print_samples(out, "instructions_per_second", ips, opt->repetitions);
+    fprintf(out, ",\n");
+    print_samples(out, "runs_per_second", rps, opt->repetitions);
+    fprintf(out, ",\n");
+    print_samples(out, "ns_per_run", ns_per_run, opt->repetitions);
+    fprintf(out, "\n    }");
+    free(ips);
+    free(rps);
+    free(ns_per_run);
+    return 0;
+}
+
+// --- Driver ---
+
+static int selected(const Options* opt, const char* name) {
+    if (opt->only_count == 0) return 1;
+    for (int i = 0; i < opt->only_count; i++) {
+        if (strcmp(opt->only[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--warmup N] [--repetitions N] [--min-time-ms N] [--seed N] [--random-count N]\n"
+            "          [--best PATH] [--corpus hello|best|random|loop|syscall]... [--output FILE]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char** argv, Options* opt) {
+    opt->warmup = 3;
+    opt->repetitions = 10;
+    opt->min_time_ms = 50.0;
+    opt->seed = 1;
+    opt->random_count = 1000;
+    opt->best_path = "BEST.asm";
+    opt->output_path = NULL;
+    opt->only_count = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) return -1;
+        if (!value) return -1;
+        if (strcmp(arg, "--warmup") == 0) opt->warmup = atoi(value);
+        else if (strcmp(arg, "--repetitions") == 0) opt->repetitions = atoi(value);
+        else if (strcmp(arg, "--min-time-ms") == 0) opt->min_time_ms = atof(value);
+        else if (strcmp(arg, "--seed") == 0) opt->seed = strtoull(value, NULL, 0);
+        else if (strcmp(arg, "--random-count") == 0) opt->random_count = atoi(value);
+        else if (strcmp(arg, "--best") == 0) opt->best_path = value;
+        else if (strcmp(arg, "--output") == 0) opt->output_path = value;
+        else if (strcmp(arg, "--corpus") == 0 && opt->only_count < BENCH_MAX_CORPORA) opt->only[opt->only_count++] = value;
+        else return -1;
+        i++;
+    }
+    if (opt->warmup < 0 || opt->repetitions < 1 || opt->random_count < 1 || opt->min_time_ms < 0) return -1;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (parse_options(argc, argv, &opt) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Corpus corpora[BENCH_MAX_CORPORA];
+    int count = 0;
+    if (selected(&opt, "hello") &&
+        corpus_from_bytes(&corpora[count], "hello", HELLO_PROGRAM, sizeof(HELLO_PROGRAM), 10000) == 0) count++;
+    if (selected(&opt, "best")) {
+        if (corpus_from_hex_file(&corpora[count], "best", opt.best_path, 500) == 0) count++;
+        else fprintf(stderr, "bench_vm: skipping 'best', could not read %s\n", opt.best_path);
+    }
+    if (selected(&opt, "random") &&
+        corpus_random(&corpora[count], "random", opt.random_count, opt.seed, 500) == 0) count++;
+    if (selected(&opt, "loop") &&
+        corpus_from_lines(&corpora[count], "loop", LOOP_PROGRAM,
+                          (int)(sizeof(LOOP_PROGRAM) / sizeof(Line)), 100000) == 0) count++;
+    if (selected(&opt, "syscall") &&
+        corpus_from_lines(&corpora[count], "syscall", SYSCALL_PROGRAM,
+                          (int)(sizeof(SYSCALL_PROGRAM) / sizeof(Line)), 100000) == 0) count++;
+
+    FILE* out = stdout;
+    if (opt.output_path && !(out = fopen(opt.output_path, "w"))) {
+        perror(opt.output_path);
+        return 1;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"vm_core.run_c\",\n");
+#ifdef __VERSION__
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(out, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+    fprintf(out, "  \"warmup\": %d,\n", opt.warmup);
+    fprintf(out, "  \"repetitions\": %d,\n", opt.repetitions);
+    fprintf(out, "  \"min_time_ms\": %g,\n", opt.min_time_ms);
+    fprintf(out, "  \"seed\": %llu,\n", (unsigned long long)opt.seed);
+    fprintf(out, "  \"corpora\": [\n");
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        if (bench_corpus(out, &corpora[i], &opt, i == 0) != 0) rc = 1;
+        corpus_free(&corpora[i]);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+    return rc;
+}
@@ -0,0 +1,297 @@
+"""
+checkpoint.py
+
+Periodic, crash-safe checkpoints of a genetic algorithm run.
+
+A checkpoint holds everything needed to continue a run where it stopped: the
+next generation's population (as an arena), the scores of the generation that
+bred it, the generation counter, the maze test set and the state of the
+`random` module, plus the selection state that outlives a generation: the
+population's lineage, the novelty archive and the NSGA-II survivor front. It
+is written in a compact binary format by a background thread, to a temporary
+file that is fsynced, atomically renamed over the previous checkpoint and made
+durable by fsyncing the directory, so the GA never waits on the disk and a
+crash never leaves a torn or lost file behind.
+
+File layout (little endian):
+  header   magic "GACKPT", u16 version, u32 generation, u32 population,
+           u32 stride, u32 scores, u32 mazes
+  lengths  u32 x population
+  arena    u8 x population x stride
+  scores   i64 x scores
+  rng      u32 version, u32 x 625 Mersenne Twister words, u8 has_gauss, f64 gauss
+  mazes    per maze: u16 width, height, start y, start x, finish y, finish x,
+           then width x height bytes, 1 for a wall
+  lineage  u32 records (NO_SECTION without), then LINEAGE_DTYPE x records
+  novelty  u32 rows (NO_SECTION without), u32 dim, f32 x rows x dim
+  front    u32 entries (NO_SECTION without), then per entry:
+           u32 length, i64 score, u32 steps, u8 x length program
+  trailer  u32 CRC-32 of everything above
+Version 1 files end after the mazes and restore without the three sections.
+"""
+from __future__ import annotations
+
+import os
+import random
+import struct
+import threading
+import zlib
+from dataclasses import dataclass
+from typing import TYPE_CHECKING, Any, Callable, Dict, List, Optional, Tuple
+
+import numpy as np
+
+from arena import PopulationArena
+from genetics import LINEAGE_DTYPE
+from maze_game import Maze, WALL, FLOOR
+
+if TYPE_CHECKING:
+    from scorer import ScoredProgram
+
+MAGIC = b"GACKPT"
+VERSION = 2
+NO_SECTION = 0xFFFFFFFF
+_HEADER = struct.Struct("<6sHIIIII")
+_MAZE = struct.Struct("<HHHHHH")
+_RNG_WORDS = 625
+_GAUSS = struct.Struct("<Bd")
+_FRONT_ENTRY = struct.Struct("<IqI")
+
+# An NSGA-II survivor: (program, score, steps), what the default objectives read
+FrontEntry = Tuple[bytes, int, int]
+
+
+@dataclass
+class Checkpoint:
+    """A resumable snapshot of a GA run."""
+    generation: int                  # The generation `population` is about to become
+    population: List[bytes]
+    scores: List[int]                # Scores of the previous generation, in test order
+    mazes: List[Maze]
+    rng_state: Optional[tuple] = None  # random.getstate()
+    lineage: Optional[np.ndarray] = None   # LINEAGE_DTYPE per individual of `population`
+    novelty: Optional[np.ndarray] = None   # Novelty archive descriptors, float32 (rows, dim)
+    front: Optional[List[FrontEntry]] = None  # NSGA-II survivors of the previous selection
+
+    def restore_rng(self) -> None:
+        if self.rng_state is not None:
+            random.setstate(self.rng_state)
+
+
+def _encode_maze(maze: Maze) -> bytes:
+    grid = bytes(1 if cell == WALL else 0 for row in maze.grid for cell in row)
+    start_y, start_x = maze.start_position
+    return _MAZE.pack(maze.width, maze.height, start_y, start_x, maze.finish_y, maze.finish_x) + grid
+
+
+def _decode_maze(buffer: memoryview, offset: int) -> Tuple[Maze, int]:
+    width, height, start_y, start_x, finish_y, finish_x = _MAZE.unpack_from(buffer, offset)
+    offset += _MAZE.size
+    cells = bytes(buffer[offset:offset + width * height])
+    offset += width * height
+    grid = [[WALL if cells[y * width + x] else FLOOR for x in range(width)] for y in range(height)]
+    maze = Maze(from_data={
+        "width": width,
+        "height": height,
+        "grid": grid,
+        "start_position": (start_y, start_x),
+        "finish_position": (finish_y, finish_x),
+    })
+    return maze, offset
+
+
+def encode(checkpoint: Checkpoint) -> bytes:
+    """Serializes a checkpoint to the binary format described above."""
+    arena = PopulationArena.from_population(checkpoint.population)
+    parts = [
+        _HEADER.pack(MAGIC, VERSION, checkpoint.generation, len(arena), arena.stride,
+                     len(checkpoint.scores), len(checkpoint.mazes)),
+        arena.lengths.astype("<u4").tobytes(),
+        arena.data.tobytes(),
+        np.asarray(checkpoint.scores, dtype="<i8").tobytes(),
+    ]
+    if checkpoint.rng_state is not None:
+        rng_version, words, gauss = checkpoint.rng_state
+    else:
+        rng_version, words, gauss = 0, (0,) * _RNG_WORDS, None
+    parts.append(struct.pack("<I", rng_version))
+    parts.append(np.asarray(words, dtype="<u4").tobytes())
+    parts.append(_GAUSS.pack(gauss is not None, gauss or 0.0))
+    parts.extend(_encode_maze(m) for m in checkpoint.mazes)
+
+    if checkpoint.lineage is None:
+        parts.append(struct.pack("<I", NO_SECTION))
+    else:
+        lineage = np.ascontiguousarray(checkpoint.lineage, dtype=LINEAGE_DTYPE)
+        parts.append(struct.pack("<I", len(lineage)))
+        parts.append(lineage.tobytes())
+    if checkpoint.novelty is None:
+        parts.append(struct.pack("<I", NO_SECTION))
+    else:
+        novelty = np.ascontiguousarray(checkpoint.novelty, dtype="<f4")
+        parts.append(struct.pack("<II", novelty.shape[0], novelty.shape[1]))
+        parts.append(novelty.tobytes())
+    if checkpoint.front is None:
+        parts.append(struct.pack("<I", NO_SECTION))
+    else:
+        parts.append(struct.pack("<I", len(checkpoint.front)))
+        for program, score, steps in checkpoint.front:
+            parts.append(_FRONT_ENTRY.pack(len(program), score, steps))
+            parts.append(program)
+
+    body = b"".join(parts)
+    return body + struct.pack("<I", zlib.crc32(body))
+
+
+def decode(data: bytes) -> Checkpoint:
+    """Parses a checkpoint, raising ValueError if it is truncated or corrupt."""
+    if len(data) < _HEADER.size + 4:
+        raise ValueError("Checkpoint is truncated")
+    body, (crc,) = data[:-4], struct.unpack("<I", data[-4:])
+    if zlib.crc32(body) != crc:
+        raise ValueError("Checkpoint checksum mismatch")
+
+    buffer = memoryview(body)
+    magic, version, generation, count, stride, num_scores, num_mazes = _HEADER.unpack_from(buffer, 0)
+    if magic != MAGIC:
+        raise ValueError("Not a GA checkpoint")
+    if version not in (1, VERSION):
+        raise ValueError(f"Unsupported checkpoint version {version}")
+    offset = _HEADER.size
+
+    lengths = np.frombuffer(buffer, dtype="<u4", count=count, offset=offset)
+    offset += 4 * count
+    arena = np.frombuffer(buffer, dtype=np.uint8, count=count * stride, offset=offset).reshape(count, stride)
+    offset += count * stride
+    population = PopulationArena(arena, lengths).to_population()
+    scores = np.frombuffer(buffer, dtype="<i8", count=num_scores, offset=offset).tolist()
+    offset += 8 * num_scores
+
+    (rng_version,) = struct.unpack_from("<I", buffer, offset)
+    offset += 4
+    words = tuple(np.frombuffer(buffer, dtype="<u4", count=_RNG_WORDS, offset=offset).tolist())
+    offset += 4 * _RNG_WORDS
+    has_gauss, gauss = _GAUSS.unpack_from(buffer, offset)
+    offset += _GAUSS.size
+    rng_state = (rng_version, words, gauss if has_gauss else None) if rng_version else None
+
+    mazes = []
+    for _ in range(num_mazes):
+        maze, offset = _decode_maze(buffer, offset)
+        mazes.append(maze)
+
+    checkpoint = Checkpoint(generation, population, scores, mazes, rng_state)
+    if version == 1:
+        return checkpoint
+    try:
+        (records,) = struct.unpack_from("<I", buffer, offset)
+        offset += 4
+        if records != NO_SECTION:
+            checkpoint.lineage = np.frombuffer(buffer, dtype=LINEAGE_DTYPE, count=records, offset=offset).copy()
+            offset += records * LINEAGE_DTYPE.itemsize
+        (rows,) = struct.unpack_from("<I", buffer, offset)
+        offset += 4
+        if rows != NO_SECTION:
+            (dim,) = struct.unpack_from("<I", buffer, offset)
+            offset += 4
+            checkpoint.novelty = np.frombuffer(buffer, dtype="<f4", count=rows * dim,
+                                               offset=offset).reshape(rows, dim).astype(np.float32)
+            offset += 4 * rows * dim
+        (entries,) = struct.unpack_from("<I", buffer, offset)
+        offset += 4
+        if entries != NO_SECTION:
+            checkpoint.front = []
+            for _ in range(entries):
+                length, score, steps = _FRONT_ENTRY.unpack_from(buffer, offset)
+                offset += _FRONT_ENTRY.size
+                if offset + length > len(buffer):
+                    raise ValueError("Checkpoint is truncated")
+                checkpoint.front.append((bytes(buffer[offset:offset + length]), score, steps))
+                offset += length
+    except struct.error as e:
+        raise ValueError("Checkpoint is truncated") from e
+    return checkpoint
+
+
+def write_atomic(path: str, data: bytes) -> None:
+    """Writes `data` to `path` so that readers see either the old or the new file."""
+    tmp_path = f"{path}.tmp"
+    with open(tmp_path, "wb") as f:
+        f.write(data)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(tmp_path, path)
+    _fsync_directory(os.path.dirname(os.path.abspath(path)))
+
+
+def _fsync_directory(directory: str) -> None:
+    """Makes a rename in `directory` durable. Not possible on every platform (e.g. Windows)."""
+    try:
+        fd = os.open(directory, os.O_RDONLY)
+    except OSError:
+        return
+    try:
+        os.fsync(fd)
+    except OSError:
+        pass
+    finally:
+        os.close(fd)
+
+
+def load(path: str) -> Checkpoint:
+    with open(path, "rb") as f:
+        return decode(f.read())
+
+
+class Checkpointer:
+    """
+    Writes checkpoints from a background thread. Use as a GeneticAlgo
+    ``hook_checkpoint``. Only the newest pending checkpoint is kept: if the
+    writer falls behind, intermediate snapshots are skipped rather than
+    queued.
+    """
+
+    def __init__(self, path: str, mazes: List[Maze], every: int = 1,
+                 state: Optional[Callable[[], Dict[str, Any]]] = None):
+        self.path = path
+        self.mazes = mazes
+        self.every = max(1, every)
+        self.state = state  # Returns the lineage, novelty and front fields of a Checkpoint
+        self.written = 0
+        self.error: Optional[BaseException] = None
+        self._pending: Optional[Checkpoint] = None
+        self._closed = False
+        self._cond = threading.Condition()
+        self._thread = threading.Thread(target=self._writer, name="checkpoint-writer", daemon=True)
+        self._thread.start()
+
+    def __call__(self, generation: int, population: List[bytes], scored_population: List[ScoredProgram]) -> None:
+        if generation % self.every:
+            return
+        # Snapshot synchronously (cheap), serialize and write in the background
+        snapshot = Checkpoint(generation, list(population), [sp.score for sp in scored_population],
+                              self.mazes, random.getstate(), **(self.state() if self.state else {}))
+        with self._cond:
+            self._pending = snapshot
+            self._cond.notify()
+
+    def _writer(self) -> None:
+        while True:
+            with self._cond:
+                while self._pending is None and not self._closed:
+                    self._cond.wait()
+                snapshot, self._pending = self._pending, None
+                if snapshot is None:
+                    return
+            try:
+                write_atomic(self.path, encode(snapshot))
+                self.written += 1
+            except OSError as e:
+                self.error = e
+
+    def close(self) -> None:
+        """Flushes the pending checkpoint, if any, and stops the writer thread."""
+        with self._cond:
+            self._closed = True
+            self._cond.notify()
+        self._thread.join()
@@ -0,0 +1,315 @@
+"""
+difftest.py
+
+Differential testing of the execution engines in vm_core: random and mutated
+programs run on every engine, which must agree bit for bit on the final
+VMState (registers, memory, flags, pc, steps, interrupt), the syscalls made,
+the output and, on an environment task, the score.
+
+The engines (see VM_DIFF_* in vm_core.h) are run_c, run_c with counters,
+run_c single-stepped through debug interrupts, run_c with edge coverage and
+run_ctx, all under one fixed syscall model, and then an environment run alone,
+with coverage and inside a threaded vm_env_evaluate batch. The comparisons
+run on native threads without returning to Python; `python_every` also checks
+a sample against MiscVM, the path the serial, thread and process backends take.
+
+A disagreement is reduced to a small program that still makes the same engines
+disagree and reported with the fields that differ, e.g.
+  python3 difftest.py --seconds 60 --task maze --out diffs
+exits with status 1 when any counterexample was found.
+"""
+from __future__ import annotations
+
+import argparse
+import ctypes
+import os
+import random
+import sys
+import time
+from dataclasses import dataclass
+from typing import Dict, List, Optional
+
+import environments
+from genetics import GeneticAlgo
+from genome_archive import genome_hash
+from misc import CONSTANTS, SYSTABLE_SIZE, MiscVM, VMContext, VMState, vm_core
+
+ENGINES = ("run_c", "counters", "debug", "coverage", "context", "env", "env_coverage", "env_batch")
+PYTHON = "python"  # MiscVM, compared against run_c on a sample
+VM_DIFF_ENV = CONSTANTS['VM_DIFF_ENV']
+OUTPUT_CAPACITY = CONSTANTS['VM_DIFF_OUTPUT_CAPACITY']
+MAX_WORDS = 64
+DECODE_FIELDS = ("op", "rd", "rs", "imm4", "imm8", "imm12")
+
+
+class VMDiffOutcome(ctypes.Structure):
+    _fields_ = [
+        ("state", VMState),
+        ("score", ctypes.c_int64),
+        ("exit_code", ctypes.c_int32),
+        ("syscalls", ctypes.c_uint32),
+        ("output_total", ctypes.c_uint64),
+        ("output_hash", ctypes.c_uint64),
+    ]
+
+
+_i32p = ctypes.POINTER(ctypes.c_int32)
+
+vm_core.vm_diff_run.argtypes = [
+    ctypes.c_int, ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.POINTER(VMDiffOutcome),
+]
+vm_core.vm_diff_run.restype = ctypes.c_int
+
+vm_core.vm_diff.argtypes = [
+    ctypes.c_void_p, ctypes.c_char_p, _i32p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+    ctypes.POINTER(ctypes.c_uint8),
+]
+vm_core.vm_diff.restype = ctypes.c_int
+
+vm_core.vm_diff_reduce.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_uint8]
+vm_core.vm_diff_reduce.restype = ctypes.c_int
+
+
+def engine_names(mask: int) -> List[str]:
+    return [name for i, name in enumerate(ENGINES) if mask & (1 << i)]
+
+
+def output_hash(output: bytes) -> int:
+    """hash_row of vm_core.c over the buffered output."""
+    h = 0xCBF29CE484222325 ^ len(output)
+    for c in output:
+        h = ((h ^ c) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def engine_outcome(engine: int, program: bytes, max_steps: int = 500,
+                   task: Optional[environments.Task] = None) -> VMDiffOutcome:
+    out = VMDiffOutcome()
+    if vm_core.vm_diff_run(engine, task._handle if task else None, program, len(program), max_steps,
+                           ctypes.byref(out)) != 0:
+        raise ValueError(f"Engine {ENGINES[engine]} needs a task")
+    return out
+
+
+def _exit(state: VMState) -> None:
+    raise MiscVM.Stop(state.registers[0])
+
+
+class PythonModel:
+    """MiscVM under the syscall model of the native engines."""
+
+    def __init__(self, max_steps: int):
+        self.max_steps = max_steps
+        self.context = VMContext(OUTPUT_CAPACITY, "ring")
+        systable = [lambda state: None] * SYSTABLE_SIZE  # Every other syscall returns at once
+        systable[0] = _exit
+        self.vm = MiscVM(systable, context=self.context)
+
+    def outcome(self, program: bytes) -> VMDiffOutcome:
+        result = self.vm.run(program, max_steps=self.max_steps)
+        out = VMDiffOutcome()
+        out.state = result.rt
+        out.exit_code = -1 if result.exit_code is None else result.exit_code
+        out.output_total = self.context.total
+        out.syscalls = result.syscalls - out.output_total  # MiscVM counts PUTC too
+        out.output_hash = output_hash(result.output)
+        return out
+
+
+def differences(reference: VMDiffOutcome, outcome: VMDiffOutcome) -> List[str]:
+    """The fields that differ, as 'name: reference != outcome'."""
+    diffs = []
+    a, b = reference.state, outcome.state
+    for name, _ in VMState._fields_:
+        if name in DECODE_FIELDS:
+            continue
+        x, y = getattr(a, name), getattr(b, name)
+        if isinstance(x, ctypes.Array):
+            for i, (u, v) in enumerate(zip(x, y)):
+                if u != v:
+                    diffs.append(f"{name}[{i}]: {u} != {v}")
+        elif x != y:
+            diffs.append(f"{name}: {x} != {y}")
+    for name in ("score", "exit_code", "syscalls", "output_total", "output_hash"):
+        x, y = getattr(reference, name), getattr(outcome, name)
+        if x != y:
+            diffs.append(f"{name}: {x} != {y}")
+    return diffs
+
+
+@dataclass
+class Counterexample:
+    program: bytes            # Reduced
+    original: bytes
+    engines: List[str]        # Engines that disagreed with their reference
+    details: Dict[str, List[str]]  # Engine -> differing fields, where the reduced program reproduces it
+
+    def __str__(self) -> str:
+        lines = [f"{', '.join(self.engines)} disagree on {self.program.hex()} "
+                 f"({len(self.program)} of {len(self.original)} bytes)"]
+        for engine, diffs in self.details.items():
+            lines.append(f"  {engine}: " + ("; ".join(diffs[:8]) or "only in the threaded batch"))
+        return "\n".join(lines)
+
+
+class DiffTester:
+    """Runs batches of random and mutated programs through every engine."""
+
+    def __init__(self, task: Optional[environments.Task] = None, max_steps: int = 500,
+                 threads: Optional[int] = None, batch_size: int = 4096, mutation_rate: float = 0.01,
+                 python_every: int = 0):
+        self.task = task
+        self.max_steps = max_steps
+        self.threads = max(1, threads or os.cpu_count() or 1)
+        self.batch_size = batch_size
+        self.operators = GeneticAlgo(mutation_rate, 0.0, test_func=None)
+        self.python = PythonModel(max_steps) if python_every else None
+        self.python_every = python_every
+        self.engines = VM_DIFF_ENV - 1 + (len(ENGINES) - VM_DIFF_ENV - 1 if task else 0)
+        self.programs = 0
+        self.comparisons = 0
+        self.seconds = 0.0
+        self.counterexamples: List[Counterexample] = []
+        self._seen: Dict[tuple, int] = {}  # See _add
+        self._pool: List[bytes] = []
+        self._offsets = (ctypes.c_int32 * (batch_size + 1))()
+        self._mismatch = (ctypes.c_uint8 * batch_size)()
+
+    def _programs(self) -> List[bytes]:
+        """Half random programs, half mutants of the previous batch."""
+        programs = [random.randbytes(2 * random.randint(1, MAX_WORDS)) for _ in range(self.batch_size // 2)]
+        while len(programs) < self.batch_size:
+            child = self.operators._mutate(random.choice(self._pool)) if self._pool else b""
+            programs.append(child[:len(child) & ~1] or random.randbytes(2))
+        self._pool = programs
+        return programs
+
+    def _add(self, counterexample: Counterexample, mask: int) -> None:
+        """Keeps the smallest counterexample per engine mask and set of differing fields."""
+        key = (mask, tuple((engine, tuple(sorted({d.split(":")[0] for d in diffs})))
+                           for engine, diffs in counterexample.details.items()))
+        known = self._seen.get(key)
+        if known is None:
+            self._seen[key] = len(self.counterexamples)
+            self.counterexamples.append(counterexample)
+        elif len(counterexample.program) < len(self.counterexamples[known].program):
+            self.counterexamples[known] = counterexample
+
+    def _report(self, program: bytes, mask: int) -> None:
+        buffer = ctypes.create_string_buffer(program, len(program))
+        length = vm_core.vm_diff_reduce(self.task._handle if self.task else None, buffer, len(program),
+                                        self.max_steps, mask)
+        reduced = buffer.raw[:length] if length >= 0 else program
+        details = {}
+        for name in engine_names(mask):
+            engine = ENGINES.index(name)
+            reference = VM_DIFF_ENV if engine > VM_DIFF_ENV else 0
+            details[name] = differences(engine_outcome(reference, reduced, self.max_steps, self.task),
+                                        engine_outcome(engine, reduced, self.max_steps, self.task))
+        self._add(Counterexample(reduced, program, engine_names(mask), details), mask)
+
+    def _check_python(self, program: bytes) -> None:
+        diffs = differences(engine_outcome(0, program, self.max_steps), self.python.outcome(program))
+        self.comparisons += 1
+        if diffs:
+            self._add(Counterexample(program, program, [PYTHON], {PYTHON: diffs}), 0)
+
+    def step(self) -> int:
+        """Tests one batch; returns the number of programs on which engines disagreed."""
+        programs = self._programs()
+        count = len(programs)
+        offsets = self._offsets
+        position = 0
+        for i, program in enumerate(programs):
+            offsets[i] = position
+            position += len(program)
+        offsets[count] = position
+        start = time.perf_counter()
+        mismatches = vm_core.vm_diff(self.task._handle if self.task else None, b"".join(programs), offsets,
+                                     count, self.max_steps, self.threads, self._mismatch)
+        self.seconds += time.perf_counter() - start
+        if mismatches < 0:
+            raise MemoryError("Native differential testing failed")
+        self.programs += count
+        self.comparisons += count * self.engines
+        if mismatches:
+            for i in range(count):
+                if self._mismatch[i]:
+                    self._report(programs[i], self._mismatch[i])
+        if self.python is not None:
+            for program in programs[::self.python_every]:
+                self._check_python(program)
+        return mismatches
+
+    def run(self, seconds: float = 0.0, programs: int = 0) -> None:
+        """Tests batches until `seconds` have passed or `programs` were tested, whichever is given."""
+        deadline = time.perf_counter() + seconds
+        target = self.programs + programs
+        while (self.programs < target) if programs else (time.perf_counter() < deadline):
+            self.step()
+
+    def write(self, directory: str) -> List[str]:
+        """Writes each counterexample as a raw .bin program; returns the paths."""
+        os.makedirs(directory, exist_ok=True)
+        paths = []
+        for c in self.counterexamples:
+            path = os.path.join(directory, f"{'+'.join(c.engines)}-{genome_hash(c.program).hex()}.bin")
+            with open(path, "wb") as f:
+                f.write(c.program)
+            paths.append(path)
+        return paths
+
+
+def make_task(name: str, seed: Optional[int]) -> Optional[environments.Task]:
+    if name == "none":
+        return None
+    if name == "maze":
+        from maze_game import Maze
+        random.seed(seed)
+        return environments.Environment("maze").task(environments.maze_config(Maze(width=15, height=15)))
+    if name == "putc":
+        from output_scorer import DEFAULT_TARGET
+        return environments.Environment("putc").task(environments.putc_config(DEFAULT_TARGET, 2))
+    return environments.Environment(name).task()
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Differential testing of the vm_core execution engines.")
+    ap.add_argument("--seconds", type=float, default=10.0, help="How long to test (default 10).")
+    ap.add_argument("--programs", type=int, default=0, help="Test this many programs instead of for --seconds.")
+    ap.add_argument("--task", type=str, default="maze",
+                    help="Environment for the env engines: maze (default), putc, a loaded plugin or 'none'.")
+    ap.add_argument("--env-plugin", type=str, action="append", default=[], metavar="PATH",
+                    help="Load a native environment plugin first. May be repeated.")
+    ap.add_argument("--threads", type=int, default=os.cpu_count(), help="Native threads (default: all cores).")
+    ap.add_argument("--max-steps", type=int, default=500)
+    ap.add_argument("--batch-size", type=int, default=4096)
+    ap.add_argument("--python-every", type=int, default=0, metavar="N",
+                    help="Also compare every Nth program against MiscVM in Python.")
+    ap.add_argument("--seed", type=int, default=None)
+    ap.add_argument("--out", type=str, default=None, metavar="DIR", help="Write counterexamples as .bin files here.")
+    args = ap.parse_args()
+
+    for path in args.env_plugin:
+        environments.load(path)
+    task = make_task(args.task, args.seed)
+    random.seed(args.seed)
+    tester = DiffTester(task, args.max_steps, args.threads, args.batch_size, python_every=args.python_every)
+    start = time.perf_counter()
+    tester.run(args.seconds, args.programs)
+    elapsed = time.perf_counter() - start
+
+    print(f"Programs        : {tester.programs}")
+    print(f"Comparisons     : {tester.comparisons} ({tester.comparisons / elapsed * 60:.0f} / min, "
+          f"{tester.engines} engines per program)")
+    print(f"Counterexamples : {len(tester.counterexamples)}")
+    for c in tester.counterexamples[:20]:
+        print(c)
+    if args.out and tester.counterexamples:
+        tester.write(args.out)
+        print(f"Written to {args.out}")
+    sys.exit(1 if tester.counterexamples else 0)
+
+
+if __name__ == "__main__":
+    main()
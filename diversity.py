@@ -0,0 +1,125 @@
+"""
+diversity.py
+
+Population diversity metrics computed natively from a PopulationArena:
+pairwise Hamming distances (exact or sampled), unique genome count and
+per-bit entropy. Cheap enough to run every generation to spot premature
+convergence.
+"""
+from __future__ import annotations
+
+import ctypes
+from dataclasses import dataclass
+from typing import List, Optional, Sequence, Tuple, Union
+
+import numpy as np
+
+from arena import PopulationArena
+from misc import vm_core
+
+# Above this many pairs, measure() samples instead of comparing every pair
+EXACT_PAIR_LIMIT = 4_000_000
+DEFAULT_SAMPLE_PAIRS = 1_000_000
+
+
+class DiversityStats(ctypes.Structure):
+    """Mirror of the C DiversityStats structure"""
+    _fields_ = [
+        ("mean_distance", ctypes.c_double),
+        ("min_distance", ctypes.c_uint32),
+        ("max_distance", ctypes.c_uint32),
+        ("pairs", ctypes.c_uint64),
+        ("unique_genomes", ctypes.c_uint32),
+        ("bit_positions", ctypes.c_uint32),
+        ("mean_bit_entropy", ctypes.c_double),
+    ]
+
+    def __repr__(self) -> str:
+        return (f"DiversityStats(mean_distance={self.mean_distance:.2f}, min={self.min_distance}, "
+                f"max={self.max_distance}, pairs={self.pairs}, unique={self.unique_genomes}, "
+                f"entropy={self.mean_bit_entropy:.3f})")
+
+
+_u8p = ctypes.POINTER(ctypes.c_uint8)
+_u32p = ctypes.POINTER(ctypes.c_uint32)
+
+vm_core.hamming_pairwise.argtypes = [_u8p, ctypes.c_int, ctypes.c_int, _u32p]
+vm_core.hamming_pairwise.restype = ctypes.c_int
+
+vm_core.hamming_sampled.argtypes = [_u8p, ctypes.c_int, ctypes.c_int, ctypes.c_uint64, ctypes.c_uint64,
+                                    _u32p, _u32p, _u32p]
+vm_core.hamming_sampled.restype = ctypes.c_int
+
+vm_core.diversity_stats.argtypes = [_u8p, _u32p, ctypes.c_int, ctypes.c_int, ctypes.c_uint64, ctypes.c_uint64,
+                                    ctypes.POINTER(ctypes.c_double), ctypes.POINTER(DiversityStats)]
+vm_core.diversity_stats.restype = ctypes.c_int
+
+Population = Union[PopulationArena, Sequence[bytes]]
+
+
+def _as_arena(population: Population) -> PopulationArena:
+    if isinstance(population, PopulationArena):
+        return population
+    return PopulationArena.from_population(population)
+
+
+def pairwise_distances(population: Population) -> np.ndarray:
+    """All pairwise Hamming distances, in condensed (scipy pdist) order."""
+    arena = _as_arena(population)
+    n = len(arena)
+    out = np.zeros(n * (n - 1) // 2, dtype=np.uint32)
+    if n > 1 and vm_core.hamming_pairwise(arena.data_ptr(), n, arena.stride,
+                                          out.ctypes.data_as(_u32p)) != 0:
+        raise RuntimeError("hamming_pairwise failed in C core.")
+    return out
+
+
+def sampled_distances(population: Population, pairs: int, seed: int = 0) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+    """Hamming distances of `pairs` random pairs. Returns (distances, first indices, second indices)."""
+    arena = _as_arena(population)
+    out = np.zeros(pairs, dtype=np.uint32)
+    a = np.zeros(pairs, dtype=np.uint32)
+    b = np.zeros(pairs, dtype=np.uint32)
+    if vm_core.hamming_sampled(arena.data_ptr(), len(arena), arena.stride, pairs, seed,
+                               out.ctypes.data_as(_u32p), a.ctypes.data_as(_u32p), b.ctypes.data_as(_u32p)) != 0:
+        raise RuntimeError("hamming_sampled failed in C core (need at least two genomes).")
+    return out, a, b
+
+
+def measure(
+            population: Population,
+            sample_pairs: Optional[int] = None,
+            seed: int = 0,
+            with_bit_entropy: bool = False,
+        ) -> Tuple[DiversityStats, Optional[np.ndarray]]:
+    """
+    Summary diversity statistics. Pair distances are exact up to EXACT_PAIR_LIMIT
+    pairs and sampled beyond that, unless `sample_pairs` is given (0 forces exact).
+    Returns the stats and, if requested, the per-bit entropy (-1 where undefined).
+    """
+    arena = _as_arena(population)
+    n = len(arena)
+    if sample_pairs is None:
+        sample_pairs = 0 if n * (n - 1) // 2 <= EXACT_PAIR_LIMIT else DEFAULT_SAMPLE_PAIRS
+    entropy = np.zeros(arena.stride * 8, dtype=np.float64) if with_bit_entropy else None
+    stats = DiversityStats()
+    result = vm_core.diversity_stats(
+        arena.data_ptr(), arena.lengths_ptr(), n, arena.stride, sample_pairs, seed,
+        entropy.ctypes.data_as(ctypes.POINTER(ctypes.c_double)) if entropy is not None else None,
+        ctypes.byref(stats))
+    if result != 0:
+        raise RuntimeError("diversity_stats failed in C core.")
+    return stats, entropy
+
+
+@dataclass
+class DiversityLog:
+    """Collects diversity statistics per generation, for use as a GeneticAlgo population hook."""
+    sample_pairs: Optional[int] = None
+
+    def __post_init__(self):
+        self.history: List[DiversityStats] = []
+
+    def __call__(self, generation: int, population: List[bytes]) -> None:
+        stats, _ = measure(population, self.sample_pairs, seed=generation)
+        self.history.append(stats)
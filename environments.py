@@ -0,0 +1,164 @@
+"""
+environments.py
+
+Native task environments backed by vm_core: the maze and PUTC tasks written in
+C, plus any loaded from shared objects, run and scored a whole population at a
+time on native threads without calling back into Python.
+
+An environment (see the VMEnvironment vtable in vm_core.h) turns a config blob
+into a task, e.g. one maze; `evaluate` runs every program on the task picked
+for it and returns scores, descriptors and final VM states. A plugin is a
+shared object built against vm_core.h that exports
+    const VMEnvironment* vm_environment(void);
+"""
+from __future__ import annotations
+
+import ctypes
+import os
+import struct
+from typing import TYPE_CHECKING, List, Optional, Sequence
+
+from misc import CONSTANTS, MiscVM, VMResult, VMState, interrupt_message, vm_core
+
+if TYPE_CHECKING:
+    from maze_game import Maze
+
+MAX_DESCRIPTOR = CONSTANTS['VM_ENV_MAX_DESCRIPTOR']
+
+
+class VMEnvResult(ctypes.Structure):
+    _fields_ = [
+        ("score", ctypes.c_int64),
+        ("exit_code", ctypes.c_int32),
+        ("halted", ctypes.c_uint8),
+        ("syscalls", ctypes.c_uint32),
+        ("descriptor", ctypes.c_double * MAX_DESCRIPTOR),
+        ("state", VMState),
+    ]
+
+
+class VMEnvironment(ctypes.Structure):
+    """Leading fields of the C vtable, enough to read an environment's name and sizes."""
+    _fields_ = [
+        ("abi_version", ctypes.c_uint32),
+        ("name", ctypes.c_char_p),
+        ("run_size", ctypes.c_uint32),
+        ("descriptor_dims", ctypes.c_int),
+    ]
+
+
+_envp = ctypes.POINTER(VMEnvironment)
+
+vm_core.vm_env_load.argtypes = [ctypes.c_char_p]
+vm_core.vm_env_load.restype = ctypes.c_int
+
+vm_core.vm_env_count.argtypes = []
+vm_core.vm_env_count.restype = ctypes.c_int
+
+vm_core.vm_env_get.argtypes = [ctypes.c_int]
+vm_core.vm_env_get.restype = _envp
+
+vm_core.vm_env_find.argtypes = [ctypes.c_char_p]
+vm_core.vm_env_find.restype = _envp
+
+vm_core.vm_env_task_new.argtypes = [_envp, ctypes.c_char_p, ctypes.c_uint32]
+vm_core.vm_env_task_new.restype = ctypes.c_void_p
+
+vm_core.vm_env_task_free.argtypes = [ctypes.c_void_p]
+vm_core.vm_env_task_free.restype = None
+
+vm_core.vm_env_evaluate.argtypes = [
+    ctypes.POINTER(ctypes.c_void_p), ctypes.c_int, ctypes.POINTER(ctypes.c_int32), ctypes.c_char_p,
+    ctypes.POINTER(ctypes.c_int32), ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.POINTER(VMEnvResult),
+]
+vm_core.vm_env_evaluate.restype = ctypes.c_int
+
+
+def load(path: str) -> str:
+    """Loads an environment plugin; returns its name."""
+    index = vm_core.vm_env_load(os.path.abspath(path).encode())
+    if index < 0:
+        raise OSError(f"Could not load environment from {path} "
+                      "(missing vm_environment, ABI mismatch or duplicate name)")
+    return vm_core.vm_env_get(index).contents.name.decode()
+
+
+def names() -> List[str]:
+    """Names of the registered environments, built-in ones first."""
+    return [vm_core.vm_env_get(i).contents.name.decode() for i in range(vm_core.vm_env_count())]
+
+
+def maze_config(maze: Maze) -> bytes:
+    """Config of the native "maze" environment for one maze."""
+    header = bytes((maze.height, maze.width, *maze.start_position, maze.finish_y, maze.finish_x))
+    return header + bytes(cell == '#' for row in maze.grid for cell in row)
+
+
+def putc_config(target: bytes, max_mismatches: int = 0) -> bytes:
+    """Config of the native "putc" environment."""
+    return struct.pack("<I", max_mismatches) + target
+
+
+class Task:
+    """One configured task of an environment, e.g. one maze."""
+
+    def __init__(self, environment: Environment, config: bytes = b""):
+        self.environment = environment
+        self._handle = vm_core.vm_env_task_new(environment._env, config, len(config))
+        if not self._handle:
+            raise ValueError(f"Invalid config for environment '{environment.name}'")
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.vm_env_task_free(self._handle)
+            self._handle = None
+
+
+class Environment:
+    """A registered native environment, by name."""
+
+    def __init__(self, name: str):
+        self._env = vm_core.vm_env_find(name.encode())
+        if not self._env:
+            raise KeyError(f"Unknown environment: {name}")
+        self.name = name
+        self.descriptor_dims = self._env.contents.descriptor_dims
+
+    def task(self, config: bytes = b"") -> Task:
+        return Task(self, config)
+
+
+def evaluate(tasks: Sequence[Task], task_index: Sequence[int], programs: Sequence[bytes],
+             max_steps: int = 500, threads: int = 1) -> ctypes.Array:
+    """Runs program i on tasks[task_index[i]]; returns one VMEnvResult per program."""
+    count = len(programs)
+    offsets = (ctypes.c_int32 * (count + 1))()
+    position = 0
+    for i, program in enumerate(programs):
+        offsets[i] = position
+        position += len(program)
+    offsets[count] = position
+    handles = (ctypes.c_void_p * len(tasks))(*(t._handle for t in tasks))
+    index = (ctypes.c_int32 * count)(*task_index)
+    out = (VMEnvResult * count)()
+    if vm_core.vm_env_evaluate(handles, len(tasks), index, b"".join(programs), offsets, count,
+                               max_steps, max(1, threads or 1), out) != 0:
+        raise ValueError("Native evaluation failed (bad task index or out of memory)")
+    return out
+
+
+def to_vm_result(result: VMEnvResult) -> VMResult:
+    """The VMResult a MiscVM run would have produced."""
+    state = VMState.from_buffer_copy(result.state)
+    error: Optional[MiscVM.Error] = None
+    if result.halted:
+        if state.interrupt >= 0:
+            error = MiscVM.Error(f"Unknown syscall: {state.interrupt}", state)
+        else:
+            error = MiscVM.Error(interrupt_message(state.interrupt), state)
+    exit_code = None if result.halted else result.exit_code
+    return VMResult(bool(result.halted), error, exit_code, state.steps, state, result.syscalls)
+
+
+def descriptor(result: VMEnvResult, dims: int) -> tuple:
+    return tuple(result.descriptor[:dims])
@@ -0,0 +1,224 @@
+"""
+fuzz.py
+
+Coverage-guided fuzzing of MISC programs on a native environment (see
+environments.py), AFL style.
+
+Every execution records which (previous pc, pc) edges it took, bucketed by hit
+count, into a per-run bitmap inside the interpreter. A program is kept in the
+corpus when it reaches an edge or hit-count class no earlier program did, or
+ends in a way not seen before (exit, each interrupt, each unknown syscall).
+Mutation is AFL's havoc stage, done in C by vm_env_fuzz_havoc: it picks
+corpus entries, least fuzzed first, sometimes splices one with another,
+stacks instruction-aligned mutations on it and runs it, and only hands the
+children worth keeping back to Python, which does the corpus bookkeeping.
+"""
+from __future__ import annotations
+
+import ctypes
+import random
+import time
+from dataclasses import dataclass
+from typing import Dict, Iterable, List, Optional, Sequence
+
+import numpy as np
+
+import environments
+from environments import VMEnvResult
+from misc import CONSTANTS, vm_core
+from runlog import OUTCOME_UNKNOWN_SYSCALL_BASE
+
+COVERAGE_MAP_SIZE = 1 << CONSTANTS['COVERAGE_MAP_BITS']
+COVERAGE_NEW_COUNT = CONSTANTS['COVERAGE_NEW_COUNT']
+COVERAGE_NEW_EDGE = CONSTANTS['COVERAGE_NEW_EDGE']
+FUZZ_MAX_PROGRAM = CONSTANTS['FUZZ_MAX_PROGRAM']
+FUZZ_OUTCOMES = CONSTANTS['FUZZ_OUTCOMES']
+
+
+class VMFuzzFind(ctypes.Structure):
+    _fields_ = [
+        ("parent", ctypes.c_int32),
+        ("execution", ctypes.c_int32),
+        ("offset", ctypes.c_int32),
+        ("length", ctypes.c_int32),
+        ("outcome", ctypes.c_int32),
+        ("coverage", ctypes.c_uint8),
+    ]
+
+
+vm_core.vm_env_fuzz.argtypes = [
+    ctypes.c_void_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_int32), ctypes.c_int, ctypes.c_int,
+    ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.POINTER(VMEnvResult),
+]
+vm_core.vm_env_fuzz.restype = ctypes.c_int
+
+vm_core.vm_env_fuzz_havoc.argtypes = [
+    ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int,
+    ctypes.c_double, ctypes.POINTER(ctypes.c_uint64), ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+    ctypes.c_int, ctypes.POINTER(VMFuzzFind), ctypes.c_int, ctypes.POINTER(ctypes.c_int),
+]
+vm_core.vm_env_fuzz_havoc.restype = ctypes.c_int
+
+vm_core.coverage_edges.argtypes = [ctypes.c_void_p]
+vm_core.coverage_edges.restype = ctypes.c_int
+
+
+def outcome(result: VMEnvResult) -> int:
+    """How a run ended, coded like runlog.outcome_code."""
+    if not result.halted:
+        return result.exit_code
+    interrupt = result.state.interrupt
+    return interrupt if interrupt < -1 else OUTCOME_UNKNOWN_SYSCALL_BASE - interrupt
+
+
+def outcome_slot(code: int) -> int:
+    """Slot of an outcome in the native outcome counts (vm_core's fuzz_outcome_index)."""
+    if code >= 0:
+        return code & 0xFF
+    if code > OUTCOME_UNKNOWN_SYSCALL_BASE:
+        return 256 + min(-code, 15)
+    return 272 + ((OUTCOME_UNKNOWN_SYSCALL_BASE - code) & 0xFF)
+
+
+def slot_outcome(slot: int) -> int:
+    """The outcome of a slot, inverse of outcome_slot."""
+    if slot < 256:
+        return slot
+    if slot < 272:
+        return -(slot - 256)
+    return OUTCOME_UNKNOWN_SYSCALL_BASE - (slot - 272)
+
+
+@dataclass
+class CorpusEntry:
+    program: bytes
+    outcome: int       # See `outcome`
+    coverage: int      # COVERAGE_NEW_EDGE, COVERAGE_NEW_COUNT or 0 (new outcome only)
+    found_at: int      # Executions before it was found
+
+
+class CoverageMap:
+    """The virgin map of a campaign: hit-count classes not yet seen, per edge."""
+
+    def __init__(self):
+        self.virgin = (ctypes.c_uint8 * COVERAGE_MAP_SIZE)(*([0xFF] * COVERAGE_MAP_SIZE))
+
+    @property
+    def edges(self) -> int:
+        return vm_core.coverage_edges(self.virgin)
+
+
+class Fuzzer:
+    """
+    A fuzzing campaign on one native task, e.g.
+    Fuzzer(environments.Environment("maze").task(environments.maze_config(maze)), seeds).
+    The corpus is also kept packed (entry i is `data[offsets[i]:offsets[i + 1]]`)
+    for the native havoc stage, with `fuzzed[i]` counting the times it was a parent.
+    """
+
+    def __init__(self, task: environments.Task, seeds: Iterable[bytes], splice_rate: float = 0.2,
+                 batch_size: int = 1 << 16, max_steps: int = 500, max_finds: int = 1024):
+        self.task = task
+        self.splice_rate = splice_rate
+        self.batch_size = batch_size
+        self.max_steps = max_steps
+        self.coverage = CoverageMap()
+        self.corpus: List[CorpusEntry] = []
+        self.executions = 0
+        self.seconds = 0.0
+        self.data = np.zeros(1 << 16, dtype=np.uint8)
+        self.offsets = np.zeros(1024 + 1, dtype=np.int32)
+        self.fuzzed = np.zeros(1024, dtype=np.uint32)
+        self._rng = ctypes.c_uint64(random.getrandbits(64))
+        self._counts = np.zeros(FUZZ_OUTCOMES, dtype=np.uint64)
+        self._finds = (VMFuzzFind * max_finds)()
+        self._children = (ctypes.c_uint8 * (max_finds * FUZZ_MAX_PROGRAM))()
+        self._executed = ctypes.c_int(0)
+        seeds = [s for s in seeds if s]
+        for i in range(0, len(seeds), 1024):
+            self._execute(seeds[i:i + 1024])
+
+    @property
+    def outcomes(self) -> Dict[int, int]:
+        """Outcome -> executions that ended that way."""
+        return {slot_outcome(int(slot)): int(self._counts[slot]) for slot in np.flatnonzero(self._counts)}
+
+    def _add(self, program: bytes, code: int, coverage: int, found_at: int) -> None:
+        count = len(self.corpus)
+        end = int(self.offsets[count])
+        if end + len(program) > len(self.data):
+            self.data = np.resize(self.data, 2 * (end + len(program)))
+        if count + 1 == len(self.fuzzed):
+            self.fuzzed = np.resize(self.fuzzed, 2 * len(self.fuzzed))
+            self.fuzzed[count + 1:] = 0
+            self.offsets = np.resize(self.offsets, len(self.fuzzed) + 1)
+        self.data[end:end + len(program)] = np.frombuffer(program, dtype=np.uint8)
+        self.offsets[count + 1] = end + len(program)
+        self.corpus.append(CorpusEntry(program, code, coverage, found_at))
+
+    def _execute(self, programs: Sequence[bytes]) -> int:
+        """Runs the programs as they are and adds the interesting ones to the corpus; returns how many."""
+        count = len(programs)
+        offsets = (ctypes.c_int32 * (count + 1))()
+        position = 0
+        for i, program in enumerate(programs):
+            offsets[i] = position
+            position += len(program)
+        offsets[count] = position
+        new = (ctypes.c_uint8 * count)()
+        out = (VMEnvResult * count)()
+        start = time.perf_counter()
+        if vm_core.vm_env_fuzz(self.task._handle, b"".join(programs), offsets, count, self.max_steps,
+                               self.coverage.virgin, new, out) < 0:
+            raise MemoryError("Native fuzzing failed")
+        self.seconds += time.perf_counter() - start
+
+        added = 0
+        for i in range(count):
+            code = outcome(out[i])
+            slot = outcome_slot(code)
+            seen = self._counts[slot]
+            self._counts[slot] += 1
+            if new[i] or not seen:
+                self._add(programs[i], code, new[i], self.executions + i)
+                added += 1
+        self.executions += count
+        return added
+
+    def step(self) -> int:
+        """Mutates and runs one batch natively; returns the number of corpus entries added."""
+        if not self.corpus:
+            raise ValueError("The corpus is empty; give the fuzzer at least one seed program")
+        added = 0
+        remaining = self.batch_size
+        while remaining > 0:
+            start = time.perf_counter()
+            found = vm_core.vm_env_fuzz_havoc(
+                self.task._handle, self.data.ctypes.data, self.offsets.ctypes.data, len(self.corpus),
+                self.fuzzed.ctypes.data, remaining, self.max_steps, self.splice_rate, ctypes.byref(self._rng),
+                self.coverage.virgin, self._counts.ctypes.data, self._children, len(self._children),
+                self._finds, len(self._finds), ctypes.byref(self._executed))
+            self.seconds += time.perf_counter() - start
+            if found < 0:
+                raise MemoryError("Native fuzzing failed")
+            children = memoryview(self._children)
+            for find in self._finds[:found]:
+                self._add(bytes(children[find.offset:find.offset + find.length]), slot_outcome(find.outcome),
+                          find.coverage, self.executions + find.execution)
+            self.executions += self._executed.value
+            remaining -= self._executed.value
+            added += found
+        return added
+
+    def run(self, executions: int, report: Optional[callable] = None) -> None:
+        """Fuzzes for about `executions` more executions, calling `report(self)` after every batch."""
+        target = self.executions + executions
+        while self.executions < target:
+            self.step()
+            if report is not None:
+                report(self)
+
+    @property
+    def native_executions_per_second(self) -> float:
+        """Executions per second inside vm_core, without the Python corpus bookkeeping."""
+        return self.executions / self.seconds if self.seconds else 0.0
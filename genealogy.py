@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+genealogy.py
+
+Walks the lineage recorded in a binary run log (see runlog.py) back from an
+individual, to show which crossovers and mutations produced it.
+
+Every generation's rows carry each individual's parent indices in the
+previous generation, the crossover point and the number of mutations, so the
+ancestry of an individual is found by following those indices one
+generation at a time.
+
+Usage:
+  python3 genealogy.py run.log                      # champion of the last generation
+  python3 genealogy.py run.log --generation 12 --individual 37 --depth 5
+"""
+from __future__ import annotations
+
+import argparse
+import sys
+from dataclasses import dataclass
+from typing import Dict, List, Set
+
+import numpy as np
+
+from runlog import LINEAGE_COLUMNS, RunLogReader
+
+
+@dataclass
+class Ancestor:
+    generation: int
+    individual: int
+    score: int
+    parent1: int
+    parent2: int
+    crossover: int
+    mutations: int
+
+
+def _by_individual(data: Dict[str, np.ndarray], generation: int) -> Dict[str, np.ndarray]:
+    """Rows of one generation, reordered so that row i is individual i."""
+    rows = data["generation"] == generation
+    individuals = data["individual"][rows]
+    size = int(individuals.max()) + 1 if len(individuals) else 0
+    out = {"present": np.zeros(size, dtype=bool)}
+    out["present"][individuals] = True
+    for name in ("score",) + LINEAGE_COLUMNS:
+        column = np.full(size, -1, dtype=np.int64)
+        column[individuals] = data[name][rows]
+        out[name] = column
+    return out
+
+
+def champion(reader: RunLogReader, generation: int) -> int:
+    """Index of the best scoring individual of a generation."""
+    data = reader.load(generation, generation, ["individual", "score"])
+    if not len(data["score"]):
+        raise ValueError(f"Generation {generation} is not in the run log")
+    return int(data["individual"][np.argmax(data["score"])])
+
+
+def ancestry(reader: RunLogReader, generation: int, individual: int, depth: int = 10) -> List[List[Ancestor]]:
+    """
+    Ancestors of `individual`, one list per generation from `generation`
+    backwards (the first list holds the individual itself). Stops after
+    `depth` generations or when no parent is known.
+    """
+    missing = [name for name in LINEAGE_COLUMNS if name not in dict(reader.columns)]
+    if missing:
+        raise ValueError(f"Run log has no lineage columns ({', '.join(missing)})")
+    first = max(0, generation - depth)
+    data = reader.load(first, generation, ["generation", "individual", "score", *LINEAGE_COLUMNS])
+
+    layers: List[List[Ancestor]] = []
+    frontier: Set[int] = {individual}
+    for gen in range(generation, first - 1, -1):
+        if not frontier:
+            break
+        rows = _by_individual(data, gen)
+        size = len(rows["present"])
+        layer = []
+        parents: Set[int] = set()
+        for i in sorted(frontier):
+            if i >= size or not rows["present"][i]:
+                continue
+            record = Ancestor(gen, i, *(int(rows[name][i]) for name in ("score",) + LINEAGE_COLUMNS))
+            layer.append(record)
+            parents.update(p for p in (record.parent1, record.parent2) if p >= 0)
+        if not layer:
+            break
+        layers.append(layer)
+        frontier = parents
+    return layers
+
+
+def _describe(a: Ancestor) -> str:
+    # A negative index is a parent outside the previous generation (e.g. an NSGA-II survivor)
+    name = lambda p: f"#{p}" if p >= 0 else "?"
+    if a.parent1 < 0 and a.crossover < 0:
+        origin = "no recorded parents"
+    elif a.crossover < 0:
+        origin = f"copy of {name(a.parent1)}"
+    else:
+        origin = f"{name(a.parent1)} x {name(a.parent2)} at byte {a.crossover}"
+    return f"#{a.individual:<6d} score {a.score:6d}  <- {origin}, {a.mutations} mutation(s)"
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Trace the ancestry of an individual through a GA run log.")
+    ap.add_argument("log", help="Binary run log written with runner.py --run-log.")
+    ap.add_argument("--generation", type=int, default=None, help="Generation of the individual (default: last).")
+    ap.add_argument("--individual", type=int, default=None,
+                    help="Index of the individual in its generation (default: best score).")
+    ap.add_argument("--depth", type=int, default=10, help="Number of generations to walk back.")
+    args = ap.parse_args()
+
+    try:
+        reader = RunLogReader(args.log)
+        generation = args.generation if args.generation is not None else reader.generations[1]
+        individual = args.individual if args.individual is not None else champion(reader, generation)
+        layers = ancestry(reader, generation, individual, args.depth)
+    except FileNotFoundError:
+        print(f"Error: Run log not found at '{args.log}'", file=sys.stderr)
+        sys.exit(1)
+    except ValueError as e:
+        print(f"Run log error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    if not layers:
+        print(f"Individual {individual} of generation {generation} is not in the run log", file=sys.stderr)
+        sys.exit(1)
+    for layer in layers:
+        print(f"--- Generation {layer[0].generation} ({len(layer)} ancestor(s)) ---")
+        for a in layer:
+            print(f"  {_describe(a)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,15 +1,26 @@
 from __future__ import annotations
 
 import random
-from statistics import mean
 import numpy as np
 from typing import TYPE_CHECKING, Any, Callable, List, Optional, Tuple
 import bitarray
 
 from scorer import ScoredProgram
+from score_stats import ScoreStats
+from telemetry import NullTelemetry, Telemetry
 if TYPE_CHECKING:
     from misc import Endian
 
+# How each child of a generation was bred. Parents are indices into the previous
+# generation's population (-1 for none, or a parent that is not from the previous
+# generation); crossover is the byte offset of the cut, -1 when the child is a copy.
+LINEAGE_DTYPE = np.dtype([
+    ("parent1", "<i4"),
+    ("parent2", "<i4"),
+    ("crossover", "<i2"),
+    ("mutations", "<u2"),
+])
+
 def _normalize_data(data):
     if len(set(data)) == 1 :
         return [1] * len(data)
@@ -23,10 +34,14 @@ class GeneticAlgo() :
                 test_func: Callable[[List[bytes]], ScoredProgram],
                 hook_next_gen: Callable[[int], None] = lambda _ : None,
                 hook_finished: Callable[[], None] = lambda _ : None,
-                hook_selection: Callable[[float], None] = lambda _ : None,
+                hook_selection: Callable[[ScoreStats], None] = lambda _ : None,
                 hook_reproduction: Callable[[], None] = lambda _ : None,
                 hook_log_scores: Callable[[int, List[int]], None] = lambda _, __ : None,
+                hook_log_population: Callable[[int, List[bytes]], None] = lambda _, __ : None,
+                hook_log_results: Callable[[int, List[ScoredProgram], Optional[np.ndarray]], None] = lambda _, __, ___ : None,
+                hook_checkpoint: Callable[[int, List[bytes], List[ScoredProgram]], None] = lambda _, __, ___ : None,
                 endian: Endian = "little",
+                telemetry: Optional[Telemetry] = None,
                 **kwargs # additional variables to pass to the test function    
             ) :
         self.point_mutation_rate = mutation_rate
@@ -39,14 +54,26 @@ class GeneticAlgo() :
         self.hook_selection = hook_selection
         self.hook_reproduction = hook_reproduction
         self.hook_log_scores = hook_log_scores
+        self.hook_log_population = hook_log_population
+        self.hook_log_results = hook_log_results
+        self.hook_checkpoint = hook_checkpoint
         self.endian = endian
+        self.telemetry = telemetry or NullTelemetry()
         self.kwargs = kwargs
+        self.score_stats = ScoreStats()  # Statistics of the last tested generation
+        self.lineage: Optional[np.ndarray] = None  # LINEAGE_DTYPE per individual of the current population
+
+    def _crossover_point(self, p1_bytes: bytes, p2_bytes: bytes) -> int:
+        """Draws a crossover point on an instruction boundary, or -1 for no crossover."""
+        if random.random() > self.crossover_rate :
+            return -1
+        return random.randint(0, min(len(p1_bytes), len(p2_bytes)) // 2) * 2
 
     def _crossover(self, p1_bytes: bytes, p2_bytes: bytes) -> Tuple[bytes, bytes]:
         """Performs single-point crossover on two parent byte strings."""
-        if random.random() > self.crossover_rate :
+        crossover = self._crossover_point(p1_bytes, p2_bytes)
+        if crossover < 0 :
             return p1_bytes, p2_bytes
-        crossover = random.randint(0, min(len(p1_bytes), len(p2_bytes)) // 2) * 2
         children = (
             p1_bytes[:crossover] + p2_bytes[crossover:],
             p2_bytes[:crossover] + p1_bytes[crossover:],
@@ -70,15 +97,21 @@ class GeneticAlgo() :
 
     def _mutate(self, program_bytes: bytes) -> bytes:
         """Applies bit-flip mutation to a byte string."""
+        return self._mutate_counted(program_bytes)[0]
+
+    def _mutate_counted(self, program_bytes: bytes) -> Tuple[bytes, int]:
+        """Like _mutate, but also returns how many mutations were applied."""
         if self.point_mutation_rate == 0:
-            return program_bytes
+            return program_bytes, 0
         
         mutated_bits = bitarray.bitarray()
         mutated_bits.frombytes(program_bytes)
         
+        mutations = 0
         i = 0
         while i < len(mutated_bits) : 
             if random.random() < self.point_mutation_rate :
+                mutations += 1
                 mutated_bits = self._point_mutate(mutated_bits, i)
                 mutate_type = random.choice([0, 1, 2])
                 if mutate_type == 0 :
@@ -91,23 +124,61 @@ class GeneticAlgo() :
                     i -= 1
             i += 1
                 
-        return mutated_bits.tobytes()
+        return mutated_bits.tobytes(), mutations
 
-    def _select(self, scored_population: List[ScoredProgram]) -> list[tuple[bytes, bytes]] :
+    def _select(self, scored_population: List[ScoredProgram]) -> list[tuple[ScoredProgram, ScoredProgram]] :
         """Select which individuals to allow to reproduce and pair them off"""
         normalized_scores = _normalize_data([s.score for s in scored_population])
         p1 = random.choices(scored_population, weights=normalized_scores, k=len(scored_population) // 2)
         p2 = random.choices(scored_population, weights=normalized_scores, k=len(scored_population) // 2)
-        return [ (x.program_bytes, y.program_bytes) for x, y in zip(p1, p2) ]
+        return list(zip(p1, p2))
+
+    def _reproduce(self, parents: List[Tuple[ScoredProgram, ScoredProgram]]) -> Tuple[List[bytes], np.ndarray]:
+        """
+        Crosses over and mutates each pair of parents into two children. Returns
+        the children and their lineage, one LINEAGE_DTYPE record per child.
+        """
+        children: List[bytes] = []
+        records: List[Tuple[int, int, int, int]] = []
+        for p1, p2 in parents:
+            crossover = self._crossover_point(p1.program_bytes, p2.program_bytes)
+            for head, tail in ((p1, p2), (p2, p1)):
+                if crossover < 0:
+                    child, donor = head.program_bytes, -1
+                else:
+                    child = head.program_bytes[:crossover] + tail.program_bytes[crossover:]
+                    donor = tail.index
+                child, mutations = self._mutate_counted(child)
+                children.append(child)
+                records.append((head.index, donor, min(crossover, 0x7FFF), min(mutations, 0xFFFF)))
+        return children, np.array(records, dtype=LINEAGE_DTYPE)
+
+    def _evaluate(self, population: List[bytes], **kwargs: Any) -> List[ScoredProgram]:
+        """
+        Tests a population. The test function is handed ``score_stats`` to update
+        as results arrive; if it does not, the scores are added in one native pass.
+        It also gets ``telemetry``, to report counters of its own.
+        """
+        stats = ScoreStats()
+        scored_population = self.test_func(population, score_stats=stats, telemetry=self.telemetry, **kwargs)
+        if len(stats) != len(scored_population):
+            stats.reset()
+            stats.add_many([s.score for s in scored_population])
+        self.score_stats = stats
+        return scored_population
 
     def run(
                 self,
                 population: List[bytes], 
                 total_generations: int = 0, 
                 exit_criteria: Optional[Callable[[List[Any], int], bool]] = None,
+                start_generation: int = 0,
                 **kwargs # additional variables to pass to the test function
             ) :
-        """Runs a single generation of programs and returns their scores."""
+        """
+        Runs generations of programs and returns the last generation's scores.
+        `start_generation` resumes the generation counter, e.g. from a checkpoint.
+        """
         additional_vars = { **self.kwargs, **kwargs }
 
         if exit_criteria is None :
@@ -115,25 +186,33 @@ class GeneticAlgo() :
                 raise ValueError("You must specify either a total number of generations or an exit criteria")
             exit_criteria = lambda _, gen : gen + 1 >= total_generations
         
-        current_generation = 0
+        current_generation = start_generation
         scored_population: List[ScoredProgram] = []
+        telemetry = self.telemetry
 
         while True:
             self.hook_next_gen(current_generation)
-            scored_population = self.test_func(population, **additional_vars)
+            telemetry.begin_generation(current_generation, len(population))
+            with telemetry.phase("test"):
+                scored_population = self._evaluate(population, **additional_vars)
             scores = [s.score for s in scored_population]
             self.hook_log_scores(current_generation, scores)
+            self.hook_log_population(current_generation, population)
+            self.hook_log_results(current_generation, scored_population, self.lineage)
             if exit_criteria(population, current_generation) :
+                telemetry.end_generation(len(scored_population))
                 self.hook_finished()
                 break
-            self.hook_selection(mean(scores))
-            survivors = self._select(scored_population)
+            self.hook_selection(self.score_stats)
+            with telemetry.phase("select"):
+                survivors = self._select(scored_population)
             self.hook_reproduction()
             # Create children, mutate them, and flatten the resulting list of pairs
             # into a single list for the next generation.
-            population = [ self._mutate(child) 
-                           for p1, p2 in survivors 
-                           for child in self._crossover(p1, p2) ]
+            with telemetry.phase("reproduce"):
+                population, self.lineage = self._reproduce(survivors)
+            telemetry.end_generation(len(scored_population))
             current_generation += 1
+            self.hook_checkpoint(current_generation, population, scored_population)
         
         return scored_population
@@ -0,0 +1,507 @@
+#!/usr/bin/env python3
+"""
+genome_archive.py
+
+Deduplicated, compressed archive of every genome a run evaluates.
+
+Genomes are identified by a 16-byte BLAKE2b hash and stored once. Each new
+genome gets a sequential id and is written as a patch against its recorded
+parent when there is one: the XOR of the two over the parent's length (mostly
+zero bytes for a lightly mutated child) followed by any extra tail. Records
+are packed into blocks that are zlib compressed as a whole. Patch chains are
+cut every `max_chain` links so that reading a genome never decodes more than
+that many records.
+
+File layout (little endian):
+  header  magic "GAGENOME", u16 version
+  block   magic "BLCK", u32 compressed size, u32 first id, u32 record count,
+          then zlib data: per record a varint genome length, a varint parent
+          distance (id - parent id, 0 for a genome stored whole) and `length`
+          bytes of genome or patch
+  index   magic "GAINDEX\\0", u64 blocks, per block u64 file offset, u32 first
+          id, u32 count; u64 genomes, per id u32 record offset in its block;
+          then all hashes sorted, 16 bytes each, and the matching u32 ids
+  footer  u64 index offset, magic "GAGENEND"
+
+The index is written by close(). A file without one (e.g. after a crash) is
+reindexed by scanning its blocks. A resumed run reopens the archive, drops the
+old index and appends new blocks after the existing ones.
+
+Usage:
+  python3 genome_archive.py info genomes.gar
+  python3 genome_archive.py get genomes.gar HASH
+  python3 genome_archive.py dump genomes.gar [--limit N]
+"""
+from __future__ import annotations
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import zlib
+from functools import lru_cache
+from typing import BinaryIO, Dict, Iterator, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+MAGIC = b"GAGENOME"
+VERSION = 1
+_FILE_HEADER = struct.Struct("<8sH")
+_BLOCK = struct.Struct("<4sIII")
+BLOCK_MAGIC = b"BLCK"
+INDEX_MAGIC = b"GAINDEX\0"
+_BLOCK_ENTRY = np.dtype([("offset", "<u8"), ("first_id", "<u4"), ("count", "<u4")])
+_FOOTER = struct.Struct("<Q8s")
+FOOTER_MAGIC = b"GAGENEND"
+
+HASH_SIZE = 16
+_HASH_DTYPE = np.dtype(f"S{HASH_SIZE}")
+
+
+def genome_hash(genome: bytes) -> bytes:
+    return hashlib.blake2b(genome, digest_size=HASH_SIZE).digest()
+
+
+def _xor(genome: bytes, parent: bytes) -> bytes:
+    """XOR of `genome` with `parent` over the shorter length, then genome's own tail."""
+    n = min(len(genome), len(parent))
+    if n == 0:
+        return genome
+    head = (int.from_bytes(genome[:n], "little") ^ int.from_bytes(parent[:n], "little")).to_bytes(n, "little")
+    return head + genome[n:]
+
+
+def _put_varint(out: bytearray, value: int) -> None:
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+
+def _get_varint(data: bytes, offset: int) -> Tuple[int, int]:
+    value = shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, offset
+        shift += 7
+
+
+class _SortedHashes:
+    """
+    Hash -> id map kept as a few sorted NumPy runs plus a small dict of recent
+    inserts. The dict is flushed into a new run in bulk, and runs are merged
+    pairwise whenever the newer one is at least half the size of the older, so
+    there are O(log n) runs and every id is merged O(log n) times. About 20
+    bytes per genome.
+    """
+
+    def __init__(self, pending_limit: int = 1 << 16):
+        self.runs: List[Tuple[np.ndarray, np.ndarray]] = []  # (keys, ids), largest first
+        self.pending: Dict[bytes, int] = {}
+        self.pending_limit = pending_limit
+
+    def __len__(self) -> int:
+        return sum(len(keys) for keys, _ in self.runs) + len(self.pending)
+
+    def lookup(self, hashes: Sequence[bytes]) -> np.ndarray:
+        """Id of each hash, -1 where unknown."""
+        out = np.full(len(hashes), -1, dtype=np.int64)
+        if self.runs and len(hashes):
+            query = np.array(hashes, dtype=_HASH_DTYPE)
+            for keys, ids in self.runs:
+                pos = np.minimum(np.searchsorted(keys, query), len(keys) - 1)
+                found = keys[pos] == query
+                out[found] = ids[pos[found]]
+        if self.pending:
+            for i, h in enumerate(hashes):
+                if out[i] < 0:
+                    out[i] = self.pending.get(h, -1)
+        return out
+
+    def insert(self, h: bytes, genome_id: int) -> None:
+        self.pending[h] = genome_id
+        if len(self.pending) >= self.pending_limit:
+            self.flush()
+
+    def add_run(self, keys: np.ndarray, ids: np.ndarray) -> None:
+        """Adds sorted keys and their ids, merging runs of similar size."""
+        while self.runs and len(self.runs[-1][0]) <= 2 * len(keys):
+            old_keys, old_ids = self.runs.pop()
+            pos = np.searchsorted(old_keys, keys)
+            keys, ids = np.insert(old_keys, pos, keys), np.insert(old_ids, pos, ids)
+        self.runs.append((keys, ids))
+
+    def flush(self) -> None:
+        if not self.pending:
+            return
+        keys = np.array(list(self.pending.keys()), dtype=_HASH_DTYPE)
+        ids = np.fromiter(self.pending.values(), dtype="<u4", count=len(self.pending))
+        order = np.argsort(keys)
+        self.pending.clear()
+        self.add_run(keys[order], ids[order])
+
+    def merge(self) -> Tuple[np.ndarray, np.ndarray]:
+        """Folds everything into a single run and returns its keys and ids."""
+        self.flush()
+        while len(self.runs) > 1:
+            keys, ids = self.runs.pop()
+            old_keys, old_ids = self.runs.pop()
+            pos = np.searchsorted(old_keys, keys)
+            self.runs.append((np.insert(old_keys, pos, keys), np.insert(old_ids, pos, ids)))
+        if not self.runs:
+            return np.zeros(0, dtype=_HASH_DTYPE), np.zeros(0, dtype="<u4")
+        return self.runs[0]
+
+
+class GenomeArchive:
+    """
+    Append-only writer. Use log_generation as a GeneticAlgo ``hook_log_results``.
+    With `resume` an existing archive is reopened and appended to (its index is
+    rewritten by close()); otherwise the file is overwritten.
+    """
+
+    def __init__(self, path: str, block_size: int = 1 << 16, max_chain: int = 16, level: int = 6,
+                 resume: bool = False):
+        self.block_size = block_size
+        self.max_chain = max_chain
+        self.level = level
+        self.evaluated = 0
+        self._hashes = _SortedHashes()
+        self._blocks: List[Tuple[int, int, int]] = []
+        self._record_offsets = np.zeros(1 << 16, dtype="<u4")
+        self._depths = np.zeros(1 << 16, dtype=np.uint8)
+        self._count = 0
+        self._block = bytearray()
+        self._block_first = 0
+        # Genomes of the last logged generation, by population index, for parent lookups
+        self._previous: List[bytes] = []
+        if resume and os.path.exists(path) and os.path.getsize(path) > 0:
+            self._resume(path)
+            return
+        self._file: BinaryIO = open(path, "wb")
+        self._file.write(_FILE_HEADER.pack(MAGIC, VERSION))
+
+    def _resume(self, path: str) -> None:
+        reader = GenomeArchiveReader(path)
+        try:
+            self._blocks = [tuple(b) for b in reader._blocks.tolist()]
+            self._count = len(reader)
+            self._record_offsets = np.resize(reader._record_offsets, max(1 << 16, 2 * self._count))
+            self._depths = np.resize(reader.depths(), len(self._record_offsets))
+            self._hashes.add_run(reader._keys.copy(), reader._ids.copy())
+            end = reader.end
+        finally:
+            reader.close()
+        self._file = open(path, "r+b")
+        self._file.truncate(end)  # Drops the old index, or a torn tail
+        self._file.seek(end)
+
+    def __len__(self) -> int:
+        return self._count
+
+    def _grow(self) -> None:
+        if self._count == len(self._record_offsets):
+            self._record_offsets = np.resize(self._record_offsets, 2 * self._count)
+            self._depths = np.resize(self._depths, 2 * self._count)
+
+    def add_many(self, genomes: Sequence[bytes], parents: Optional[Sequence[Optional[bytes]]] = None) -> np.ndarray:
+        """
+        Archives a batch of genomes, each optionally with the parent genome to
+        patch against. Returns the id of every genome (existing ids for duplicates).
+        """
+        self.evaluated += len(genomes)
+        hashes = [genome_hash(g) for g in genomes]
+        ids = self._hashes.lookup(hashes)
+        parent_ids = None
+        if parents is not None:
+            parent_ids = self._hashes.lookup([genome_hash(p) if p is not None else b"" for p in parents])
+        added: Dict[bytes, int] = {}
+        for i, genome in enumerate(genomes):
+            if ids[i] >= 0:
+                continue
+            if hashes[i] in added:  # Duplicate within the batch
+                ids[i] = added[hashes[i]]
+                continue
+            parent_id = int(parent_ids[i]) if parent_ids is not None else -1
+            ids[i] = added[hashes[i]] = self._append(hashes[i], genome, parent_id,
+                                                     parents[i] if parent_id >= 0 else None)
+        return ids
+
+    def add(self, genome: bytes, parent: Optional[bytes] = None) -> int:
+        return int(self.add_many([genome], None if parent is None else [parent])[0])
+
+    def _append(self, h: bytes, genome: bytes, parent_id: int, parent: Optional[bytes]) -> int:
+        genome_id = self._count
+        self._grow()
+        depth = 0
+        if parent is not None and self._depths[parent_id] < self.max_chain:
+            depth = int(self._depths[parent_id]) + 1
+            payload, distance = _xor(genome, parent), genome_id - parent_id
+        else:
+            payload, distance = genome, 0
+        if not self._block:
+            self._block_first = genome_id
+        self._record_offsets[genome_id] = len(self._block)
+        self._depths[genome_id] = depth
+        _put_varint(self._block, len(genome))
+        _put_varint(self._block, distance)
+        self._block += payload
+        self._count += 1
+        self._hashes.insert(h, genome_id)
+        if len(self._block) >= self.block_size:
+            self.flush()
+        return genome_id
+
+    def log_generation(self, _generation: int, scored_population, lineage: Optional[np.ndarray] = None) -> None:
+        """Archives a scored generation, patching each child against its first parent."""
+        genomes = [sp.program_bytes for sp in scored_population]
+        parents: Optional[List[Optional[bytes]]] = None
+        if lineage is not None and self._previous:
+            parents = []
+            for sp in scored_population:
+                p = int(lineage["parent1"][sp.index]) if sp.index >= 0 else -1
+                parents.append(self._previous[p] if 0 <= p < len(self._previous) else None)
+        self.add_many(genomes, parents)
+        previous: List[bytes] = [b""] * (max((sp.index for sp in scored_population), default=-1) + 1)
+        for sp in scored_population:
+            if sp.index >= 0:
+                previous[sp.index] = sp.program_bytes
+        self._previous = previous
+
+    def flush(self) -> None:
+        if not self._block:
+            return
+        data = zlib.compress(bytes(self._block), self.level)
+        count = self._count - self._block_first
+        self._blocks.append((self._file.tell(), self._block_first, count))
+        self._file.write(_BLOCK.pack(BLOCK_MAGIC, len(data), self._block_first, count))
+        self._file.write(data)
+        self._file.flush()
+        self._block = bytearray()
+
+    def close(self) -> None:
+        """Flushes the last block and writes the sorted index and footer."""
+        self.flush()
+        keys, ids = self._hashes.merge()
+        index_offset = self._file.tell()
+        blocks = np.array(self._blocks, dtype=_BLOCK_ENTRY)
+        self._file.write(INDEX_MAGIC)
+        self._file.write(struct.pack("<Q", len(blocks)))
+        self._file.write(blocks.tobytes())
+        self._file.write(struct.pack("<Q", self._count))
+        self._file.write(self._record_offsets[:self._count].tobytes())
+        self._file.write(keys.tobytes())
+        self._file.write(ids.tobytes())
+        self._file.write(_FOOTER.pack(index_offset, FOOTER_MAGIC))
+        self._file.close()
+
+    @property
+    def bytes_written(self) -> int:
+        return self._file.tell() if not self._file.closed else 0
+
+    def __enter__(self) -> GenomeArchive:
+        return self
+
+    def __exit__(self, *_) -> None:
+        self.close()
+
+
+class GenomeArchiveReader:
+    """Random access by hash or id, and streaming iteration in id order."""
+
+    def __init__(self, path: str, cached_blocks: int = 64):
+        self._file: BinaryIO = open(path, "rb")
+        magic, version = _FILE_HEADER.unpack(self._file.read(_FILE_HEADER.size))
+        if magic != MAGIC:
+            raise ValueError("Not a genome archive")
+        if version != VERSION:
+            raise ValueError(f"Unsupported genome archive version {version}")
+        self._block = lru_cache(maxsize=cached_blocks)(self._read_block)
+        if not self._read_index():
+            self._scan()
+
+    def close(self) -> None:
+        self._file.close()
+
+    def __len__(self) -> int:
+        return len(self._record_offsets)
+
+    def _read_index(self) -> bool:
+        self._file.seek(0, 2)
+        size = self._file.tell()
+        if size < _FILE_HEADER.size + _FOOTER.size:
+            return False
+        self._file.seek(size - _FOOTER.size)
+        index_offset, magic = _FOOTER.unpack(self._file.read(_FOOTER.size))
+        if magic != FOOTER_MAGIC or index_offset >= size:
+            return False
+        self._file.seek(index_offset)
+        data = self._file.read(size - _FOOTER.size - index_offset)
+        if data[:8] != INDEX_MAGIC:
+            return False
+        offset = 8
+        (num_blocks,) = struct.unpack_from("<Q", data, offset)
+        offset += 8
+        self._blocks = np.frombuffer(data, dtype=_BLOCK_ENTRY, count=num_blocks, offset=offset)
+        offset += num_blocks * _BLOCK_ENTRY.itemsize
+        (count,) = struct.unpack_from("<Q", data, offset)
+        offset += 8
+        self._record_offsets = np.frombuffer(data, dtype="<u4", count=count, offset=offset)
+        offset += 4 * count
+        self._keys = np.frombuffer(data, dtype=_HASH_DTYPE, count=count, offset=offset)
+        offset += HASH_SIZE * count
+        self._ids = np.frombuffer(data, dtype="<u4", count=count, offset=offset)
+        self.end = index_offset  # End of the last block
+        return True
+
+    def _scan(self) -> None:
+        """Rebuilds the index of an archive that was not closed cleanly."""
+        blocks: List[Tuple[int, int, int]] = []
+        offsets: List[int] = []
+        offset = _FILE_HEADER.size
+        self._file.seek(offset)
+        while True:
+            header = self._file.read(_BLOCK.size)
+            if len(header) < _BLOCK.size:
+                break
+            magic, size, first_id, count = _BLOCK.unpack(header)
+            data = self._file.read(size)
+            if magic != BLOCK_MAGIC or len(data) < size or first_id != len(offsets):
+                break
+            try:
+                raw = zlib.decompress(data)
+            except zlib.error:
+                break  # Torn tail
+            blocks.append((offset, first_id, count))
+            pos = 0
+            for _ in range(count):
+                offsets.append(pos)
+                length, pos = _get_varint(raw, pos)
+                _, pos = _get_varint(raw, pos)
+                pos += length
+            offset += _BLOCK.size + size
+        self.end = offset
+        self._blocks = np.array(blocks, dtype=_BLOCK_ENTRY)
+        self._record_offsets = np.array(offsets, dtype="<u4")
+        keys = np.array([genome_hash(g) for g in self], dtype=_HASH_DTYPE)
+        order = np.argsort(keys, kind="stable")
+        self._keys = keys[order]
+        self._ids = order.astype("<u4")
+
+    def _read_block(self, block: int) -> bytes:
+        offset = int(self._blocks["offset"][block])
+        self._file.seek(offset)
+        _, size, _, _ = _BLOCK.unpack(self._file.read(_BLOCK.size))
+        return zlib.decompress(self._file.read(size))
+
+    def _record(self, genome_id: int) -> Tuple[bytes, int]:
+        block = int(np.searchsorted(self._blocks["first_id"], genome_id, side="right")) - 1
+        raw = self._block(block)
+        length, pos = _get_varint(raw, int(self._record_offsets[genome_id]))
+        distance, pos = _get_varint(raw, pos)
+        return raw[pos:pos + length], distance
+
+    def depths(self) -> np.ndarray:
+        """Patch chain length of every genome (0 for one stored whole)."""
+        depths = np.zeros(len(self), dtype=np.uint8)
+        for block_id, (_, first_id, count) in enumerate(self._blocks.tolist()):
+            raw = self._read_block(block_id)
+            pos = 0
+            for genome_id in range(first_id, first_id + count):
+                length, pos = _get_varint(raw, pos)
+                distance, pos = _get_varint(raw, pos)
+                pos += length
+                if distance:
+                    depths[genome_id] = depths[genome_id - distance] + 1
+        return depths
+
+    def get_id(self, genome_id: int) -> bytes:
+        if not 0 <= genome_id < len(self):
+            raise IndexError(f"Genome id {genome_id} out of range")
+        payload, distance = self._record(genome_id)
+        if distance == 0:
+            return payload
+        return _xor(payload, self.get_id(genome_id - distance))
+
+    def id_of(self, h: bytes) -> int:
+        """Id of the genome with hash `h`, -1 if it is not archived."""
+        if not len(self._keys):
+            return -1
+        query = np.array([h], dtype=_HASH_DTYPE)
+        pos = min(int(np.searchsorted(self._keys, query)[0]), len(self._keys) - 1)
+        return int(self._ids[pos]) if self._keys[pos] == query[0] else -1
+
+    def get(self, h: bytes) -> Optional[bytes]:
+        genome_id = self.id_of(h)
+        return self.get_id(genome_id) if genome_id >= 0 else None
+
+    def __contains__(self, genome: bytes) -> bool:
+        return self.id_of(genome_hash(genome)) >= 0
+
+    def __iter__(self) -> Iterator[bytes]:
+        """Every archived genome in id order, decoding one block at a time."""
+        recent: Dict[int, bytes] = {}
+        for block_id, (_, first_id, count) in enumerate(self._blocks.tolist()):
+            raw = self._read_block(block_id)
+            pos = 0
+            for genome_id in range(first_id, first_id + count):
+                length, pos = _get_varint(raw, pos)
+                distance, pos = _get_varint(raw, pos)
+                payload = raw[pos:pos + length]
+                pos += length
+                if distance:
+                    parent_id = genome_id - distance
+                    parent = recent.get(parent_id)
+                    payload = _xor(payload, parent if parent is not None else self.get_id(parent_id))
+                recent[genome_id] = payload
+                yield payload
+            # Parents are usually from the previous generation, a few blocks back at most
+            if len(recent) > 1 << 18:
+                for old in list(recent)[:len(recent) // 2]:
+                    del recent[old]
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Inspect a genome archive.")
+    sub = ap.add_subparsers(dest="command", required=True)
+    info = sub.add_parser("info", help="Print the number of genomes and blocks.")
+    info.add_argument("archive")
+    get = sub.add_parser("get", help="Print the genome with a given hash as hex.")
+    get.add_argument("archive")
+    get.add_argument("hash", help="32 hex digits.")
+    dump = sub.add_parser("dump", help="Print every genome as 'hash genome' hex lines.")
+    dump.add_argument("archive")
+    dump.add_argument("--limit", type=int, default=None)
+    args = ap.parse_args()
+
+    try:
+        reader = GenomeArchiveReader(args.archive)
+    except FileNotFoundError:
+        print(f"Error: Genome archive not found at '{args.archive}'", file=sys.stderr)
+        sys.exit(1)
+    except ValueError as e:
+        print(f"Genome archive error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    if args.command == "info":
+        print(f"Genomes: {len(reader)}")
+        print(f"Blocks : {len(reader._blocks)}")
+    elif args.command == "get":
+        genome = reader.get(bytes.fromhex(args.hash))
+        if genome is None:
+            print(f"No genome with hash {args.hash}", file=sys.stderr)
+            sys.exit(1)
+        print(genome.hex())
+    else:
+        for i, genome in enumerate(reader):
+            if args.limit is not None and i >= args.limit:
+                break
+            print(f"{genome_hash(genome).hex()} {genome.hex()}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,183 @@
+"""
+map_elites.py
+
+MAP-Elites, an alternative to GeneticAlgo's single population.
+
+The archive is a grid keyed by bucketed behaviour features (by default the
+end position, effective program length and syscall count of a maze run, see
+behaviour.maze_features). Each cell keeps only the best genome that landed in
+it, so the search keeps many different *kinds* of solution alive instead of
+converging on one. Offspring are bred from elites drawn uniformly across the
+occupied cells using GeneticAlgo's crossover and mutation operators.
+
+The grid, its genome store and batch insertion live in vm_core.
+"""
+from __future__ import annotations
+
+import ctypes
+from typing import Any, Callable, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+from arena import PopulationArena
+from behaviour import maze_features
+from genetics import GeneticAlgo
+from misc import vm_core
+from scorer import ScoredProgram
+
+_u8p = ctypes.POINTER(ctypes.c_uint8)
+_u32p = ctypes.POINTER(ctypes.c_uint32)
+_i32p = ctypes.POINTER(ctypes.c_int32)
+_dp = ctypes.POINTER(ctypes.c_double)
+
+vm_core.map_elites_new.argtypes = [ctypes.c_int, ctypes.POINTER(ctypes.c_int), _dp, _dp, ctypes.c_int, ctypes.c_uint64]
+vm_core.map_elites_new.restype = ctypes.c_void_p
+
+vm_core.map_elites_free.argtypes = [ctypes.c_void_p]
+vm_core.map_elites_free.restype = None
+
+vm_core.map_elites_size.argtypes = [ctypes.c_void_p]
+vm_core.map_elites_size.restype = ctypes.c_int
+
+vm_core.map_elites_insert.argtypes = [ctypes.c_void_p, _dp, _dp, _u8p, _u32p, ctypes.c_int, ctypes.c_int, _u8p]
+vm_core.map_elites_insert.restype = ctypes.c_int
+
+vm_core.map_elites_sample.argtypes = [ctypes.c_void_p, ctypes.c_int, _u8p, _u32p, _i32p]
+vm_core.map_elites_sample.restype = ctypes.c_int
+
+vm_core.map_elites_export.argtypes = [ctypes.c_void_p, _i32p, _dp, _u8p, _u32p]
+vm_core.map_elites_export.restype = ctypes.c_int
+
+# (bins, low, high) per feature of behaviour.maze_features for a 15x15 maze
+Axis = Tuple[int, float, float]
+DEFAULT_AXES: List[Axis] = [
+    (15, 0.0, 15.0),   # end y
+    (15, 0.0, 15.0),   # end x
+    (16, 0.0, 128.0),  # effective program length, instructions
+    (16, 0.0, 64.0),   # syscalls issued
+]
+
+
+class MapElitesArchive:
+    """A MAP-Elites grid held by vm_core."""
+
+    def __init__(self, axes: Sequence[Axis] = DEFAULT_AXES, stride: int = 256, seed: int = 0):
+        dims = len(axes)
+        self.axes = list(axes)
+        self.stride = stride
+        bins = (ctypes.c_int * dims)(*(a[0] for a in axes))
+        lows = (ctypes.c_double * dims)(*(a[1] for a in axes))
+        highs = (ctypes.c_double * dims)(*(a[2] for a in axes))
+        self._handle = vm_core.map_elites_new(dims, bins, lows, highs, stride, seed)
+        if not self._handle:
+            raise ValueError("Invalid MAP-Elites axes or stride")
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.map_elites_free(self._handle)
+            self._handle = None
+
+    def __len__(self) -> int:
+        return vm_core.map_elites_size(self._handle)
+
+    @property
+    def cells(self) -> int:
+        return int(np.prod([a[0] for a in self.axes]))
+
+    def insert(self, arena: PopulationArena, features: np.ndarray, scores: np.ndarray) -> np.ndarray:
+        """Offers a whole evaluated batch in one call. Returns a per-genome 'kept' mask."""
+        count = len(arena)
+        features = np.ascontiguousarray(features, dtype=np.float64).reshape(count, len(self.axes))
+        scores = np.ascontiguousarray(scores, dtype=np.float64)
+        inserted = np.zeros(count, dtype=np.uint8)
+        if vm_core.map_elites_insert(self._handle, features.ctypes.data_as(_dp), scores.ctypes.data_as(_dp),
+                                     arena.data_ptr(), arena.lengths_ptr(), count, arena.stride,
+                                     inserted.ctypes.data_as(_u8p)) < 0:
+            raise RuntimeError("map_elites_insert failed in C core.")
+        return inserted.astype(bool)
+
+    def sample(self, count: int) -> PopulationArena:
+        """Draws `count` elites uniformly from the occupied cells."""
+        data = np.zeros((count, self.stride), dtype=np.uint8)
+        lengths = np.zeros(count, dtype=np.uint32)
+        drawn = vm_core.map_elites_sample(self._handle, count, data.ctypes.data_as(_u8p),
+                                          lengths.ctypes.data_as(_u32p), None)
+        return PopulationArena(data[:drawn], lengths[:drawn])
+
+    def elites(self) -> Tuple[np.ndarray, np.ndarray, PopulationArena]:
+        """Returns (cell indices, scores, genomes) of every elite."""
+        size = len(self)
+        cells = np.zeros(size, dtype=np.int32)
+        scores = np.zeros(size, dtype=np.float64)
+        data = np.zeros((size, self.stride), dtype=np.uint8)
+        lengths = np.zeros(size, dtype=np.uint32)
+        vm_core.map_elites_export(self._handle, cells.ctypes.data_as(_i32p), scores.ctypes.data_as(_dp),
+                                  data.ctypes.data_as(_u8p), lengths.ctypes.data_as(_u32p))
+        return cells, scores, PopulationArena(data, lengths)
+
+
+class MapElites:
+    """
+    Runs MAP-Elites with the same test functions and hooks as GeneticAlgo.
+
+    The test function is called with ``describe=<feature function>`` and must
+    fill in ``ScoredProgram.descriptor`` with the raw features. Genomes longer
+    than the archive's stride are scored but never offered to the archive, as
+    storing them truncated would keep a program that did not earn the score.
+    """
+
+    def __init__(
+                self,
+                operators: GeneticAlgo,
+                archive: Optional[MapElitesArchive] = None,
+                batch_size: int = 1000,
+                describe: Callable[..., Any] = maze_features,
+                **kwargs # additional variables to pass to the test function
+            ) :
+        self.operators = operators
+        self.archive = archive or MapElitesArchive()
+        self.batch_size = batch_size
+        self.describe = describe
+        self.kwargs = kwargs
+
+    def _evaluate(self, population: List[bytes], **kwargs: Any) -> List[ScoredProgram]:
+        scored = self.operators._evaluate(population, describe=self.describe, **kwargs)
+        if not scored:
+            return scored
+        fitting = [sp for sp in scored if len(sp.program_bytes) <= self.archive.stride]
+        if not fitting:
+            return scored
+        arena = PopulationArena.from_population([sp.program_bytes for sp in fitting], self.archive.stride)
+        features = np.array([sp.descriptor for sp in fitting], dtype=np.float64)
+        scores = np.array([sp.score for sp in fitting], dtype=np.float64)
+        self.archive.insert(arena, features, scores)
+        return scored
+
+    def _breed(self) -> List[bytes]:
+        parents = self.archive.sample(self.batch_size + self.batch_size % 2).to_population()
+        return [ self.operators._mutate(child)
+                 for p1, p2 in zip(parents[::2], parents[1::2])
+                 for child in self.operators._crossover(p1, p2) ]
+
+    def run(self, population: List[bytes], total_generations: int, **kwargs: Any) -> List[ScoredProgram]:
+        """
+        Evaluates the initial population, then breeds and evaluates one batch per
+        further generation. Returns the last evaluated batch.
+        """
+        ga = self.operators
+        additional_vars = { **ga.kwargs, **self.kwargs, **kwargs }
+        scored: List[ScoredProgram] = []
+        for generation in range(total_generations):
+            ga.hook_next_gen(generation)
+            scored = self._evaluate(population, **additional_vars)
+            scores = [s.score for s in scored]
+            ga.hook_log_scores(generation, scores)
+            ga.hook_log_population(generation, population)
+            ga.hook_log_results(generation, scored, None)
+            if generation + 1 >= total_generations or len(self.archive) == 0:
+                break
+            ga.hook_selection(ga.score_stats)
+            ga.hook_reproduction()
+            population = self._breed()
+        ga.hook_finished()
+        return scored
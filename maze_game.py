@@ -38,6 +38,7 @@ class Maze:
         Returns True if the move was valid (into an open space), False otherwise.
         """
         self.total_steps += 1
+        self.move_counts[direction] += 1
         move_map = {'w': (-1, 0), 'a': (0, -1), 's': (1, 0), 'd': (0, 1)}
         dy, dx = move_map[direction]
         ny, nx = self.player_y + dy, self.player_x + dx
@@ -54,8 +55,13 @@ class Maze:
         self.player_y, self.player_x = self.start_position
         self.total_steps = 0
         self.valid_moves = 0
+        self.move_counts = {'w': 0, 'a': 0, 's': 0, 'd': 0}
         self.visited_cells = {(self.player_y, self.player_x)}
 
+    def fresh_copy(self) -> "Maze":
+        """A reset copy that shares this maze's (read-only) grid."""
+        return Maze(from_data=self.to_dict())
+
     def is_finished(self) -> bool:
         """Returns True if the player is at the finish coordinates."""
         return (self.player_y, self.player_x) == (self.finish_y, self.finish_x)
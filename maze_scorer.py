@@ -1,16 +1,19 @@
 from __future__ import annotations
 from typing import TYPE_CHECKING
 
+from misc import CONSTANTS
 from scorer import ScoredProgram
 
 if TYPE_CHECKING:
     from maze_game import Maze
     from misc import VMResult
 
-REWARD_FINISH = 10000
-REWARD_UNIQUE_CELL = 50
-REWARD_VALID_MOVE = 5
-PENALTY_STEP = 1
+# Shared with the native "maze" environment through vm_core.h
+REWARD_FINISH = CONSTANTS['MAZE_REWARD_FINISH']
+REWARD_UNIQUE_CELL = CONSTANTS['MAZE_REWARD_UNIQUE_CELL']
+REWARD_VALID_MOVE = CONSTANTS['MAZE_REWARD_VALID_MOVE']
+PENALTY_STEP = CONSTANTS['MAZE_PENALTY_STEP']
+PENALTY_HALT = CONSTANTS['MAZE_PENALTY_HALT']
 
 def grade_maze_performance(result: VMResult, maze: Maze) -> int:
     """
@@ -29,6 +32,6 @@ def grade_maze_performance(result: VMResult, maze: Maze) -> int:
 
     # Penalize errors
     if result.halted :
-        score -= 100
+        score -= PENALTY_HALT
 
     return score
\ No newline at end of file
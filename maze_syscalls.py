@@ -1,13 +1,20 @@
 from __future__ import annotations
 import ctypes
-from typing import TYPE_CHECKING
+from typing import TYPE_CHECKING, Optional
 from syscalls import Syscall
 
 if TYPE_CHECKING:
     from misc import VMState
     from maze_game import Maze
 
-class MoveUpSyscall(Syscall):
+class MazeSyscall(Syscall):
+    """A syscall acting on the maze it was built or last bound with."""
+    maze: Maze
+    def bind(self, *, maze: Optional[Maze] = None, **_kwargs) -> None:
+        if maze is not None:
+            self.maze = maze
+
+class MoveUpSyscall(MazeSyscall):
     SYSCALL_ID = 0x10
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
@@ -15,7 +22,7 @@ class MoveUpSyscall(Syscall):
         self.maze.move('w')
         return rt
 
-class MoveDownSyscall(Syscall):
+class MoveDownSyscall(MazeSyscall):
     SYSCALL_ID = 0x11
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
@@ -23,7 +30,7 @@ class MoveDownSyscall(Syscall):
         self.maze.move('s')
         return rt
 
-class MoveLeftSyscall(Syscall):
+class MoveLeftSyscall(MazeSyscall):
     SYSCALL_ID = 0x12
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
@@ -31,7 +38,7 @@ class MoveLeftSyscall(Syscall):
         self.maze.move('a')
         return rt
 
-class MoveRightSyscall(Syscall):
+class MoveRightSyscall(MazeSyscall):
     SYSCALL_ID = 0x13
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
@@ -39,7 +46,7 @@ class MoveRightSyscall(Syscall):
         self.maze.move('d')
         return rt
 
-class GetFinishPos(Syscall):
+class GetFinishPos(MazeSyscall):
     SYSCALL_ID = 0x14
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
@@ -48,7 +55,7 @@ class GetFinishPos(Syscall):
         rt.registers[1] = ctypes.c_uint8(self.maze.finish_x)
         return rt
 
-class GetPlayerPos(Syscall):
+class GetPlayerPos(MazeSyscall):
     SYSCALL_ID = 0x15
     def __init__(self, maze: Maze, **_kwargs):
         self.maze = maze
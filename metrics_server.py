@@ -0,0 +1,192 @@
+"""
+metrics_server.py
+
+Optional localhost HTTP endpoint serving the state of a running GA in the
+Prometheus text format (GET /metrics), for runs too long to watch bar.py.
+
+The GA thread publishes once per generation: scores and termination reasons
+through `publish_generation`, and throughput through the telemetry sink
+interface (`write`). Each publish builds a new immutable snapshot and swaps
+the reference, so the HTTP thread only ever reads a finished snapshot, and
+neither side waits on a lock. Evaluator threads never touch it at all.
+"""
+from __future__ import annotations
+
+import os
+import resource
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from types import MappingProxyType
+from typing import TYPE_CHECKING, Any, Dict, List, Mapping
+
+from misc import CONSTANTS
+from runlog import OUTCOME_UNKNOWN_SYSCALL_BASE, outcome_code
+from telemetry import PHASES, GenerationTelemetry, Sink
+
+if TYPE_CHECKING:
+    from score_stats import ScoreStats
+    from scorer import ScoredProgram
+
+CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8"
+QUANTILES = (0.1, 0.25, 0.5, 0.75, 0.9, 0.99)
+
+# Interrupt code -> label, e.g. -2 -> "max_steps"
+_INTERRUPT_LABELS = {code: name[len("INTERRUPT_"):].lower()
+                     for name, code in CONSTANTS.items() if name.startswith("INTERRUPT_")}
+
+
+def termination_reason(outcome: int) -> str:
+    """Label for a runlog outcome code."""
+    if outcome >= 0:
+        return "exit"
+    if outcome <= OUTCOME_UNKNOWN_SYSCALL_BASE:
+        return "unknown_syscall"
+    return _INTERRUPT_LABELS.get(outcome, "unknown")
+
+
+def _resident_bytes() -> int:
+    try:
+        with open("/proc/self/statm", "r", encoding="ascii") as f:
+            return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+    except (OSError, ValueError, IndexError):
+        return 0
+
+
+def _format(value: float) -> str:
+    if value != value:  # NaN
+        return "NaN"
+    return repr(float(value)) if isinstance(value, float) else str(value)
+
+
+class MetricsServer(Sink):
+    """Serves the latest published snapshot at http://host:port/metrics."""
+
+    def __init__(self, port: int, host: str = "127.0.0.1"):
+        self._snapshot: Mapping[str, Any] = MappingProxyType({"start_time": time.time()})
+        self._interrupts_total: Dict[str, int] = {}
+        self._evaluations_total = 0
+        server = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self) -> None:
+                if self.path.split("?", 1)[0] != "/metrics":
+                    self.send_error(404)
+                    return
+                body = server.render().encode("utf-8")
+                self.send_response(200)
+                self.send_header("Content-Type", CONTENT_TYPE)
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, *_: Any) -> None:
+                pass
+
+        self._httpd = ThreadingHTTPServer((host, port), Handler)
+        self._httpd.daemon_threads = True
+        self._thread = threading.Thread(target=self._httpd.serve_forever, name="metrics-server", daemon=True)
+        self._thread.start()
+
+    @property
+    def port(self) -> int:
+        return self._httpd.server_address[1]
+
+    def _publish(self, **values: Any) -> None:
+        snapshot = dict(self._snapshot)
+        snapshot.update(values)
+        self._snapshot = MappingProxyType(snapshot)  # Reference swap, atomic for readers
+
+    def publish_generation(self, generation: int, scored_population: List[ScoredProgram],
+                           stats: ScoreStats) -> None:
+        """Publishes the scores and termination reasons of a tested generation."""
+        interrupts: Dict[str, int] = {}
+        for sp in scored_population:
+            reason = termination_reason(outcome_code(sp.result))
+            interrupts[reason] = interrupts.get(reason, 0) + 1
+        for reason, count in interrupts.items():
+            self._interrupts_total[reason] = self._interrupts_total.get(reason, 0) + count
+        self._evaluations_total += len(scored_population)
+        count = len(scored_population)
+        self._publish(
+            generation=generation,
+            population=count,
+            best=stats.max if len(stats) else float("nan"),
+            mean=stats.mean if len(stats) else float("nan"),
+            stddev=stats.stddev if len(stats) else float("nan"),
+            quantiles=tuple(zip(QUANTILES, stats.quantiles(QUANTILES))) if len(stats) else (),
+            score_sum=stats.sum,
+            score_count=len(stats),
+            step_limit_ratio=interrupts.get("max_steps", 0) / count if count else 0.0,
+            interrupts=MappingProxyType(interrupts),
+            interrupts_total=MappingProxyType(dict(self._interrupts_total)),
+            evaluations_total=self._evaluations_total,
+        )
+
+    def write(self, record: GenerationTelemetry) -> None:
+        """Telemetry sink: publishes throughput and phase timings."""
+        self._publish(
+            evaluations_per_second=record.evaluations_per_second,
+            worker_utilization=record.worker_utilization,
+            phase_seconds=MappingProxyType(dict(record.wall)),
+            hardware=MappingProxyType(dict(record.hardware)) if record.hardware else None,
+            ipc=record.ipc,
+            branch_miss_rate=record.branch_miss_rate,
+        )
+
+    def render(self) -> str:
+        """The current snapshot in the Prometheus text exposition format."""
+        s = self._snapshot
+        lines: List[str] = []
+
+        def metric(name: str, kind: str, help_text: str, samples) -> None:
+            lines.append(f"# HELP {name} {help_text}")
+            lines.append(f"# TYPE {name} {kind}")
+            for labels, value in samples:
+                lines.append(f"{name}{labels} {_format(value)}")
+
+        metric("ga_start_time_seconds", "gauge", "Unix time the run started.", [("", s["start_time"])])
+        if "generation" in s:
+            metric("ga_generation", "gauge", "Last tested generation.", [("", s["generation"])])
+            metric("ga_population_size", "gauge", "Individuals in the last tested generation.", [("", s["population"])])
+            metric("ga_score_best", "gauge", "Best score of the last tested generation.", [("", s["best"])])
+            metric("ga_score_mean", "gauge", "Mean score of the last tested generation.", [("", s["mean"])])
+            metric("ga_score_stddev", "gauge", "Score standard deviation of the last tested generation.",
+                   [("", s["stddev"])])
+            lines.append("# HELP ga_score Score distribution of the last tested generation.")
+            lines.append("# TYPE ga_score summary")
+            for q, value in s["quantiles"]:
+                lines.append(f'ga_score{{quantile="{q}"}} {_format(value)}')
+            lines.append(f"ga_score_sum {_format(s['score_sum'])}")
+            lines.append(f"ga_score_count {s['score_count']}")
+            metric("ga_step_limit_ratio", "gauge", "Fraction of the last generation stopped by the step limit.",
+                   [("", s["step_limit_ratio"])])
+            metric("ga_terminations", "gauge", "How the last generation's programs ended.",
+                   [(f'{{reason="{r}"}}', n) for r, n in sorted(s["interrupts"].items())])
+            metric("ga_terminations_total", "counter", "How all evaluated programs ended.",
+                   [(f'{{reason="{r}"}}', n) for r, n in sorted(s["interrupts_total"].items())])
+            metric("ga_evaluations_total", "counter", "Programs evaluated so far.", [("", s["evaluations_total"])])
+        if "evaluations_per_second" in s:
+            metric("ga_evaluations_per_second", "gauge", "Programs evaluated per second in the last test phase.",
+                   [("", s["evaluations_per_second"])])
+            if s["worker_utilization"] is not None:
+                metric("ga_worker_utilization_ratio", "gauge", "Worker CPU use during the last test phase.",
+                       [("", s["worker_utilization"])])
+            metric("ga_phase_seconds", "gauge", "Wall time of each phase in the last generation.",
+                   [(f'{{phase="{p}"}}', s["phase_seconds"][p]) for p in PHASES if p in s["phase_seconds"]])
+        if s.get("hardware"):
+            metric("ga_test_hardware_events", "gauge", "Hardware events counted during the last test phase.",
+                   [(f'{{event="{e}"}}', n) for e, n in s["hardware"].items() if n is not None])
+            if s["ipc"] is not None:
+                metric("ga_test_ipc", "gauge", "Instructions per cycle during the last test phase.", [("", s["ipc"])])
+            if s["branch_miss_rate"] is not None:
+                metric("ga_test_branch_miss_ratio", "gauge", "Branch-miss rate during the last test phase.",
+                       [("", s["branch_miss_rate"])])
+        metric("process_resident_memory_bytes", "gauge", "Resident memory size in bytes.", [("", _resident_bytes())])
+        metric("process_max_resident_memory_bytes", "gauge", "Peak resident memory size in bytes.",
+               [("", resource.getrusage(resource.RUSAGE_SELF).ru_maxrss * 1024)])
+        return "\n".join(lines) + "\n"
+
+    def close(self) -> None:
+        self._httpd.shutdown()
+        self._httpd.server_close()
@@ -6,9 +6,11 @@ import os
 import sys
 
 from string import printable
+import time
 
 from dataclasses import dataclass
 from typing import (
+    TYPE_CHECKING,
     Generator,
     List,
     Dict,
@@ -16,8 +18,12 @@ from typing import (
     Literal,
     Optional,
     Tuple,
+    Union,
 )
 
+if TYPE_CHECKING:
+    from syscall_profile import SyscallProfile
+
 DBG = False
 Endian = Literal["big", "little"]
 
@@ -158,7 +164,23 @@ vm_core.disassemble.restype = ctypes.c_int
 vm_core.free_memory.argtypes = [ctypes.c_void_p]
 vm_core.free_memory.restype = None
 
-Systable = Dict[int, Callable[[VMState], Optional[VMState]]]
+SYSTABLE_SIZE = 256  # Syscall IDs are 8 bits
+SyscallHandler = Callable[[VMState], Optional[VMState]]
+# Handlers by syscall ID, as a dict or a SYSTABLE_SIZE list with None for unknown IDs
+Systable = Union[Dict[int, SyscallHandler], List[Optional[SyscallHandler]]]
+
+def systable_slots(systable: Systable) -> List[Optional[SyscallHandler]]:
+    """The systable as a SYSTABLE_SIZE list indexed by syscall ID."""
+    if isinstance(systable, dict):
+        slots: List[Optional[SyscallHandler]] = [None] * SYSTABLE_SIZE
+        for syscall_id, handler in systable.items():
+            if not 0 <= syscall_id < SYSTABLE_SIZE:
+                raise ValueError(f"Syscall ID out of range: {syscall_id}")
+            slots[syscall_id] = handler
+        return slots
+    if len(systable) != SYSTABLE_SIZE:
+        raise ValueError(f"A systable list needs exactly {SYSTABLE_SIZE} slots, not {len(systable)}")
+    return systable
 
 # =========================
 # VM result container
@@ -171,6 +193,129 @@ class VMResult:
     exit_code: Optional[int]    # Exit code if EXIT was used; otherwise Non
     steps: int                  # Number of steps taken
     rt: VMState                 # The runtime at program termination
+    syscalls: int = 0           # Number of syscalls dispatched
+    output: Optional[bytes] = None  # PUTC output, when run with a VMContext
+    output_match: Optional[VMOutputMatch] = None  # Output vs. the VMContext's target, when it has one
+
+# Messages of the halting (negative) interrupts
+INTERRUPT_MESSAGES = {
+    CONSTANTS.get('INTERRUPT_MAX_STEPS'): "Runtime limit exceeded",
+    CONSTANTS.get('INTERRUPT_ILLEGAL_PC'): "Illegal PC access",
+    CONSTANTS.get('INTERRUPT_PROTECTED_REG'): "Protected register write attempt",
+    CONSTANTS.get('INTERRUPT_UNKNOWN_OPCODE'): "Unknown opcode",
+    CONSTANTS.get('INTERRUPT_MEMORY_ACCESS'): "Illegal memory access",
+    CONSTANTS.get('INTERRUPT_OUTPUT_FULL'): "Output buffer full",
+    CONSTANTS.get('INTERRUPT_OUTPUT_DIVERGED'): "Output diverged from target",
+}
+
+def interrupt_message(interrupt: int) -> str:
+    return INTERRUPT_MESSAGES.get(interrupt, f"Unknown error from C core: {interrupt}")
+
+# =========================
+# VM context (native output buffer)
+# =========================
+class VMOutputMatch(ctypes.Structure):
+    """How PUTC output compared with a target, position by position."""
+    _fields_ = [
+        ("matched", ctypes.c_uint32),     # Bytes equal to the target byte at their position
+        ("prefix", ctypes.c_uint32),      # Length of the correct prefix
+        ("mismatches", ctypes.c_uint32),  # Wrong bytes, including any past the end of the target
+    ]
+
+vm_core.vm_context_new.argtypes = [ctypes.c_uint32, ctypes.c_int]
+vm_core.vm_context_new.restype = ctypes.c_void_p
+
+vm_core.vm_context_free.argtypes = [ctypes.c_void_p]
+vm_core.vm_context_free.restype = None
+
+vm_core.vm_context_reset.argtypes = [ctypes.c_void_p]
+vm_core.vm_context_reset.restype = None
+
+vm_core.vm_context_output_total.argtypes = [ctypes.c_void_p]
+vm_core.vm_context_output_total.restype = ctypes.c_uint64
+
+vm_core.vm_context_output.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+vm_core.vm_context_output.restype = ctypes.c_int
+
+vm_core.vm_context_flush.argtypes = [ctypes.c_void_p, ctypes.c_int]
+vm_core.vm_context_flush.restype = ctypes.c_int
+
+vm_core.vm_context_set_target.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32]
+vm_core.vm_context_set_target.restype = ctypes.c_int
+
+vm_core.vm_context_match.argtypes = [ctypes.c_void_p, ctypes.POINTER(VMOutputMatch)]
+vm_core.vm_context_match.restype = ctypes.c_int
+
+vm_core.run_ctx.argtypes = [ctypes.c_void_p, ctypes.POINTER(VMState), ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+vm_core.run_ctx.restype = None
+
+OVERFLOW_POLICIES = {
+    "truncate": CONSTANTS['OUTPUT_OVERFLOW_TRUNCATE'],  # Keep the first `capacity` bytes
+    "ring": CONSTANTS['OUTPUT_OVERFLOW_RING'],          # Keep the last `capacity` bytes
+    "stop": CONSTANTS['OUTPUT_OVERFLOW_STOP'],          # Halt the program ("Output buffer full")
+}
+
+class VMContext:
+    """
+    Native state kept next to a MiscVM across runs: a fixed-capacity output
+    buffer that PUTC writes to in C, without a trip into Python per character.
+    With `echo` the buffer is written to stdout in one go when a run ends.
+    """
+    def __init__(self, capacity: int = 4096, overflow: str = "truncate", echo: bool = False):
+        if overflow not in OVERFLOW_POLICIES:
+            raise ValueError(f"Unknown overflow policy: {overflow}")
+        self.capacity = capacity
+        self.echo = echo
+        self._handle = vm_core.vm_context_new(capacity, OVERFLOW_POLICIES[overflow])
+        if not self._handle:
+            raise MemoryError("Could not allocate VM context")
+        self._buffer = (ctypes.c_uint8 * max(capacity, 1))()
+        self.target: Optional[bytes] = None
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.vm_context_free(self._handle)
+            self._handle = None
+
+    def reset(self) -> None:
+        vm_core.vm_context_reset(self._handle)
+
+    @property
+    def total(self) -> int:
+        """Characters the program wrote since the last reset, buffered or not."""
+        return vm_core.vm_context_output_total(self._handle)
+
+    def output(self) -> bytes:
+        """The buffered output, oldest first."""
+        length = vm_core.vm_context_output(self._handle, self._buffer, self.capacity)
+        return bytes(self._buffer[:length])
+
+    def set_target(self, target: Optional[bytes], max_mismatches: int = 0) -> None:
+        """
+        Matches PUTC output against `target` as it streams; a run stops with
+        "Output diverged from target" after more than `max_mismatches` wrong bytes.
+        None turns matching off.
+        """
+        if vm_core.vm_context_set_target(self._handle, target or None, len(target or b""), max_mismatches) != 0:
+            raise MemoryError("Could not set the output target")
+        self.target = target or None
+
+    def match(self) -> Optional[VMOutputMatch]:
+        """Match counts of the output since the last reset, None without a target."""
+        out = VMOutputMatch()
+        if vm_core.vm_context_match(self._handle, ctypes.byref(out)) != 0:
+            return None
+        return out
+
+    def flush(self, fd: Optional[int] = None) -> int:
+        """Writes the buffered output to `fd` (stdout by default) and empties the buffer."""
+        if fd is None:
+            sys.stdout.flush()  # Keep Python's own buffered output in order
+            fd = sys.stdout.fileno()
+        written = vm_core.vm_context_flush(self._handle, fd)
+        if written < 0:
+            raise OSError("Could not flush VM output")
+        return written
 
 # =========================
 # MISC v3 VM (Register-based)
@@ -191,8 +336,17 @@ class MiscVM:
             super().__init__(error)
             self.rt = state
 
-    def __init__(self, systable: Systable):
-        self.systable = systable
+    def __init__(self, systable: Systable, profile: Optional[SyscallProfile] = None,
+                 context: Optional[VMContext] = None):
+        self.systable = systable_slots(systable)  # Shares the list when given one, e.g. SyscallTable.slots
+        self.profile = profile  # Syscall latency histograms, see syscall_profile.py
+        self.context = context  # Native PUTC output buffer; PUTC then bypasses the systable
+
+    def dump_profile(self, file=sys.stdout) -> None:
+        """Prints the syscall latency profile (see syscall_profile.SyscallProfile.dump)."""
+        if self.profile is None:
+            raise ValueError("This VM was created without a syscall profile")
+        self.profile.dump(file)
 
     def run(
         self,
@@ -208,33 +362,61 @@ class MiscVM:
         state.pc = 0
         state.steps = 0
         state.interrupt = CONSTANTS.get('INTERRUPT_NONE', -1)
+        systable = self.systable
+        profile = self.profile
+        context = self.context
+        if profile is not None:
+            profile.activate()
+        if context is not None:
+            context.reset()
 
+        try:
+            result = self._run(state, program, max_steps, systable, profile, context)
+        finally:
+            if profile is not None:
+                profile.deactivate()
+        if context is not None:
+            result.syscalls += context.total
+            result.output = context.output()
+            if context.target is not None:
+                result.output_match = context.match()
+            if context.echo:
+                context.flush()
+        return result
+
+    def _run(self, state: VMState, program: bytes, max_steps: int, systable: List[Optional[SyscallHandler]],
+             profile: Optional[SyscallProfile], context: Optional[VMContext]) -> VMResult:
+        syscalls = 0
         try:
             while True:
-                vm_core.run_c(ctypes.byref(state), program, len(program), max_steps, False)
+                if context is None:
+                    vm_core.run_c(ctypes.byref(state), program, len(program), max_steps, False)
+                else:
+                    vm_core.run_ctx(context._handle, ctypes.byref(state), program, len(program), max_steps)
 
                 if state.interrupt >= 0: # Positive interrupt is a syscall
                     syscall_id = state.interrupt
+                    syscalls += 1
+                    syscall_handler = systable[syscall_id]
+                    if syscall_handler is None:
+                        raise self.Error(f"Unknown syscall: {syscall_id}", state)
                     try:
-                        syscall_handler = self.systable[syscall_id]
-                        syscall_handler(state) # Pass the C state object
-                    except KeyError as exc:
-                        raise self.Error(f"Unknown syscall: {syscall_id}", state) from exc
+                        if profile is None:
+                            syscall_handler(state) # Pass the C state object
+                        else:
+                            start = time.perf_counter_ns()
+                            try:
+                                syscall_handler(state)
+                            finally:
+                                profile.record_handler(syscall_id, time.perf_counter_ns() - start)
                     except self.Stop as e: # Exit syscall raises this
-                        return VMResult(False, None, e.code, state.steps, state)
+                        return VMResult(False, None, e.code, state.steps, state, syscalls)
                 elif state.interrupt < -1: # Negative interrupt is an error/halt
-                    error_map = {
-                        CONSTANTS.get('INTERRUPT_MAX_STEPS'): "Runtime limit exceeded",
-                        CONSTANTS.get('INTERRUPT_ILLEGAL_PC'): "Illegal PC access",
-                        CONSTANTS.get('INTERRUPT_PROTECTED_REG'): "Protected register write attempt",
-                        CONSTANTS.get('INTERRUPT_UNKNOWN_OPCODE'): "Unknown opcode",
-                        CONSTANTS.get('INTERRUPT_MEMORY_ACCESS'): "Illegal memory access",
-                    }
-                    error_msg = error_map.get(state.interrupt, f"Unknown error from C core: {state.interrupt}")
+                    error_msg = interrupt_message(state.interrupt)
                     raise self.Error(error_msg, state)
 
         except self.Error as e:
-            return VMResult(True, e, None, state.steps, state)
+            return VMResult(True, e, None, state.steps, state, syscalls)
 
 
     def run_debug(
@@ -261,24 +443,17 @@ class MiscVM:
                     yield state, instr, None
                     continue
                 syscall_id = state.interrupt
-                try:
-                    syscall_handler = self.systable[syscall_id]
-                    syscall_handler(state) # Pass the C state object
-                except KeyError:
+                syscall_handler = self.systable[syscall_id]
+                if syscall_handler is None:
                     yield state, instr, f"Unknown syscall: {syscall_id}"
                     break
+                try:
+                    syscall_handler(state) # Pass the C state object
                 except self.Stop as e: # Exit syscall raises this
                     yield state, instr, f"Graceful shutdown: {e.code}"
                     break
             elif state.interrupt < -1: # Negative interrupt is an error/halt
-                error_map = {
-                    CONSTANTS.get('INTERRUPT_MAX_STEPS'): "Runtime limit exceeded",
-                    CONSTANTS.get('INTERRUPT_ILLEGAL_PC'): "Illegal PC access",
-                    CONSTANTS.get('INTERRUPT_PROTECTED_REG'): "Protected register write attempt",
-                    CONSTANTS.get('INTERRUPT_UNKNOWN_OPCODE'): "Unknown opcode",
-                    CONSTANTS.get('INTERRUPT_MEMORY_ACCESS'): "Illegal memory access",
-                }
-                error_msg = error_map.get(state.interrupt, "Unknown error from C core")
+                error_msg = interrupt_message(state.interrupt)
                 yield state, instr, error_msg
                 break
        
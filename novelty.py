@@ -0,0 +1,141 @@
+"""
+novelty.py
+
+Novelty search for the genetic algorithm.
+
+Maze fitness is deceptive: the shortest-looking path to the exit is often a
+dead end. Novelty search instead rewards programs for behaving differently
+from everything seen so far, measured as the mean distance of a behaviour
+descriptor (see behaviour.py) to its k nearest neighbours among a bounded
+archive of past behaviours and the current population. The k-NN queries run
+natively against a vantage-point tree.
+"""
+from __future__ import annotations
+
+import ctypes
+from typing import Any, Callable, List, Optional
+
+import numpy as np
+
+from behaviour import DESCRIPTOR_DIM, maze_descriptor
+from misc import vm_core
+from scorer import ScoredProgram
+
+_fp = ctypes.POINTER(ctypes.c_float)
+
+vm_core.novelty_archive_new.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_uint64]
+vm_core.novelty_archive_new.restype = ctypes.c_void_p
+
+vm_core.novelty_archive_free.argtypes = [ctypes.c_void_p]
+vm_core.novelty_archive_free.restype = None
+
+vm_core.novelty_archive_size.argtypes = [ctypes.c_void_p]
+vm_core.novelty_archive_size.restype = ctypes.c_int
+
+vm_core.novelty_archive_add.argtypes = [ctypes.c_void_p, _fp, ctypes.c_int]
+vm_core.novelty_archive_add.restype = ctypes.c_int
+
+vm_core.novelty_archive_get.argtypes = [ctypes.c_void_p, _fp]
+vm_core.novelty_archive_get.restype = ctypes.c_int
+
+vm_core.novelty_scores.argtypes = [ctypes.c_void_p, _fp, ctypes.c_int, ctypes.c_int, _fp]
+vm_core.novelty_scores.restype = ctypes.c_int
+
+
+class NoveltyArchive:
+    """A bounded archive of behaviour descriptors held by vm_core."""
+
+    def __init__(self, dim: int = DESCRIPTOR_DIM, capacity: int = 10_000, seed: int = 0):
+        self.dim = dim
+        self.capacity = capacity
+        self._handle = vm_core.novelty_archive_new(dim, capacity, seed)
+        if not self._handle:
+            raise MemoryError("Could not allocate novelty archive")
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.novelty_archive_free(self._handle)
+            self._handle = None
+
+    def __len__(self) -> int:
+        return vm_core.novelty_archive_size(self._handle)
+
+    def _rows(self, descriptors: Any) -> np.ndarray:
+        return np.ascontiguousarray(descriptors, dtype=np.float32).reshape(-1, self.dim)
+
+    def add(self, descriptors: Any) -> None:
+        """Adds descriptors, replacing random entries once the archive is full."""
+        rows = self._rows(descriptors)
+        if vm_core.novelty_archive_add(self._handle, rows.ctypes.data_as(_fp), len(rows)) < 0:
+            raise RuntimeError("novelty_archive_add failed in C core.")
+
+    def descriptors(self) -> np.ndarray:
+        out = np.zeros((len(self), self.dim), dtype=np.float32)
+        vm_core.novelty_archive_get(self._handle, out.ctypes.data_as(_fp))
+        return out
+
+    def scores(self, descriptors: Any, k: int = 15) -> np.ndarray:
+        """Novelty of each descriptor against the archive and the other descriptors."""
+        rows = self._rows(descriptors)
+        out = np.zeros(len(rows), dtype=np.float32)
+        if vm_core.novelty_scores(self._handle, rows.ctypes.data_as(_fp), len(rows), k,
+                                  out.ctypes.data_as(_fp)) != 0:
+            raise RuntimeError("novelty_scores failed in C core.")
+        return out
+
+
+class NoveltySearch:
+    """
+    Wraps a ``test_func`` so that ``GeneticAlgo`` selects on novelty.
+
+    The wrapped function is called with ``describe=<descriptor function>`` and
+    must fill in ``ScoredProgram.descriptor`` with it. Each generation the ``archive_rate`` most
+    novel individuals are added to the archive. The returned score is
+    ``novelty_scale * novelty + fitness_weight * fitness``; the raw fitness of
+    the last generation is kept in ``last_fitness``.
+    """
+
+    def __init__(
+                self,
+                test_func: Callable[..., List[ScoredProgram]],
+                k: int = 15,
+                archive: Optional[NoveltyArchive] = None,
+                archive_rate: float = 0.02,
+                novelty_scale: float = 1000.0,
+                fitness_weight: float = 0.0,
+                describe: Callable[..., Any] = maze_descriptor,
+            ) :
+        self.test_func = test_func
+        self.describe = describe
+        self.k = k
+        self.archive = archive or NoveltyArchive()
+        self.archive_rate = archive_rate
+        self.novelty_scale = novelty_scale
+        self.fitness_weight = fitness_weight
+        self.last_fitness: List[int] = []
+
+    def restore(self, descriptors: Any) -> None:
+        """Refills an empty archive from NoveltyArchive.descriptors(), e.g. from a checkpoint."""
+        if len(self.archive):
+            raise ValueError("Can only restore into an empty novelty archive")
+        if len(descriptors):
+            self.archive.add(descriptors)
+
+    def __call__(self, current_population: List[bytes], **kwargs: Any) -> List[ScoredProgram]:
+        # Selection sees novelty, not the raw fitness the inner test would record
+        kwargs.pop("score_stats", None)
+        scored = self.test_func(current_population, describe=self.describe, **kwargs)
+        if any(sp.descriptor is None for sp in scored):
+            raise ValueError("Novelty search needs a test function that fills in behaviour descriptors")
+
+        descriptors = np.array([sp.descriptor for sp in scored], dtype=np.float32)
+        novelty = self.archive.scores(descriptors, self.k)
+
+        to_archive = max(1, int(len(scored) * self.archive_rate)) if scored else 0
+        if to_archive:
+            self.archive.add(descriptors[np.argsort(novelty)[-to_archive:]])
+
+        self.last_fitness = [sp.score for sp in scored]
+        for sp, n in zip(scored, novelty):
+            sp.score = int(self.novelty_scale * float(n) + self.fitness_weight * sp.score)
+        return scored
@@ -0,0 +1,114 @@
+"""
+nsga.py
+
+NSGA-II style multi-objective selection for the genetic algorithm.
+
+Instead of folding everything into grade_maze_performance, individuals are
+compared on several objectives at once (by default: maze score, program
+length and steps used). Parents are chosen by binary tournament on
+(Pareto front, crowding distance) from the best half of the current and
+previous generations combined. The non-dominated sort and crowding distance
+run natively.
+"""
+from __future__ import annotations
+
+import ctypes
+import random
+from dataclasses import replace
+from typing import Any, Callable, List, Sequence, Tuple
+
+import numpy as np
+
+from genetics import GeneticAlgo
+from misc import VMResult, VMState, vm_core
+from scorer import ScoredProgram
+
+_dp = ctypes.POINTER(ctypes.c_double)
+_i32p = ctypes.POINTER(ctypes.c_int32)
+
+vm_core.nondominated_sort.argtypes = [_dp, ctypes.c_int, ctypes.c_int, _i32p]
+vm_core.nondominated_sort.restype = ctypes.c_int
+
+vm_core.crowding_distance.argtypes = [_dp, _i32p, ctypes.c_int, ctypes.c_int, _dp]
+vm_core.crowding_distance.restype = ctypes.c_int
+
+# An objective maps a scored program to a value to *minimize*
+Objective = Callable[[ScoredProgram], float]
+
+DEFAULT_OBJECTIVES: Tuple[Objective, ...] = (
+    lambda sp: -sp.score,              # maze score, maximized
+    lambda sp: len(sp.program_bytes),  # program length
+    lambda sp: sp.result.steps,        # steps used
+)
+
+
+def _objective_matrix(objectives: Any) -> np.ndarray:
+    return np.ascontiguousarray(objectives, dtype=np.float64)
+
+
+def non_dominated_sort(objectives: Any) -> np.ndarray:
+    """Front index (0 = Pareto front) of each row of an (N, 2 or 3) minimization matrix."""
+    objs = _objective_matrix(objectives)
+    ranks = np.zeros(len(objs), dtype=np.int32)
+    if vm_core.nondominated_sort(objs.ctypes.data_as(_dp), len(objs), objs.shape[1],
+                                 ranks.ctypes.data_as(_i32p)) < 0:
+        raise ValueError("nondominated_sort supports 2 or 3 objectives")
+    return ranks
+
+
+def crowding_distance(objectives: Any, ranks: np.ndarray) -> np.ndarray:
+    """NSGA-II crowding distance of each row within its front."""
+    objs = _objective_matrix(objectives)
+    ranks = np.ascontiguousarray(ranks, dtype=np.int32)
+    out = np.zeros(len(objs), dtype=np.float64)
+    if vm_core.crowding_distance(objs.ctypes.data_as(_dp), ranks.ctypes.data_as(_i32p), len(objs),
+                                 objs.shape[1], out.ctypes.data_as(_dp)) != 0:
+        raise RuntimeError("crowding_distance failed in C core.")
+    return out
+
+
+class NSGA2GeneticAlgo(GeneticAlgo) :
+    """GeneticAlgo whose selection step is NSGA-II's elitist, crowded tournament."""
+
+    def __init__(self, *args, objectives: Sequence[Objective] = DEFAULT_OBJECTIVES, **kwargs) :
+        super().__init__(*args, **kwargs)
+        if not 2 <= len(objectives) <= 3:
+            raise ValueError("NSGA-II selection supports 2 or 3 objectives")
+        self.objectives = tuple(objectives)
+        self._previous: List[ScoredProgram] = []
+
+    def _select(self, scored_population: List[ScoredProgram]) -> list[tuple[ScoredProgram, ScoredProgram]] :
+        """Select which individuals to allow to reproduce and pair them off"""
+        size = len(scored_population)
+        # Parents and children compete for the same slots (mu + lambda)
+        pool = scored_population + self._previous
+        objs = np.array([[f(sp) for f in self.objectives] for sp in pool], dtype=np.float64)
+        ranks = non_dominated_sort(objs)
+        crowding = crowding_distance(objs, ranks)
+
+        # Best fronts first, most isolated first within a front
+        survivors = np.lexsort((-crowding, ranks))[:size]
+        self._previous = [pool[i] for i in survivors]
+
+        def tournament() -> ScoredProgram:
+            a, b = random.choice(survivors), random.choice(survivors)
+            if ranks[a] != ranks[b]:
+                winner = a if ranks[a] < ranks[b] else b
+            else:
+                winner = a if crowding[a] >= crowding[b] else b
+            # Survivors from older generations have no index in this one
+            return pool[winner] if winner < size else replace(pool[winner], index=-1)
+
+        return [ (tournament(), tournament()) for _ in range(size // 2) ]
+
+    def front_state(self) -> List[Tuple[bytes, int, int]]:
+        """The survivors carried into the next selection as (program, score, steps), for checkpoints."""
+        return [(sp.program_bytes, sp.score, sp.result.steps) for sp in self._previous]
+
+    def restore_front(self, entries: Sequence[Tuple[bytes, int, int]]) -> None:
+        """
+        Restores survivors saved with front_state. Only the score, program and
+        steps come back, which is all the default objectives read.
+        """
+        self._previous = [ScoredProgram(score, program, VMResult(False, None, None, steps, VMState()))
+                          for program, score, steps in entries]
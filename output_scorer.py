@@ -0,0 +1,44 @@
+from __future__ import annotations
+from typing import TYPE_CHECKING
+
+from misc import CONSTANTS
+
+if TYPE_CHECKING:
+    from misc import VMResult
+
+DEFAULT_TARGET = b"hello world\n"  # What hello.asm prints
+
+# Shared with the native "putc" environment through vm_core.h
+REWARD_COMPLETE = CONSTANTS['PUTC_REWARD_COMPLETE']
+REWARD_PREFIX_CHAR = CONSTANTS['PUTC_REWARD_PREFIX_CHAR']
+REWARD_MATCHED_CHAR = CONSTANTS['PUTC_REWARD_MATCHED_CHAR']
+PENALTY_MISMATCH = CONSTANTS['PUTC_PENALTY_MISMATCH']
+REWARD_EXIT = CONSTANTS['PUTC_REWARD_EXIT']
+PENALTY_HALT = CONSTANTS['PUTC_PENALTY_HALT']
+
+def grade_output_performance(result: VMResult, target: bytes) -> int:
+    """
+    Assigns a performance score based on how closely a program's PUTC output
+    matched `target`. The counts come from the native matcher of the VMContext,
+    which stops a run once its output diverged too far (see VMContext.set_target).
+    """
+    match = result.output_match
+    if match is None:
+        raise ValueError("Run was not matched against a target; set one with VMContext.set_target")
+    score = 0
+
+    # Big reward for printing exactly the target
+    if match.prefix == len(target) and match.mismatches == 0:
+        score += REWARD_COMPLETE
+
+    # A correct prefix is worth most, right characters out of place a little
+    score += match.prefix * REWARD_PREFIX_CHAR
+    score += (match.matched - match.prefix) * REWARD_MATCHED_CHAR
+    score -= match.mismatches * PENALTY_MISMATCH
+
+    if not result.halted:
+        score += REWARD_EXIT
+    else:
+        score -= PENALTY_HALT
+
+    return score
@@ -0,0 +1,117 @@
+"""
+perf_counters.py
+
+Hardware performance counters (Linux perf_event_open) backed by vm_core.
+
+PerfCounters.open() returns None, with the reason in PerfCounters.last_error,
+when the counters are not available: not Linux, no PMU (as in many VMs), or
+kernel.perf_event_paranoid forbids them. Events the CPU lacks are reported as
+None, so a sample is usable even when only some counters exist. A counter that
+stops being readable mid-run (e.g. multiplexed away by another perf user) gives
+an empty sample and one warning instead of ending the run.
+"""
+from __future__ import annotations
+
+import ctypes
+import os
+import sys
+from dataclasses import dataclass
+from typing import Optional
+
+from misc import vm_core
+
+EVENTS = ("cycles", "instructions", "branches", "branch_misses", "cache_misses")
+
+vm_core.perf_counters_open.argtypes = [ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+vm_core.perf_counters_open.restype = ctypes.c_void_p
+
+vm_core.perf_counters_free.argtypes = [ctypes.c_void_p]
+vm_core.perf_counters_free.restype = None
+
+vm_core.perf_counters_available.argtypes = [ctypes.c_void_p]
+vm_core.perf_counters_available.restype = ctypes.c_int
+
+vm_core.perf_counters_start.argtypes = [ctypes.c_void_p]
+vm_core.perf_counters_start.restype = ctypes.c_int
+
+vm_core.perf_counters_stop.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int64)]
+vm_core.perf_counters_stop.restype = ctypes.c_int
+
+
+@dataclass
+class PerfSample:
+    """Event counts of one measurement, None where unavailable."""
+    cycles: Optional[int] = None
+    instructions: Optional[int] = None
+    branches: Optional[int] = None
+    branch_misses: Optional[int] = None
+    cache_misses: Optional[int] = None
+
+    @property
+    def ipc(self) -> Optional[float]:
+        """Instructions per cycle."""
+        if not self.cycles or self.instructions is None:
+            return None
+        return self.instructions / self.cycles
+
+    @property
+    def branch_miss_rate(self) -> Optional[float]:
+        """Fraction of branches mispredicted."""
+        if not self.branches or self.branch_misses is None:
+            return None
+        return self.branch_misses / self.branches
+
+
+class PerfCounters:
+    """User-space counters of this process, plus its later threads and children with `inherit`."""
+
+    last_error: str = ""
+
+    def __init__(self, handle: int):
+        self._handle = handle
+        self._out = (ctypes.c_int64 * len(EVENTS))()
+        self._started = False
+        self._warned = False
+
+    def _warn(self) -> None:
+        if not self._warned:
+            self._warned = True
+            print("Warning: Could not read performance counters, their samples will be empty", file=sys.stderr)
+
+    @classmethod
+    def open(cls, inherit: bool = True) -> Optional[PerfCounters]:
+        error = ctypes.c_int(0)
+        handle = vm_core.perf_counters_open(int(inherit), ctypes.byref(error))
+        if not handle:
+            cls.last_error = os.strerror(error.value) if error.value > 0 else "not supported on this platform"
+            return None
+        return cls(handle)
+
+    @property
+    def available(self) -> tuple:
+        """Names of the events that could be opened."""
+        mask = vm_core.perf_counters_available(self._handle)
+        return tuple(name for i, name in enumerate(EVENTS) if mask & (1 << i))
+
+    def start(self) -> None:
+        self._started = bool(self._handle) and vm_core.perf_counters_start(self._handle) == 0
+        if not self._started:
+            self._warn()
+
+    def stop(self) -> PerfSample:
+        """Counts since start(); an empty sample if either could not read the counters."""
+        started, self._started = self._started, False
+        if not started:
+            return PerfSample()
+        if vm_core.perf_counters_stop(self._handle, self._out) != 0:
+            self._warn()
+            return PerfSample()
+        return PerfSample(*(v if v >= 0 else None for v in self._out))
+
+    def close(self) -> None:
+        if self._handle:
+            vm_core.perf_counters_free(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
@@ -0,0 +1,179 @@
+"""
+profiling.py
+
+One-command profiling of a GA run: cProfile for the Python side plus the
+native vm_core counters (time inside run_c, opcode and syscall counts), merged
+into one report.
+
+cProfile cannot see into ctypes calls, so run_c's time is normally hidden in
+the tottime of its Python caller (MiscVM.run). The report moves that time into
+a synthetic `run_c` entry called from MiscVM.run, with one zero-time child per
+opcode and per syscall ID carrying the execution counts. It is written as:
+  PREFIX.pstats     pstats file (python -m pstats, snakeviz, ...)
+  PREFIX.collapsed  collapsed stacks in microseconds (flamegraph.pl, speedscope)
+  PREFIX.txt        native counter summary
+"""
+from __future__ import annotations
+
+import cProfile
+import ctypes
+import pstats
+import sys
+from typing import Any, Callable, Dict, List, Optional, TextIO, Tuple
+
+from misc import CONSTANTS, vm_core
+
+NATIVE_FILE = "vm_core.c"
+MAX_STACK_DEPTH = 64
+MIN_STACK_SECONDS = 1e-6  # Stacks below a microsecond are dropped from the collapsed file
+
+# (file, line, function) as used by pstats
+FuncKey = Tuple[str, int, str]
+
+OPCODE_NAMES = {code: name[len("OP_"):] for name, code in CONSTANTS.items()
+                if name.startswith("OP_") and 0 <= code < 16}
+
+
+class VMCounters(ctypes.Structure):
+    _fields_ = [
+        ("run_c_calls", ctypes.c_uint64),
+        ("run_c_ns", ctypes.c_uint64),
+        ("instructions", ctypes.c_uint64),
+        ("opcodes", ctypes.c_uint64 * 16),
+        ("syscalls", ctypes.c_uint64 * 256),
+    ]
+
+
+vm_core.vm_counters_activate.argtypes = [ctypes.POINTER(VMCounters)]
+vm_core.vm_counters_activate.restype = None
+
+
+class Profiler:
+    """cProfile plus native counters of the calling thread, for one call."""
+
+    def __init__(self):
+        self.profile = cProfile.Profile()
+        self.counters = VMCounters()
+
+    def run(self, func: Callable[..., Any], *args: Any, **kwargs: Any) -> Any:
+        vm_core.vm_counters_activate(ctypes.byref(self.counters))
+        try:
+            return self.profile.runcall(func, *args, **kwargs)
+        finally:
+            vm_core.vm_counters_activate(None)
+
+    def stats(self) -> pstats.Stats:
+        """pstats with the native entries merged in."""
+        stats = pstats.Stats(self.profile)
+        merge_native(stats.stats, self.counters)
+        return stats
+
+    def write(self, prefix: str) -> List[str]:
+        """Writes the .pstats, .collapsed and .txt reports; returns their paths."""
+        stats = self.stats()
+        paths = [f"{prefix}.pstats", f"{prefix}.collapsed", f"{prefix}.txt"]
+        stats.dump_stats(paths[0])
+        with open(paths[1], "w", encoding="utf-8") as f:
+            write_collapsed(stats.stats, f)
+        with open(paths[2], "w", encoding="utf-8") as f:
+            write_counters(self.counters, f)
+        return paths
+
+
+def _find(stats: Dict[FuncKey, tuple], filename: str, name: str) -> Optional[FuncKey]:
+    for key in stats:
+        if key[0].endswith(filename) and key[2] == name:
+            return key
+    return None
+
+
+def merge_native(stats: Dict[FuncKey, tuple], counters: VMCounters) -> None:
+    """
+    Adds run_c (called from MiscVM.run, time taken out of MiscVM.run's own time)
+    and its per-opcode and per-syscall children to a pstats dict in place.
+    """
+    if not counters.run_c_calls:
+        return
+    run_c: FuncKey = (NATIVE_FILE, 0, "run_c")
+    seconds = counters.run_c_ns / 1e9
+    calls = counters.run_c_calls
+    caller = _find(stats, "misc.py", "run")
+    callers: Dict[FuncKey, tuple] = {}
+    if caller is not None:
+        cc, nc, tt, ct, parents = stats[caller]
+        stats[caller] = (cc, nc, max(0.0, tt - seconds), ct, parents)
+        callers[caller] = (calls, calls, seconds, seconds)
+    stats[run_c] = (calls, calls, seconds, seconds, callers)
+
+    children: List[Tuple[FuncKey, int]] = []
+    for op, count in enumerate(counters.opcodes):
+        if count:
+            children.append(((NATIVE_FILE, op, f"op {OPCODE_NAMES.get(op, op)}"), count))
+    for syscall_id, count in enumerate(counters.syscalls):
+        if count:
+            children.append(((NATIVE_FILE, 0x100 + syscall_id, f"syscall 0x{syscall_id:02X}"), count))
+    for key, count in children:
+        stats[key] = (count, count, 0.0, 0.0, {run_c: (count, count, 0.0, 0.0)})
+
+
+def write_collapsed(stats: Dict[FuncKey, tuple], file: TextIO) -> None:
+    """
+    Collapsed stacks ("a;b;c <microseconds>") rebuilt from the caller graph. pstats
+    only keeps caller edges, so a function's own time is split between its callers
+    in proportion to the time each call edge accounts for.
+    """
+    children: Dict[FuncKey, List[Tuple[FuncKey, float]]] = {}
+    for func, (_, _, _, _, callers) in stats.items():
+        for caller, edge in callers.items():
+            children.setdefault(caller, []).append((func, edge[3]))
+
+    def label(func: FuncKey) -> str:
+        filename, line, name = func
+        if filename == "~":
+            return name
+        return f"{name} ({filename.rsplit('/', 1)[-1]}:{line})".replace(";", ",")
+
+    lines: Dict[str, float] = {}
+
+    def visit(func: FuncKey, share: float, path: List[FuncKey], names: List[str]) -> None:
+        _, _, tt, ct, _ = stats[func]
+        names.append(label(func))
+        fraction = min(1.0, share / ct) if ct > 0 else 0.0
+        own = tt * fraction
+        if own > 0:
+            key = ";".join(names)
+            lines[key] = lines.get(key, 0.0) + own
+        if len(path) < MAX_STACK_DEPTH:
+            for child, edge_time in children.get(func, []):
+                if child not in path and edge_time * fraction >= MIN_STACK_SECONDS:
+                    visit(child, edge_time * fraction, path + [child], names)
+        names.pop()
+
+    for func, (_, _, _, ct, callers) in stats.items():
+        if not callers:
+            visit(func, ct, [func], [])
+    for stack, seconds in sorted(lines.items()):
+        micros = int(round(seconds * 1e6))
+        if micros:
+            file.write(f"{stack} {micros}\n")
+
+
+def write_counters(counters: VMCounters, file: TextIO = sys.stdout) -> None:
+    """Summary of the native counters."""
+    calls, ns, instructions = counters.run_c_calls, counters.run_c_ns, counters.instructions
+    print(f"run_c calls        : {calls}", file=file)
+    print(f"run_c time         : {ns / 1e9:.3f} s", file=file)
+    print(f"Instructions       : {instructions}", file=file)
+    if ns:
+        print(f"Instructions / s   : {instructions / (ns / 1e9):.0f}", file=file)
+    if calls:
+        print(f"ns per run_c call  : {ns / calls:.0f}", file=file)
+    print("\nOpcode counts:", file=file)
+    for op, count in sorted(enumerate(counters.opcodes), key=lambda e: -e[1]):
+        if count:
+            print(f"  {OPCODE_NAMES.get(op, str(op)):18s} {count:12d}  {100.0 * count / max(instructions, 1):5.1f}%",
+                  file=file)
+    print("\nSyscall counts:", file=file)
+    for syscall_id, count in sorted(enumerate(counters.syscalls), key=lambda e: -e[1]):
+        if count:
+            print(f"  0x{syscall_id:02X} {count:12d}", file=file)
@@ -0,0 +1,182 @@
+"""
+racing.py
+
+Racing / successive-halving evaluation for the genetic algorithm.
+
+Every genome is first scored on a small subset of mazes. Only the best
+fraction survives to be scored on more mazes, and so on through a list of
+rungs. Hopeless genomes therefore cost one or two maze runs instead of a full
+pass over the test set.
+
+A rung is a ``(mazes, keep)`` pair: all genomes still in the race are scored
+until they have run ``mazes`` mazes in total, then only the top ``keep``
+fraction moves on to the next rung. The ``keep`` of the last rung is ignored.
+"""
+from __future__ import annotations
+
+import multiprocessing
+import os
+import random
+from typing import TYPE_CHECKING, Any, Callable, Dict, List, Optional, Sequence, Tuple
+
+from scorer import ScoredProgram
+
+if TYPE_CHECKING:
+    from maze_game import Maze
+    from misc import VMResult
+    from telemetry import Telemetry
+
+Rung = Tuple[int, float]
+MazeTask = Tuple[bytes, "Maze", bool]
+MazeWorker = Callable[[MazeTask], Tuple[int, "VMResult"]]
+
+DEFAULT_RUNGS: List[Rung] = [(1, 0.5), (2, 0.5), (4, 0.5), (8, 1.0)]
+
+
+def parse_rungs(spec: str) -> List[Rung]:
+    """
+    Parses a rung specification such as ``"1:0.5,2:0.5,4:0.5,8"``.
+    A rung without a keep fraction keeps everything.
+    """
+    rungs: List[Rung] = []
+    for part in spec.split(","):
+        part = part.strip()
+        if not part:
+            continue
+        mazes, _, keep = part.partition(":")
+        rungs.append((int(mazes), float(keep) if keep else 1.0))
+    validate_rungs(rungs)
+    return rungs
+
+
+def validate_rungs(rungs: Sequence[Rung]) -> None:
+    """Raises ValueError if the rungs are not strictly increasing or keep nothing."""
+    if not rungs:
+        raise ValueError("At least one rung is required")
+    previous = 0
+    for mazes, keep in rungs:
+        if mazes <= previous:
+            raise ValueError(f"Rung maze counts must be strictly increasing, got {mazes} after {previous}")
+        if not 0.0 < keep <= 1.0:
+            raise ValueError(f"Rung keep fraction must be in (0, 1], got {keep}")
+        previous = mazes
+
+
+class RacingEvaluator:
+    """
+    A ``test_func`` for ``GeneticAlgo`` that races genomes through increasing
+    maze subsets and drops the worst of them after every rung.
+
+    ``worker`` scores one genome on one maze. It must be a picklable,
+    module-level function when ``processes`` is not 1.
+    """
+
+    def __init__(
+                self,
+                worker: MazeWorker,
+                rungs: Sequence[Rung] = DEFAULT_RUNGS,
+                processes: Optional[int] = None,
+            ) :
+        validate_rungs(rungs)
+        self.worker = worker
+        self.rungs = list(rungs)
+        self.processes = processes
+        # Bookkeeping, updated after every call
+        self.last_evaluations = 0
+        self.last_full_evaluations = 0
+        self.total_evaluations = 0
+        self.total_full_evaluations = 0
+
+    @property
+    def total_saved(self) -> int:
+        """Number of maze runs avoided compared to scoring every genome on every rung maze."""
+        return self.total_full_evaluations - self.total_evaluations
+
+    def summary(self) -> str:
+        """One-line report of the evaluations performed and saved so far."""
+        if self.total_full_evaluations == 0:
+            return "Racing: no evaluations yet"
+        saved = self.total_saved
+        return (f"Racing: {self.total_evaluations} maze runs performed, {saved} saved "
+                f"({100.0 * saved / self.total_full_evaluations:.1f}% of {self.total_full_evaluations})")
+
+    def _map(self, pool: Optional[Any], tasks: List[MazeTask]) -> List[Tuple[int, VMResult]]:
+        if pool is None:
+            return [self.worker(task) for task in tasks]
+        workers = self.processes or os.cpu_count() or 1
+        return pool.map(self.worker, tasks, chunksize=max(1, len(tasks) // (4 * workers)))
+
+    def __call__(
+                self,
+                current_population: List[bytes],
+                maze_test_set: List[Maze],
+                log: bool = False,
+                telemetry: Optional[Telemetry] = None,
+                **_: Any
+            ) -> List[ScoredProgram]:
+        """Race the population and return its scores, in population order."""
+        population_size = len(current_population)
+        max_mazes = min(self.rungs[-1][0], len(maze_test_set))
+        # Every genome sees the same mazes in the same order so that partial
+        # scores are comparable within a rung.
+        mazes = random.sample(maze_test_set, max_mazes)
+
+        totals = [0] * population_size
+        runs = [0] * population_size
+        last_result: Dict[int, VMResult] = {}
+        alive = list(range(population_size))
+        # Genomes grouped by the rung in which they were dropped, final survivors last
+        dropped: List[List[int]] = []
+        evaluations = 0
+
+        pool = multiprocessing.Pool(self.processes) if self.processes != 1 else None
+        try:
+            for rung_index, (rung_mazes, keep) in enumerate(self.rungs):
+                rung_mazes = min(rung_mazes, max_mazes)
+                tasks: List[MazeTask] = []
+                owners: List[int] = []
+                for i in alive:
+                    for maze in mazes[runs[i]:rung_mazes]:
+                        tasks.append((current_population[i], maze, log))
+                        owners.append(i)
+
+                for i, (score, result) in zip(owners, self._map(pool, tasks)):
+                    totals[i] += score
+                    runs[i] += 1
+                    last_result[i] = result
+                evaluations += len(tasks)
+
+                if rung_index == len(self.rungs) - 1 or rung_mazes >= max_mazes:
+                    break
+                alive.sort(key=lambda i: totals[i] / runs[i], reverse=True)
+                survivors = max(1, int(round(len(alive) * keep)))
+                dropped.append(alive[survivors:])
+                alive = alive[:survivors]
+        finally:
+            if pool is not None:
+                pool.close()
+                pool.join()
+        dropped.append(alive)
+
+        scores = [totals[i] // max(runs[i], 1) for i in range(population_size)]
+        # A genome dropped at an earlier rung never outranks one that survived it,
+        # even if the survivor's average fell on the later, unseen mazes.
+        floor = None
+        for group in reversed(dropped):
+            if floor is not None:
+                for i in group:
+                    scores[i] = min(scores[i], floor)
+            if group:
+                group_min = min(scores[i] for i in group)
+                floor = group_min if floor is None else min(floor, group_min)
+
+        self.last_evaluations = evaluations
+        self.last_full_evaluations = population_size * max_mazes
+        self.total_evaluations += self.last_evaluations
+        self.total_full_evaluations += self.last_full_evaluations
+        if telemetry is not None:
+            telemetry.count("maze_runs", self.last_evaluations)
+            telemetry.count("maze_runs_saved", self.last_full_evaluations - self.last_evaluations)
+
+        return [ScoredProgram(scores[i], program, last_result[i], index=i)
+                for i, program in enumerate(current_population)]
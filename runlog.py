@@ -0,0 +1,314 @@
+#!/usr/bin/env python3
+"""
+runlog.py
+
+Append-only, per-generation run log in a compact binary columnar format.
+
+One row is written per individual per generation. Rows are buffered into
+column arrays and written in chunks, so logging a generation costs a few
+vectorized copies instead of one csv.writer call per individual. A resumed
+run appends to its existing log, dropping the rows of the generations it is
+about to redo and any torn tail left by the interruption.
+
+File layout (little endian):
+  header  magic "GARUNLOG", u16 version, u16 column count, then per column
+          a 16-byte NUL padded name and an 8-byte NUL padded numpy dtype
+  chunk   magic "CHNK", u32 rows, u32 first generation, u32 last generation,
+          then each column's `rows` values back to back, in header order
+
+Usage:
+  python3 runlog.py info run.log
+  python3 runlog.py export-csv run.log scores.csv [--first-gen N] [--last-gen M]
+"""
+from __future__ import annotations
+
+import argparse
+import csv
+import mmap
+import os
+import struct
+import sys
+from typing import TYPE_CHECKING, BinaryIO, Dict, Iterable, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+if TYPE_CHECKING:
+    from misc import VMResult
+    from scorer import ScoredProgram
+
+MAGIC = b"GARUNLOG"
+VERSION = 1
+_FILE_HEADER = struct.Struct("<8sHH")
+_COLUMN = struct.Struct("<16s8s")
+_CHUNK = struct.Struct("<4sIII")
+CHUNK_MAGIC = b"CHNK"
+
+COLUMNS: Tuple[Tuple[str, str], ...] = (
+    ("generation", "<u4"),
+    ("individual", "<u4"),  # Index in the generation's population
+    ("score", "<i8"),
+    ("steps", "<u4"),
+    ("outcome", "<i2"),     # See outcome_code
+    ("parent1", "<i4"),     # Individual index in the previous generation, -1 if unknown
+    ("parent2", "<i4"),     # Crossover donor, -1 if none
+    ("crossover", "<i2"),   # Crossover byte offset, -1 if the child is a copy
+    ("mutations", "<u2"),
+)
+
+LINEAGE_COLUMNS = ("parent1", "parent2", "crossover", "mutations")
+
+# Outcome codes: 0..255 is a graceful EXIT with that code, -2..-8 are the VM
+# interrupts from vm_core.h, and an unknown syscall N is logged as -(256 + N).
+OUTCOME_UNKNOWN_SYSCALL_BASE = -256
+
+
+def outcome_code(result: VMResult) -> int:
+    """Compact integer code for how a VM run ended."""
+    if not result.halted:
+        return result.exit_code or 0
+    interrupt = result.rt.interrupt
+    if interrupt < -1:
+        return interrupt
+    return OUTCOME_UNKNOWN_SYSCALL_BASE - interrupt
+
+
+class RunLogWriter:
+    """
+    Buffers rows by column and appends them to the log in chunks.
+
+    With `resume_generation` an existing log is kept: it must have the same
+    columns, and everything from `resume_generation` on is cut off so that the
+    resumed run appends exactly the generations it redoes. Otherwise the file
+    is overwritten.
+    """
+
+    def __init__(self, path: str, chunk_rows: int = 1 << 16, columns: Sequence[Tuple[str, str]] = COLUMNS,
+                 resume_generation: Optional[int] = None):
+        self.columns = tuple(columns)
+        self.chunk_rows = chunk_rows
+        self._buffers = {name: np.zeros(chunk_rows, dtype=dtype) for name, dtype in self.columns}
+        self._rows = 0
+        if resume_generation is not None and os.path.exists(path) and os.path.getsize(path) > 0:
+            self._resume(path, resume_generation)
+            return
+        self._file: BinaryIO = open(path, "wb")
+        self._file.write(_FILE_HEADER.pack(MAGIC, VERSION, len(self.columns)))
+        for name, dtype in self.columns:
+            self._file.write(_COLUMN.pack(name.encode("ascii"), dtype.encode("ascii")))
+
+    def _resume(self, path: str, generation: int) -> None:
+        with RunLogReader(path) as reader:
+            if [(name, dtype.str) for name, dtype in reader.columns] != \
+                    [(name, np.dtype(dtype).str) for name, dtype in self.columns]:
+                raise ValueError(f"Run log '{path}' has different columns and cannot be resumed")
+            # Chunks are in generation order; the first one reaching `generation`
+            # may still hold earlier rows, which are written again below.
+            cut = next((i for i, c in enumerate(reader.chunks) if c[2] >= generation), len(reader.chunks))
+            end = reader.chunks[cut][3] - _CHUNK.size if cut < len(reader.chunks) else reader.end
+            kept = [reader.chunk(i) for i in range(cut, len(reader.chunks))]
+        self._file = open(path, "r+b")
+        self._file.truncate(end)
+        self._file.seek(end)
+        for chunk in kept:
+            generations = chunk["generation"]
+            for g in np.unique(generations[generations < generation]):
+                rows = generations == g
+                self.append(int(g), **{name: values[rows] for name, values in chunk.items() if name != "generation"})
+
+    def append(self, generation: int, **values: np.ndarray) -> None:
+        """
+        Appends one generation's rows. Each keyword is a column; columns that
+        are not given are filled with -1 (or 0 for unsigned columns).
+        """
+        count = len(next(iter(values.values()))) if values else 0
+        done = 0
+        while done < count:
+            take = min(count - done, self.chunk_rows - self._rows)
+            rows = slice(self._rows, self._rows + take)
+            for name, _ in self.columns:
+                buf = self._buffers[name]
+                if name == "generation":
+                    buf[rows] = generation
+                elif name in values:
+                    buf[rows] = values[name][done:done + take]
+                else:
+                    buf[rows] = -1 if buf.dtype.kind == "i" else 0
+            self._rows += take
+            done += take
+            if self._rows == self.chunk_rows:
+                self.flush()
+
+    def log_generation(self, generation: int, scored_population: List[ScoredProgram],
+                       lineage: Optional[np.ndarray] = None) -> None:
+        """
+        GeneticAlgo ``hook_log_results``: one row per scored individual, with its
+        parents, crossover point and mutation count when the lineage is known.
+        """
+        count = len(scored_population)
+        individual = np.fromiter((sp.index for sp in scored_population), dtype=np.int64, count=count)
+        values = {
+            "individual": individual,
+            "score": np.fromiter((sp.score for sp in scored_population), dtype=np.int64, count=count),
+            "steps": np.fromiter((sp.result.steps for sp in scored_population), dtype=np.int64, count=count),
+            "outcome": np.fromiter((outcome_code(sp.result) for sp in scored_population), dtype=np.int64, count=count),
+        }
+        if lineage is not None and count and individual.min() >= 0:
+            for name in LINEAGE_COLUMNS:
+                if name in self._buffers:
+                    values[name] = lineage[name][individual]
+        self.append(generation, **values)
+
+    def flush(self) -> None:
+        if self._rows == 0:
+            return
+        generations = self._buffers["generation"][:self._rows]
+        self._file.write(_CHUNK.pack(CHUNK_MAGIC, self._rows, int(generations.min()), int(generations.max())))
+        for name, _ in self.columns:
+            self._file.write(self._buffers[name][:self._rows].tobytes())
+        self._file.flush()
+        self._rows = 0
+
+    def close(self) -> None:
+        self.flush()
+        self._file.close()
+
+    def __enter__(self) -> RunLogWriter:
+        return self
+
+    def __exit__(self, *_) -> None:
+        self.close()
+
+
+class RunLogReader:
+    """Indexes a memory-mapped run log's chunks and loads generation ranges into NumPy."""
+
+    def __init__(self, path: str):
+        with open(path, "rb") as f:
+            if os.fstat(f.fileno()).st_size < _FILE_HEADER.size:
+                raise ValueError("Not a run log")
+            self._data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, num_columns = _FILE_HEADER.unpack_from(self._data, 0)
+        if magic != MAGIC:
+            self.close()
+            raise ValueError("Not a run log")
+        if version != VERSION:
+            self.close()
+            raise ValueError(f"Unsupported run log version {version}")
+        offset = _FILE_HEADER.size
+        columns = []
+        for _ in range(num_columns):
+            name, dtype = _COLUMN.unpack_from(self._data, offset)
+            columns.append((name.rstrip(b"\0").decode("ascii"), np.dtype(dtype.rstrip(b"\0").decode("ascii"))))
+            offset += _COLUMN.size
+        self.columns: Tuple[Tuple[str, np.dtype], ...] = tuple(columns)
+        row_bytes = sum(dtype.itemsize for _, dtype in self.columns)
+
+        # (rows, first generation, last generation, data offset) per chunk
+        self.chunks: List[Tuple[int, int, int, int]] = []
+        while offset + _CHUNK.size <= len(self._data):
+            magic, rows, first, last = _CHUNK.unpack_from(self._data, offset)
+            if magic != CHUNK_MAGIC or offset + _CHUNK.size + rows * row_bytes > len(self._data):
+                break  # Torn tail from an interrupted run
+            self.chunks.append((rows, first, last, offset + _CHUNK.size))
+            offset += _CHUNK.size + rows * row_bytes
+        self.end = offset  # End of the last complete chunk
+
+    def close(self) -> None:
+        self._data.close()
+
+    def __enter__(self) -> RunLogReader:
+        return self
+
+    def __exit__(self, *_) -> None:
+        self.close()
+
+    def chunk(self, index: int) -> Dict[str, np.ndarray]:
+        """All columns of one chunk, copied out of the mapping."""
+        rows, _, _, offset = self.chunks[index]
+        chunk = {}
+        for name, dtype in self.columns:
+            chunk[name] = np.frombuffer(self._data, dtype=dtype, count=rows, offset=offset).copy()
+            offset += rows * dtype.itemsize
+        return chunk
+
+    @property
+    def generations(self) -> Tuple[int, int]:
+        """First and last generation in the log, or (0, -1) if it is empty."""
+        if not self.chunks:
+            return 0, -1
+        return min(c[1] for c in self.chunks), max(c[2] for c in self.chunks)
+
+    def load(
+                self,
+                first_gen: Optional[int] = None,
+                last_gen: Optional[int] = None,
+                columns: Optional[Iterable[str]] = None,
+            ) -> Dict[str, np.ndarray]:
+        """Loads the rows of generations [first_gen, last_gen] (inclusive) as column arrays (copies)."""
+        lo = first_gen if first_gen is not None else 0
+        hi = last_gen if last_gen is not None else 2**32 - 1
+        wanted = list(columns) if columns is not None else [name for name, _ in self.columns]
+        parts: Dict[str, List[np.ndarray]] = {name: [] for name in wanted}
+        for rows, first, last, offset in self.chunks:
+            if last < lo or first > hi:
+                continue
+            chunk = {}
+            col_offset = offset
+            for name, dtype in self.columns:
+                if name in parts or name == "generation":
+                    chunk[name] = np.frombuffer(self._data, dtype=dtype, count=rows, offset=col_offset)
+                col_offset += rows * dtype.itemsize
+            mask = None
+            if first < lo or last > hi:
+                mask = (chunk["generation"] >= lo) & (chunk["generation"] <= hi)
+            for name in wanted:
+                parts[name].append(chunk[name] if mask is None else chunk[name][mask])
+        dtypes = dict(self.columns)
+        return {name: (np.concatenate(p) if p else np.zeros(0, dtype=dtypes[name])) for name, p in parts.items()}
+
+
+def export_csv(log_path: str, csv_path: str, first_gen: Optional[int] = None, last_gen: Optional[int] = None) -> int:
+    """Converts (part of) a run log to CSV. Returns the number of rows written."""
+    with RunLogReader(log_path) as reader:
+        data = reader.load(first_gen, last_gen)
+        names = [name for name, _ in reader.columns]
+    with open(csv_path, "w", newline="", encoding="utf-8") as f:
+        writer = csv.writer(f)
+        writer.writerow(names)
+        writer.writerows(zip(*(data[name].tolist() for name in names)))
+    return len(data[names[0]]) if names else 0
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Inspect or convert a binary GA run log.")
+    sub = ap.add_subparsers(dest="command", required=True)
+    info = sub.add_parser("info", help="Print the columns, chunks and generation range.")
+    info.add_argument("log")
+    export = sub.add_parser("export-csv", help="Convert a generation range to CSV.")
+    export.add_argument("log")
+    export.add_argument("csv")
+    export.add_argument("--first-gen", type=int, default=None)
+    export.add_argument("--last-gen", type=int, default=None)
+    args = ap.parse_args()
+
+    try:
+        if args.command == "info":
+            with RunLogReader(args.log) as reader:
+                first, last = reader.generations
+                print(f"Columns    : {', '.join(f'{n}:{d.str}' for n, d in reader.columns)}")
+                print(f"Chunks     : {len(reader.chunks)}")
+                print(f"Rows       : {sum(c[0] for c in reader.chunks)}")
+                print(f"Generations: {first}..{last}")
+        else:
+            rows = export_csv(args.log, args.csv, args.first_gen, args.last_gen)
+            print(f"Wrote {rows} rows to {args.csv}", file=sys.stderr)
+    except FileNotFoundError:
+        print(f"Error: Run log not found at '{args.log}'", file=sys.stderr)
+        sys.exit(1)
+    except ValueError as e:
+        print(f"Run log error: {e}", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
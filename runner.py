@@ -21,30 +21,55 @@ No external packages required.
 """
 
 import argparse
+import contextlib
 import os
 import random
 import json
 import csv
 import sys
 import multiprocessing
-import statistics
+import threading
+import time
+from multiprocessing.pool import ThreadPool
 try:
     import matplotlib.pyplot as plt
 except ImportError:
     plt = None
     progress = None
 
-from typing import Dict, List, Tuple, Any
+from typing import Callable, Dict, List, Optional, Tuple, Any
 
 # --- Your VM must be importable (same directory or PYTHONPATH) ---
-from misc import MiscVM, Endian, VMResult  # noqa: F401
+from misc import MiscVM, Endian, VMContext, VMResult  # noqa: F401
 from scorer import ScoredProgram
+from score_stats import ScoreStats
 from maze_game import Maze
 from maze_scorer import grade_maze_performance
+from output_scorer import DEFAULT_TARGET, grade_output_performance
 import maze_syscalls as _m_syscalls
-from syscalls import build_systable, OutputStream
+from syscalls import build_systable, ExitSyscall, OutputStream, PutcSyscall, SyscallTable
 from genetics import GeneticAlgo
 from bar import RunnerProgress
+from racing import RacingEvaluator, parse_rungs
+from diversity import DiversityLog
+from novelty import NoveltySearch
+from behaviour import Descriptor, maze_descriptor
+from map_elites import MapElites
+from nsga import NSGA2GeneticAlgo
+from runlog import RunLogWriter
+from telemetry import JsonLinesSink, MemorySink, RunLogSink, Telemetry
+from metrics_server import MetricsServer, termination_reason
+from perf_counters import PerfCounters
+from syscall_profile import SyscallProfile
+from profiling import Profiler
+from genome_archive import GenomeArchive
+import checkpoint
+import environments
+from fuzz import COVERAGE_MAP_SIZE, Fuzzer
+from triage import write_corpus
+
+# Behaviour descriptor function, see behaviour.py
+Describe = Callable[[VMResult, Maze, bytes], Descriptor]
 
 # ========= Syscalls ==========
 
@@ -60,17 +85,57 @@ def initialize_syscalls(output_stream: OutputStream, maze: Maze | None = None) -
 # ========== Assembly helpers ==========
 
 def random_program_bytes(words: int) -> bytes:
-    return os.urandom(words * 2)  # 2 bytes per 16-bit word
+    return random.randbytes(words * 2)  # 2 bytes per 16-bit word, reproducible under --seed
 
 
 # ========== VM run wrapper ==========
 
-def run_one(_: int, program_words: List[int], maze: Maze, log: bool = False) -> VMResult:
-    """Run a single program"""
-    output_stream = OutputStream(log)
-    systable = initialize_syscalls(output_stream, maze=maze)
+TASKS = ("maze", "putc")
+OUTPUT_TASK_SYSCALLS = [ExitSyscall, PutcSyscall]  # The PUTC task has no maze
+
+# Set by --syscall-profile; shared by every VM of this process
+SYSCALL_PROFILE: Optional[SyscallProfile] = None
+
+MAX_STEPS = 500
+OUTPUT_CAPACITY = 512  # Bytes of PUTC output kept per run; a run can't PUTC more than MAX_STEPS times
+
+# Syscall table, output stream, VM context and VM of each worker thread, built on first use
+_worker = threading.local()
+
+def _worker_vm(target: Optional[bytes]) -> Tuple[MiscVM, SyscallTable]:
+    """The worker's VM and table for the maze task, or for the PUTC task (no maze syscalls) with a target."""
+    if not hasattr(_worker, "vms"):
+        _worker.stream = OutputStream()
+        _worker.context = VMContext(OUTPUT_CAPACITY, overflow="truncate")
+        _worker.target = None
+        _worker.vms = {}
+    task = "maze" if target is None else "putc"
+    entry = _worker.vms.get(task)
+    if entry is None:
+        classes = None if task == "maze" else OUTPUT_TASK_SYSCALLS
+        table = SyscallTable(classes=classes, stream=_worker.stream, maze=None)
+        entry = _worker.vms[task] = (MiscVM(systable=table.slots, context=_worker.context), table)
+    return entry
+
+def run_one(_: int, program_words: List[int], maze: Optional[Maze], log: bool = False,
+            target: Optional[bytes] = None, max_mismatches: int = 0) -> VMResult:
+    """
+    Run a single program. PUTC is served natively into the worker's VMContext,
+    and matched against `target` there when one is given.
+    """
+    vm, table = _worker_vm(target)
+    output_stream = _worker.stream
+    output_stream.clear()
+    output_stream.echo = log
+    context = _worker.context
+    context.echo = log  # Bulk write of the run's output when it ends
+    if _worker.target != (target, max_mismatches):
+        context.set_target(target, max_mismatches)
+        _worker.target = (target, max_mismatches)
+    table.bind(stream=output_stream, maze=maze)
+    vm.profile = SYSCALL_PROFILE
 
-    return MiscVM(systable=systable).run(program_words, max_steps=500)
+    return vm.run(program_words, max_steps=MAX_STEPS)
 
 
 # ========== Tally + summary ==========
@@ -118,38 +183,194 @@ def plot_results(num_generations: int, final_scores: List[int], avg_scores: List
 
 # ======== Worker for multiprocessing ========
 
-def process_individual(args_tuple: Tuple[bytes, List[Maze], Endian, bool, int]) -> ScoredProgram:
+def process_individual(args_tuple: Tuple[bytes, List[Maze], Endian, bool, int, Optional[Describe], int]) -> ScoredProgram:
     """
     Worker function to run a single program and score it.
     Designed to be used with multiprocessing.Pool.
     """
-    program_bytes, maze_test_set, _, log, index = args_tuple
+    program_bytes, maze_test_set, _, log, index, describe, seed = args_tuple
 
-    # Each worker process should have its own random seed.
-    random.seed()
+    # Each individual draws from its own generator, seeded by the parent
+    # process, so results do not depend on which worker runs it.
+    rng = random.Random(seed)
 
-    # Select a random maze for this individual
-    current_maze = random.choice(maze_test_set)
-    current_maze.reset()
+    # Select a random maze for this individual. Work on a copy so that
+    # threads sharing the test set do not move each other's players.
+    current_maze = rng.choice(maze_test_set).fresh_copy()
 
     words = program_bytes
     r = run_one(index, words, maze=current_maze, log=log)
     score = grade_maze_performance(r, current_maze)
+    descriptor = describe(r, current_maze, program_bytes) if describe else None
 
-    return ScoredProgram(score, program_bytes, r)
+    return ScoredProgram(score, program_bytes, r, descriptor, index)
 
-# ======== Test runtime =========
+def process_output_individual(args_tuple: Tuple[bytes, bytes, int, bool, int]) -> ScoredProgram:
+    """
+    Worker function to score a program on the PUTC task: printing `target`.
+    """
+    program_bytes, target, max_mismatches, log, index = args_tuple
+    r = run_one(index, program_bytes, maze=None, log=log, target=target, max_mismatches=max_mismatches)
+    return ScoredProgram(grade_output_performance(r, target), program_bytes, r, None, index)
 
-def test(current_population: List[bytes], maze_test_set: List[Maze], endian: Endian, log: bool, **_: Any) -> List[ScoredProgram]:
-    """Run a generational test"""
-    # scored_population = [process_individual((program_bytes, maze_test_set, endian, log, i)) for i, program_bytes in enumerate(current_population)]
-    tasks = [(program_bytes, maze_test_set, endian, log, i) for i, program_bytes in enumerate(current_population)]
+def process_maze_run(args_tuple: Tuple[bytes, Maze, bool]) -> Tuple[int, VMResult]:
+    """
+    Worker function to score one program on one given maze.
+    Used by the racing evaluator, which picks the mazes itself.
+    """
+    program_bytes, maze, log = args_tuple
+    maze.reset()
+    r = run_one(0, program_bytes, maze=maze, log=log)
+    return grade_maze_performance(r, maze), r
 
-    with multiprocessing.Pool() as pool:
-        scored_population = list(pool.imap_unordered(process_individual, tasks))
+# ======== Test runtime =========
 
+BACKENDS = ("process", "thread", "serial", "native")
+
+# Native tasks of the last maze test set (or target), built once and reused every generation
+_native_tasks: Tuple[Any, List[environments.Task]] = (None, [])
+
+def _native_task_list(task: str, maze_test_set: List[Maze], target: bytes, max_mismatches: int,
+                      env_config: bytes) -> List[environments.Task]:
+    global _native_tasks
+    # Keyed on the maze configs rather than id(maze_test_set), which a later set can reuse
+    configs = tuple(environments.maze_config(m) for m in maze_test_set) if task == "maze" else ()
+    key = (task, configs, target, max_mismatches, env_config)
+    if _native_tasks[0] != key:
+        env = environments.Environment(task)
+        if task == "maze":
+            tasks = [env.task(config) for config in configs]
+        elif task == "putc":
+            tasks = [env.task(environments.putc_config(target, max_mismatches))]
+        else:
+            tasks = [env.task(env_config)]
+        _native_tasks = (key, tasks)
+    return _native_tasks[1]
+
+def test_native(current_population: List[bytes], maze_test_set: List[Maze], describe: Optional[Describe],
+                processes: Optional[int], task: str, target: bytes, max_mismatches: int,
+                env_config: bytes = b"", telemetry: Optional[Telemetry] = None) -> List[ScoredProgram]:
+    """
+    The native backend: the whole generation runs and is scored in C (see
+    environments.py), on `processes` threads. A maze run picks the same maze as
+    the other backends, so scores are identical. The C batch alone is timed as
+    the "native" telemetry phase.
+    """
+    if describe is not None and describe is not maze_descriptor:
+        raise ValueError("The native backend only computes behaviour.maze_descriptor")
+    tasks = _native_task_list(task, maze_test_set, target, max_mismatches, env_config)
+    if task == "maze":
+        generation_seed = random.getrandbits(64)
+        task_index = [random.Random(_task_seed(generation_seed, i)).randrange(len(maze_test_set))
+                      for i in range(len(current_population))]
+    else:
+        task_index = [0] * len(current_population)
+    with telemetry.phase("native") if telemetry is not None else contextlib.nullcontext():
+        results = environments.evaluate(tasks, task_index, current_population, max_steps=MAX_STEPS,
+                                        threads=processes or os.cpu_count() or 1)
+    dims = tasks[0].environment.descriptor_dims
+    return [ScoredProgram(r.score, program_bytes, environments.to_vm_result(r),
+                          environments.descriptor(r, dims) if describe else None, i)
+            for i, (program_bytes, r) in enumerate(zip(current_population, results))]
+
+def _task_seed(generation_seed: int, index: int) -> int:
+    return (generation_seed + index * 0x9E3779B97F4A7C15) & 0xFFFFFFFFFFFFFFFF
+
+def test(current_population: List[bytes], maze_test_set: List[Maze], endian: Endian, log: bool,
+         describe: Optional[Describe] = None, score_stats: Optional[ScoreStats] = None,
+         backend: str = "process", processes: Optional[int] = None, telemetry: Optional[Telemetry] = None,
+         task: str = "maze", target: bytes = DEFAULT_TARGET, max_mismatches: int = 0, env_config: bytes = b"",
+         **_: Any) -> List[ScoredProgram]:
+    """
+    Run a generational test, updating `score_stats` as each result arrives.
+    `task` is "maze" (one random maze of the test set per program) or "putc"
+    (print `target`, stopped after more than `max_mismatches` wrong characters).
+    With the "native" backend `task` may also be an environment loaded with
+    environments.load, configured by `env_config`.
+    `backend` is "process" (multiprocessing pool), "thread" (thread pool),
+    "serial" or "native" (C threads); `processes` sizes the pool. Results are returned in population order,
+    so a seeded run is reproducible whichever backend evaluates it.
+    """
+    if backend == "native":
+        scored_population = test_native(current_population, maze_test_set, describe, processes, task, target,
+                                        max_mismatches, env_config, telemetry)
+        if score_stats is not None:
+            score_stats.add_many([sp.score for sp in scored_population])
+        if telemetry is not None and task == "maze":
+            telemetry.count("maze_runs", len(current_population))
+        return scored_population
+
+    if task == "maze":
+        worker = process_individual
+        generation_seed = random.getrandbits(64)
+        tasks = [(program_bytes, maze_test_set, endian, log, i, describe, _task_seed(generation_seed, i))
+                 for i, program_bytes in enumerate(current_population)]
+    elif task == "putc":
+        worker = process_output_individual
+        tasks = [(program_bytes, target, max_mismatches, log, i) for i, program_bytes in enumerate(current_population)]
+    else:
+        raise ValueError(f"Unknown task: {task}")
+
+    scored_population: List[ScoredProgram] = []
+    def collect(results):
+        for scored in results:
+            if score_stats is not None:
+                score_stats.add(scored.score)
+            scored_population.append(scored)
+
+    if backend == "serial":
+        collect(map(worker, tasks))
+    elif backend == "thread":
+        with ThreadPool(processes) as pool:
+            collect(pool.imap_unordered(worker, tasks))
+    elif backend == "process":
+        with multiprocessing.Pool(processes) as pool:
+            collect(pool.imap_unordered(worker, tasks))
+    else:
+        raise ValueError(f"Unknown backend: {backend}")
+
+    scored_population.sort(key=lambda sp: sp.index)
+    if telemetry is not None and task == "maze":
+        telemetry.count("maze_runs", len(current_population))  # One maze per individual
     return scored_population
 
+def run_fuzzer(args: argparse.Namespace, seeds: List[bytes], maze_test_set: List[Maze], target: bytes,
+               env_config: bytes) -> None:
+    """--fuzz: a coverage-guided campaign on the native environment of --task."""
+    env = environments.Environment(args.task)
+    if args.task == "maze":
+        task = env.task(environments.maze_config(maze_test_set[0]))
+    elif args.task == "putc":
+        task = env.task(environments.putc_config(target, args.target_mismatches))
+    else:
+        task = env.task(env_config)
+    print(f"--- Fuzzing the '{args.task}' environment for {args.fuzz} executions ---")
+    start = time.perf_counter()
+    fuzzer = Fuzzer(task, seeds, max_steps=MAX_STEPS)
+
+    def report(f: Fuzzer) -> None:
+        if not args.no_live:
+            print(f"  {f.executions:10d} execs  corpus {len(f.corpus):6d}  edges {f.coverage.edges:5d}  "
+                  f"outcomes {len(f.outcomes):4d}")
+
+    fuzzer.run(args.fuzz, report)
+    elapsed = time.perf_counter() - start
+    print("\n=== Fuzzing Summary ===")
+    print(f"Executions      : {fuzzer.executions}")
+    print(f"Executions / s  : {fuzzer.executions / elapsed:.0f} overall, "
+          f"{fuzzer.native_executions_per_second:.0f} native")
+    print(f"Corpus          : {len(fuzzer.corpus)}")
+    print(f"Edges covered   : {fuzzer.coverage.edges} / {COVERAGE_MAP_SIZE}")
+    print(f"Outcomes seen   : {len(fuzzer.outcomes)}")
+    for code, count in sorted(fuzzer.outcomes.items(), key=lambda e: -e[1])[:10]:
+        print(f"  {termination_reason(code):18s} {code:6d} {count:10d}")
+    if args.fuzz_corpus:
+        summary = write_corpus(args.fuzz_corpus, task, [e.program for e in fuzzer.corpus], MAX_STEPS,
+                               args.processes)
+        print(f"Corpus written  : {args.fuzz_corpus} ({summary.kept} of {summary.programs} programs kept, "
+              f"{summary.buckets} buckets)")
+        print(f"Crashes reduced : {summary.crashes} buckets, {summary.bytes_before} -> {summary.bytes_after} bytes")
+
 def main() -> None:
     """main method"""
     ap = argparse.ArgumentParser(description="Fuzz random MISC programs with live progress and tallies.")
@@ -168,6 +389,10 @@ def main() -> None:
                     help="Disable live progress/tallies (useful in non-TTY logs).")
     ap.add_argument("--force-live", action="store_true",
                 help="Force live progress even if stdout/stderr is not a TTY.")
+    ap.add_argument("--seed", type=int, default=None,
+                    help="Seed for mazes, the initial population and evolution, for reproducible runs.")
+    ap.add_argument("--backend", choices=BACKENDS, default="process",
+                    help="How each generation is evaluated: process pool (default), thread pool or serially.")
     ap.add_argument("--generations", type=int, default=1,
                     help="Number of generations to run for the genetic algorithm.")
     ap.add_argument("--mutation-rate", type=float, default=0.001,
@@ -182,20 +407,182 @@ def main() -> None:
                     help="Show a plot of scores at the end (requires matplotlib).")
     ap.add_argument("--processes", type=int, default=os.cpu_count(),
                     help="Number of processes to use for evaluation. Defaults to all available CPU cores.")
+    ap.add_argument("--checkpoint", type=str, default=None,
+                    help="Path of a binary checkpoint rewritten in the background during the run.")
+    ap.add_argument("--checkpoint-every", type=int, default=1,
+                    help="Write a checkpoint every N generations.")
+    ap.add_argument("--resume", type=str, default=None,
+                    help="Resume from a checkpoint written with --checkpoint (population, mazes, RNG, generation).")
     ap.add_argument("--csv-log", type=str, default=None,
                     help="Path to save a CSV log of all fitness scores per generation.")
+    ap.add_argument("--genome-archive", type=str, default=None,
+                    help="Path to save every evaluated genome, deduplicated and compressed. "
+                    "Inspect with 'genome_archive.py'.")
+    ap.add_argument("--run-log", type=str, default=None,
+                    help="Path to save a binary columnar log (generation, individual, score, steps, outcome, parents) "
+                    "of every individual. Convert with 'runlog.py export-csv'.")
+    ap.add_argument("--telemetry", type=str, default=None,
+                    help="Path to save per-generation phase timings (wall and CPU time of test, select and reproduce), "
+                    "evaluations/s and worker utilization. JSON lines for a .jsonl path, otherwise a binary run log.")
+    ap.add_argument("--metrics-port", type=int, default=None,
+                    help="Serve live run metrics in Prometheus text format at http://127.0.0.1:PORT/metrics.")
+    ap.add_argument("--perf-counters", action="store_true",
+                    help="Count cycles, instructions, branches and cache misses of each test phase with perf_event_open "
+                    "and report IPC and branch-miss rate in the telemetry. Skipped with a warning if unavailable.")
+    ap.add_argument("--syscall-profile", action="store_true",
+                    help="Record per-syscall call counts and latency histograms (Python boundary roundtrip and "
+                    "handler) and print them at the end. Evaluates in this process (process backend becomes thread).")
+    ap.add_argument("--profile", type=str, nargs="?", const="profile", default=None, metavar="PREFIX",
+                    help="Profile the run with cProfile plus native vm_core counters (run_c time, opcode and syscall "
+                    "counts) and write PREFIX.pstats, PREFIX.collapsed (flamegraph stacks) and PREFIX.txt. "
+                    "Evaluates serially so all work is in the profiled thread.")
+    ap.add_argument("--racing", type=str, default=None, metavar="RUNGS",
+                    help="Score genomes by racing them through maze subsets, e.g. '1:0.5,2:0.5,4:0.5,8'. "
+                    "Each rung is MAZES:KEEP, the cumulative maze count and the fraction kept afterwards.")
+    ap.add_argument("--novelty", action="store_true",
+                    help="Select on behavioural novelty (k-NN distance to an archive of past behaviours) instead of maze score.")
+    ap.add_argument("--novelty-k", type=int, default=15,
+                    help="Number of nearest neighbours used for novelty scores.")
+    ap.add_argument("--map-elites", action="store_true",
+                    help="Run MAP-Elites (grid of elites by end position, effective length and syscall count) "
+                    "instead of the plain genetic algorithm. Each generation breeds --count offspring.")
+    ap.add_argument("--nsga2", action="store_true",
+                    help="Select parents NSGA-II style on maze score, program length and steps used together.")
+    ap.add_argument("--diversity", action="store_true",
+                    help="Measure population diversity (Hamming distance, unique genomes, bit entropy) every generation.")
+
+    ap.add_argument("--task", type=str, default="maze",
+                    help="What programs are scored on: navigating a maze (default), printing --target with PUTC "
+                    "('putc'), or with --backend native an environment loaded with --env-plugin.")
+    ap.add_argument("--target", type=str, default=DEFAULT_TARGET.decode("latin-1"),
+                    help="Text the putc task asks for; backslash escapes such as \\n are decoded. Default: hello world\\n.")
+    ap.add_argument("--target-mismatches", type=int, default=2,
+                    help="Wrong characters a putc run may print before it is stopped as diverged.")
+    ap.add_argument("--env-plugin", type=str, action="append", default=[], metavar="PATH",
+                    help="Load a native environment from a shared object exporting vm_environment() (see vm_core.h); "
+                    "select it with --task NAME --backend native. May be repeated.")
+    ap.add_argument("--env-config", type=str, default=None, metavar="PATH",
+                    help="File whose bytes configure a plugin environment's task.")
+
+    ap.add_argument("--fuzz", type=int, default=None, metavar="EXECUTIONS",
+                    help="Instead of evolving, fuzz the --task environment natively for about this many executions, "
+                    "keeping programs that reach new edge coverage or end in new ways. The initial population seeds "
+                    "the corpus; a maze task uses the first maze.")
+    ap.add_argument("--fuzz-corpus", type=str, default=None, metavar="DIR",
+                    help="After --fuzz, write the corpus minimized to its edge coverage as raw .bin programs into DIR, "
+                    "plus DIR/crashes with one reduced program per (interrupt, pc, opcode) crash bucket.")
 
     # Maze-specific arguments
     ap.add_argument("--maze-width", type=int, default=15, help="Width of the mazes to generate.")
     ap.add_argument("--maze-height", type=int, default=15, help="Height of the mazes to generate.")
 
     args = ap.parse_args()
+    if args.seed is not None:
+        random.seed(args.seed)
 
     if args.fixed_words is None and args.min_words > args.max_words:
         ap.error("--min-words cannot be greater than --max-words")
 
+    try:
+        target = args.target.encode("latin-1").decode("unicode_escape").encode("latin-1")
+    except UnicodeError as e:
+        ap.error(f"Invalid --target: {e}")
+    for path in args.env_plugin:
+        try:
+            print(f"--- Loaded environment '{environments.load(path)}' from {path} ---")
+        except OSError as e:
+            ap.error(str(e))
+    env_config = b""
+    if args.env_config:
+        try:
+            with open(args.env_config, "rb") as f:
+                env_config = f.read()
+        except OSError as e:
+            ap.error(f"Could not read --env-config: {e}")
+    if args.task not in TASKS:
+        if args.task not in environments.names():
+            ap.error(f"Unknown task '{args.task}'; choose from {', '.join(environments.names())}")
+        if args.backend != "native" and args.fuzz is None:
+            ap.error(f"Task '{args.task}' is a native environment and needs --backend native or --fuzz")
+        if args.racing or args.novelty or args.map_elites:
+            ap.error(f"Task '{args.task}' cannot be combined with --racing, --novelty or --map-elites")
+    if args.fuzz_corpus and args.fuzz is None:
+        ap.error("--fuzz-corpus needs --fuzz")
+    if args.fuzz is not None:
+        if args.fuzz < 0:
+            ap.error("--fuzz cannot be negative")
+        if args.racing or args.novelty or args.map_elites or args.nsga2:
+            ap.error("--fuzz replaces the genetic algorithm and cannot be combined with its selection options")
+        ga_outputs = {
+            "--checkpoint": args.checkpoint, "--resume": args.resume, "--csv-log": args.csv_log,
+            "--run-log": args.run_log, "--genome-archive": args.genome_archive, "--telemetry": args.telemetry,
+            "--metrics-port": args.metrics_port is not None, "--perf-counters": args.perf_counters,
+            "--diversity": args.diversity, "--save-population": args.save_population, "--plot": args.plot,
+        }
+        used = [flag for flag, value in ga_outputs.items() if value]
+        if used:
+            ap.error(f"{', '.join(used)} record genetic algorithm generations and cannot be combined with --fuzz")
+    if args.backend == "native":
+        if args.racing or args.map_elites:
+            ap.error("--backend native cannot be combined with --racing or --map-elites")
+        if args.syscall_profile:
+            ap.error("--syscall-profile measures the Python syscall boundary, which --backend native skips")
+    if args.task == "putc":
+        if not target:
+            ap.error("--target cannot be empty")
+        if args.target_mismatches < 0:
+            ap.error("--target-mismatches cannot be negative")
+        if args.racing or args.novelty or args.map_elites:
+            ap.error("--task putc cannot be combined with --racing, --novelty or --map-elites, which score mazes")
+
+    racing = None
+    if args.racing:
+        try:
+            racing = RacingEvaluator(process_maze_run, parse_rungs(args.racing), processes=args.processes)
+        except ValueError as e:
+            ap.error(f"Invalid --racing rungs: {e}")
+    if racing and args.novelty:
+        ap.error("--racing and --novelty cannot be combined")
+    if args.map_elites and (racing or args.novelty):
+        ap.error("--map-elites cannot be combined with --racing or --novelty")
+    if args.map_elites and (args.checkpoint or args.resume):
+        ap.error("--checkpoint and --resume only apply to the genetic algorithm, not --map-elites")
+    novelty = NoveltySearch(test, k=args.novelty_k) if args.novelty else None
+    if args.profile:
+        if racing:
+            ap.error("--profile cannot be combined with --racing, which evaluates in worker processes")
+        if args.backend in ("process", "thread"):
+            print("--- Profiling: evaluating with the serial backend so all work is in the profiled thread ---")
+            args.backend = "serial"
+    if args.syscall_profile:
+        if racing:
+            ap.error("--syscall-profile cannot be combined with --racing, which evaluates in worker processes")
+        if args.backend == "process":
+            print("--- Syscall profiling: evaluating with the thread backend so every run is recorded ---")
+            args.backend = "thread"
+        global SYSCALL_PROFILE
+        SYSCALL_PROFILE = SyscallProfile()
+
     # --- Initial Population ---
-    if args.load_population:
+    start_generation = 0
+    if args.resume:
+        print(f"--- Resuming from checkpoint {args.resume} ---")
+        try:
+            resumed = checkpoint.load(args.resume)
+        except FileNotFoundError:
+            ap.error(f"Checkpoint file not found: {args.resume}")
+        except ValueError as e:
+            ap.error(f"Invalid checkpoint '{args.resume}': {e}")
+        if args.nsga2 and resumed.front is None:
+            ap.error(f"Checkpoint '{args.resume}' was not written by an --nsga2 run and has no survivor front")
+        if args.novelty and resumed.novelty is None:
+            ap.error(f"Checkpoint '{args.resume}' was not written by a --novelty run and has no novelty archive")
+        current_population = resumed.population
+        maze_test_set = resumed.mazes
+        start_generation = resumed.generation
+        resumed.restore_rng()
+        print(f"--- Continuing at generation {start_generation} with {len(current_population)} programs ---")
+    elif args.load_population:
         print(f"--- Loading population and mazes from {args.load_population} ---")
         try:
             with open(args.load_population, 'r', encoding='utf-8') as f:
@@ -226,6 +613,10 @@ def main() -> None:
         print(f"--- Generating 100 mazes of size {args.maze_width}x{args.maze_height} ---")
         maze_test_set = [Maze(width=args.maze_width, height=args.maze_height) for _ in range(100)]
 
+    if args.fuzz is not None:
+        run_fuzzer(args, current_population, maze_test_set, target, env_config)
+        return
+
     generation_avg_scores: List[float] = []
     generation_avg_lengths: List[float] = []
 
@@ -250,31 +641,162 @@ def main() -> None:
             for score in scores:
                 csv_writer.writerow([generation, score])
 
+    run_log = None
+    if args.run_log:
+        try:
+            run_log = RunLogWriter(args.run_log, resume_generation=start_generation if args.resume else None)
+        except IOError as e:
+            ap.error(f"Could not open file for run logging: {e}")
+        except ValueError as e:
+            ap.error(f"Could not resume run log '{args.run_log}': {e}")
+
+    genome_archive = None
+    if args.genome_archive:
+        try:
+            genome_archive = GenomeArchive(args.genome_archive, resume=bool(args.resume))
+        except IOError as e:
+            ap.error(f"Could not open genome archive: {e}")
+        except ValueError as e:
+            ap.error(f"Could not resume genome archive '{args.genome_archive}': {e}")
+
+    metrics_server = None
+    if args.metrics_port is not None:
+        try:
+            metrics_server = MetricsServer(args.metrics_port)
+        except OSError as e:
+            ap.error(f"Could not serve metrics on port {args.metrics_port}: {e}")
+        print(f"--- Serving metrics at http://127.0.0.1:{metrics_server.port}/metrics ---")
+
+    def log_results(generation: int, scored_population: List[ScoredProgram], lineage: Optional[Any]):
+        if metrics_server:
+            metrics_server.publish_generation(generation, scored_population, ga.score_stats)
+        if run_log:
+            run_log.log_generation(generation, scored_population, lineage)
+        if genome_archive is not None:
+            genome_archive.log_generation(generation, scored_population, lineage)
+
+    telemetry = None
+    perf_counters = None
+    if args.perf_counters:
+        perf_counters = PerfCounters.open(inherit=True)
+        if perf_counters is None:
+            print(f"Warning: Hardware performance counters unavailable ({PerfCounters.last_error}), "
+                  "continuing without them", file=sys.stderr)
+    telemetry_sinks = [metrics_server] if metrics_server else []
+    if args.perf_counters and not args.telemetry:
+        telemetry_records = MemorySink()
+        telemetry_sinks.append(telemetry_records)
+    if args.telemetry:
+        try:
+            telemetry_sinks.append(JsonLinesSink(args.telemetry) if args.telemetry.endswith(".jsonl")
+                                   else RunLogSink(args.telemetry,
+                                                   resume_generation=start_generation if args.resume else None))
+        except IOError as e:
+            ap.error(f"Could not open telemetry file: {e}")
+        except ValueError as e:
+            ap.error(f"Could not resume telemetry log '{args.telemetry}': {e}")
+        telemetry_records = MemorySink()
+        telemetry_sinks.append(telemetry_records)
+    if telemetry_sinks:
+        workers = 1 if args.backend == "serial" else (args.processes or os.cpu_count() or 1)
+        telemetry = Telemetry(telemetry_sinks, workers=workers, perf_counters=perf_counters,
+                              perf_phase="native" if args.backend == "native" else "test")
+
+    diversity_log = DiversityLog() if args.diversity else None
+    def checkpoint_state() -> Dict[str, Any]:
+        """Selection state a checkpoint needs besides the population, read when it is taken."""
+        return {
+            "lineage": None if ga.lineage is None else ga.lineage.copy(),
+            "novelty": novelty.archive.descriptors() if novelty else None,
+            "front": ga.front_state() if args.nsga2 else None,
+        }
+
+    checkpointer = (checkpoint.Checkpointer(args.checkpoint, maze_test_set, args.checkpoint_every, checkpoint_state)
+                    if args.checkpoint else None)
+
     print("--- Running genetic algorithm ---")
     bar = RunnerProgress("Running... ", max=args.generations)
 
-    ga = GeneticAlgo(
+    def on_selection(stats: ScoreStats):
+        generation_avg_scores.append(stats.mean)
+        bar.perform_selection(stats)
+
+    ga = (NSGA2GeneticAlgo if args.nsga2 else GeneticAlgo)(
         mutation_rate=args.mutation_rate,
         crossover_rate=0.8,
-        test_func=test,
+        test_func=racing or novelty or test,
         hook_next_gen=bar.next_generation,
         hook_finished=bar.finish,
         hook_reproduction=bar.perform_reproduction,
-        hook_selection=bar.perform_selection,
+        hook_selection=on_selection,
         hook_log_scores=log_scores_to_csv,
+        hook_log_population=diversity_log or (lambda _, __: None),
+        hook_log_results=log_results,
+        hook_checkpoint=checkpointer or (lambda _, __, ___: None),
+        telemetry=telemetry,
     )
 
-    scored_population = ga.run(
-        current_population,
-        args.generations,
-        log=not args.no_live,
-        maze_test_set=maze_test_set,
-        endian=args.endian
-    )
+    if args.resume:
+        ga.lineage = resumed.lineage
+        if args.nsga2:
+            ga.restore_front(resumed.front)
+        if novelty:
+            novelty.restore(resumed.novelty)
+
+    map_elites = MapElites(ga, batch_size=args.count) if args.map_elites else None
+    profiler = Profiler() if args.profile else None
+    run = profiler.run if profiler else (lambda func, *a, **kw: func(*a, **kw))
+    if map_elites:
+        scored_population = run(
+            map_elites.run,
+            current_population,
+            args.generations,
+            log=not args.no_live,
+            maze_test_set=maze_test_set,
+            endian=args.endian,
+            backend=args.backend,
+            processes=args.processes
+        )
+    else:
+        scored_population = run(
+            ga.run,
+            current_population,
+            args.generations,
+            start_generation=start_generation,
+            log=not args.no_live,
+            maze_test_set=maze_test_set,
+            endian=args.endian,
+            backend=args.backend,
+            processes=args.processes,
+            task=args.task,
+            target=target,
+            max_mismatches=args.target_mismatches,
+            env_config=env_config
+        )
+
+    if profiler:
+        try:
+            paths = profiler.write(args.profile)
+            print(f"--- Wrote profile to {', '.join(paths)} ---")
+        except OSError as e:
+            print(f"Error writing profile: {e}", file=sys.stderr)
+
+    if checkpointer:
+        checkpointer.close()
+        if checkpointer.error:
+            print(f"Error writing checkpoint: {checkpointer.error}", file=sys.stderr)
 
     # Clean up CSV file handle
     if csv_file:
         csv_file.close()
+    if run_log:
+        run_log.close()
+    if telemetry:
+        telemetry.close()
+    if genome_archive is not None:
+        genome_archive.close()
+        print(f"--- Archived {len(genome_archive)} unique of {genome_archive.evaluated} evaluated genomes "
+              f"to {args.genome_archive} ---")
 
     if args.print_output:
         print("--- End of PUTC output ---")
@@ -283,25 +805,59 @@ def main() -> None:
     final_gen_results = [sp.result for sp in scored_population]
     final_gen_scores = [sp.score for sp in scored_population]
     totals = summarize(final_gen_results)
+    final_stats = ga.score_stats
+    generation_avg_scores.append(final_stats.mean)
 
-    if final_gen_scores:
-        total_score = sum(final_gen_scores)
-        quartiles = statistics.quantiles(final_gen_scores, n=4) if len(final_gen_scores) > 1 else [0,0,0]
+    if len(final_stats):
+        q1, median, q3 = final_stats.quantiles([0.25, 0.5, 0.75])
 
-        print(f"\nTotal Score: {total_score}")
+        print(f"\nTotal Score: {final_stats.sum:.0f}")
         print("=== Score Statistics (Final Generation) ===")
-        print(f"Min Score    : {min(final_gen_scores)}")
-        print(f"Max Score    : {max(final_gen_scores)}")
-        print(f"Average Score: {statistics.mean(final_gen_scores):.2f}")
-        print(f"Median Score : {statistics.median(final_gen_scores)}")
-        print(f"Range        : {max(final_gen_scores) - min(final_gen_scores)}")
-        print(f"Quartiles (Q1, Q2, Q3): {quartiles[0]}, {quartiles[1]}, {quartiles[2]}")
+        print(f"Min Score    : {final_stats.min:.0f}")
+        print(f"Max Score    : {final_stats.max:.0f}")
+        print(f"Average Score: {final_stats.mean:.2f}")
+        print(f"Std Deviation: {final_stats.stddev:.2f}")
+        print(f"Median Score : {median:.0f}")
+        print(f"Range        : {final_stats.max - final_stats.min:.0f}")
+        print(f"Quartiles (Q1, Q2, Q3): {q1:.0f}, {median:.0f}, {q3:.0f}")
+
+    if args.task == "putc" and scored_population:
+        best = max(scored_population, key=lambda sp: sp.score)
+        print(f"\nTarget       : {target!r}")
+        output = "not captured by the native backend" if best.result.output is None else repr(best.result.output)
+        print(f"Best output  : {output} (score {best.score})")
 
     if generation_avg_scores:
         print("\n=== Average Score per Generation ===")
         for i, avg_score in enumerate(generation_avg_scores, 1):
             print(f"Generation {i:2d}: {avg_score:.2f}")
 
+    if map_elites:
+        archive = map_elites.archive
+        _, elite_scores, _ = archive.elites()
+        print("\n=== MAP-Elites Archive ===")
+        print(f"Occupied cells: {len(archive)} / {archive.cells} ({100.0 * len(archive) / archive.cells:.2f}%)")
+        if len(elite_scores):
+            print(f"Best elite    : {elite_scores.max():.0f}")
+            print(f"QD score      : {elite_scores.sum():.0f}")
+
+    if diversity_log:
+        print("\n=== Diversity per Generation (mean Hamming bits / unique / bit entropy) ===")
+        for i, d in enumerate(diversity_log.history, 1):
+            print(f"Generation {i:2d}: {d.mean_distance:8.2f} / {d.unique_genomes:6d} / {d.mean_bit_entropy:.3f}")
+
+    if (args.telemetry or args.perf_counters) and telemetry_records.records:
+        print("\n=== Phase Timing per Generation (wall s: test / select / reproduce, evals/s, worker use) ===")
+        for r in telemetry_records.records:
+            utilization = "n/a" if r.worker_utilization is None else f"{100.0 * r.worker_utilization:.0f}%"
+            hardware = ""
+            if r.ipc is not None or r.branch_miss_rate is not None:
+                ipc = "n/a" if r.ipc is None else f"{r.ipc:.2f}"
+                misses = "n/a" if r.branch_miss_rate is None else f"{100.0 * r.branch_miss_rate:.2f}%"
+                hardware = f"  IPC {ipc}, branch misses {misses}"
+            print(f"Generation {r.generation + 1:2d}: {r.wall.get('test', 0.0):7.3f} / {r.wall.get('select', 0.0):7.3f} / "
+                  f"{r.wall.get('reproduce', 0.0):7.3f}  {r.evaluations_per_second:9.1f}  {utilization}{hardware}")
+
     if generation_avg_lengths:
         print("\n=== Average Program Length (bytes) per Generation ===")
         for i, avg_length in enumerate(generation_avg_lengths, 1):
@@ -330,9 +886,15 @@ def main() -> None:
         elif generation_avg_scores and final_gen_scores:
             plot_results(args.generations, final_gen_scores, generation_avg_scores)
 
+    if SYSCALL_PROFILE is not None:
+        print("\n=== Syscall Latency Profile (ns) ===")
+        SYSCALL_PROFILE.dump()
+
     print("=== Run Summary ===")
     for k, v in totals.items():
         print(f"{k:14s}: {v}")
+    if racing:
+        print(racing.summary())
 
 
 if __name__ == "__main__":
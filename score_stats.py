@@ -0,0 +1,141 @@
+"""
+score_stats.py
+
+Streaming score statistics backed by vm_core.
+
+A ScoreStats accumulates count, sum, mean, variance, min and max exactly and
+quantiles approximately (KLL sketch), one score at a time, so an evaluator can
+update it as results arrive and nobody needs to keep or re-scan the list of
+scores afterwards.
+"""
+from __future__ import annotations
+
+import ctypes
+import math
+from typing import Iterable, List, Sequence
+
+import numpy as np
+
+from misc import vm_core
+
+_dp = ctypes.POINTER(ctypes.c_double)
+
+
+class ScoreSummary(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_uint64),
+        ("mean", ctypes.c_double),
+        ("variance", ctypes.c_double),
+        ("min", ctypes.c_double),
+        ("max", ctypes.c_double),
+        ("sum", ctypes.c_double),
+    ]
+
+
+vm_core.score_stats_new.argtypes = [ctypes.c_int, ctypes.c_uint64]
+vm_core.score_stats_new.restype = ctypes.c_void_p
+
+vm_core.score_stats_free.argtypes = [ctypes.c_void_p]
+vm_core.score_stats_free.restype = None
+
+vm_core.score_stats_reset.argtypes = [ctypes.c_void_p]
+vm_core.score_stats_reset.restype = None
+
+vm_core.score_stats_add.argtypes = [ctypes.c_void_p, ctypes.c_double]
+vm_core.score_stats_add.restype = ctypes.c_int
+
+vm_core.score_stats_add_many.argtypes = [ctypes.c_void_p, _dp, ctypes.c_int]
+vm_core.score_stats_add_many.restype = ctypes.c_int
+
+vm_core.score_stats_merge.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+vm_core.score_stats_merge.restype = ctypes.c_int
+
+vm_core.score_stats_summary.argtypes = [ctypes.c_void_p, ctypes.POINTER(ScoreSummary)]
+vm_core.score_stats_summary.restype = None
+
+vm_core.score_stats_quantiles.argtypes = [ctypes.c_void_p, _dp, ctypes.c_int, _dp]
+vm_core.score_stats_quantiles.restype = ctypes.c_int
+
+DEFAULT_K = 200
+
+
+class ScoreStats:
+    """Streaming count/sum/mean/variance/min/max and approximate quantiles."""
+
+    def __init__(self, k: int = DEFAULT_K, seed: int = 0):
+        self.k = k
+        self._handle = vm_core.score_stats_new(k, seed)
+        if not self._handle:
+            raise ValueError("Invalid sketch size k")
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.score_stats_free(self._handle)
+            self._handle = None
+
+    def add(self, value: float) -> None:
+        if vm_core.score_stats_add(self._handle, value) != 0:
+            raise ValueError(f"Cannot add {value!r} to score statistics")
+
+    def add_many(self, values: Iterable[float]) -> None:
+        values = np.ascontiguousarray(list(values) if not isinstance(values, np.ndarray) else values,
+                                      dtype=np.float64)
+        if vm_core.score_stats_add_many(self._handle, values.ctypes.data_as(_dp), len(values)) != 0:
+            raise ValueError("Cannot add NaN to score statistics")
+
+    def merge(self, other: ScoreStats) -> None:
+        if vm_core.score_stats_merge(self._handle, other._handle) != 0:
+            raise ValueError("Can only merge score statistics with the same k")
+
+    def reset(self) -> None:
+        vm_core.score_stats_reset(self._handle)
+
+    def summary(self) -> ScoreSummary:
+        out = ScoreSummary()
+        vm_core.score_stats_summary(self._handle, ctypes.byref(out))
+        return out
+
+    def quantiles(self, qs: Sequence[float]) -> List[float]:
+        """Approximate quantiles, each q in [0, 1]. Empty statistics give zeros."""
+        if len(self) == 0:
+            return [0.0] * len(qs)
+        qs_arr = np.ascontiguousarray(qs, dtype=np.float64)
+        out = np.zeros(len(qs_arr), dtype=np.float64)
+        if vm_core.score_stats_quantiles(self._handle, qs_arr.ctypes.data_as(_dp), len(qs_arr),
+                                         out.ctypes.data_as(_dp)) != 0:
+            raise ValueError("Quantiles must be in [0, 1]")
+        return out.tolist()
+
+    def quantile(self, q: float) -> float:
+        return self.quantiles([q])[0]
+
+    def __len__(self) -> int:
+        return self.summary().count
+
+    @property
+    def sum(self) -> float:
+        return self.summary().sum
+
+    @property
+    def mean(self) -> float:
+        return self.summary().mean
+
+    @property
+    def variance(self) -> float:
+        return self.summary().variance
+
+    @property
+    def stddev(self) -> float:
+        return math.sqrt(self.variance)
+
+    @property
+    def min(self) -> float:
+        return self.summary().min
+
+    @property
+    def max(self) -> float:
+        return self.summary().max
+
+    @property
+    def median(self) -> float:
+        return self.quantile(0.5)
@@ -1,6 +1,8 @@
 from __future__ import annotations
 from dataclasses import dataclass
-from typing import TYPE_CHECKING
+from typing import TYPE_CHECKING, Optional, Tuple
+
+from misc import CONSTANTS
 
 if TYPE_CHECKING:
     from misc import VMResult
@@ -10,27 +12,29 @@ class ScoredProgram:
     score: int
     program_bytes: bytes
     result: VMResult
+    descriptor: Optional[Tuple[float, ...]] = None  # Behaviour descriptor, when requested
+    index: int = -1  # Position in the tested population (results may arrive out of order)
 
 
 def grade_performance(result: VMResult) -> int:
-    """V
+    """
     Assigns a performance score to a single VM run result.
 
     - Base score is 0.
-    - Graceful exit: +100 points.
-    - Each character printed via syscall: +100 points.
-    - Runtime error: -100 points.
+    - Graceful exit: +10 points.
+    - Each character printed via PUTC (run with a VMContext): +100 points.
+    - Runtime limit exceeded: -100 points.
     - Other errors: -200 points.
     - PC ran off end: 0 points.
     """
     score = 0
-    if result.outcome == "graceful":
+    if not result.halted:
         score += 10
-    elif result.outcome == "runtime_error":
+    elif result.rt.interrupt == CONSTANTS['INTERRUPT_MAX_STEPS']:
         score -= 100
-    elif result.outcome == "other_error":
+    elif result.rt.interrupt != CONSTANTS['INTERRUPT_ILLEGAL_PC']:
         score -= 200
 
-    score += (result.output_len or 0) * 100
+    score += len(result.output or b"") * 100
 
-    return score
\ No newline at end of file
+    return score
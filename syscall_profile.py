@@ -0,0 +1,161 @@
+"""
+syscall_profile.py
+
+Per-syscall call counts and latency histograms backed by vm_core.
+
+A MiscVM given a SyscallProfile records, for every syscall ID:
+  roundtrip  from run_c returning for the syscall until run_c resumes: the
+             ctypes boundary both ways, the dispatch and the handler,
+  handler    the Python handler alone,
+so roundtrip - handler is the cost of crossing into Python. Handlers written in
+C record under `native`. The dump ranks syscalls by the time spent in them.
+"""
+from __future__ import annotations
+
+import ctypes
+import sys
+from typing import Dict, List, Optional, Sequence, TextIO
+
+from misc import vm_core
+
+ROUNDTRIP, HANDLER, NATIVE = 0, 1, 2
+KINDS = {"roundtrip": ROUNDTRIP, "handler": HANDLER, "native": NATIVE}
+IDS = 256
+SUB_BITS = 3
+BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS
+DUMP_QUANTILES = (0.5, 0.9, 0.99)
+
+_dp = ctypes.POINTER(ctypes.c_double)
+_u64p = ctypes.POINTER(ctypes.c_uint64)
+
+
+class SyscallLatency(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_uint64),
+        ("total_ns", ctypes.c_uint64),
+        ("min_ns", ctypes.c_uint64),
+        ("max_ns", ctypes.c_uint64),
+    ]
+
+
+vm_core.syscall_profile_new.argtypes = []
+vm_core.syscall_profile_new.restype = ctypes.c_void_p
+
+vm_core.syscall_profile_free.argtypes = [ctypes.c_void_p]
+vm_core.syscall_profile_free.restype = None
+
+vm_core.syscall_profile_reset.argtypes = [ctypes.c_void_p]
+vm_core.syscall_profile_reset.restype = None
+
+vm_core.syscall_profile_record.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_uint64]
+vm_core.syscall_profile_record.restype = ctypes.c_int
+
+vm_core.syscall_profile_activate.argtypes = [ctypes.c_void_p]
+vm_core.syscall_profile_activate.restype = None
+
+vm_core.syscall_profile_stats.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.POINTER(SyscallLatency)]
+vm_core.syscall_profile_stats.restype = ctypes.c_int
+
+vm_core.syscall_profile_histogram.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, _u64p]
+vm_core.syscall_profile_histogram.restype = ctypes.c_int
+
+vm_core.syscall_profile_bucket_range.argtypes = [ctypes.c_int, _u64p, _u64p]
+vm_core.syscall_profile_bucket_range.restype = None
+
+vm_core.syscall_profile_quantiles.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, _dp, ctypes.c_int, _dp]
+vm_core.syscall_profile_quantiles.restype = ctypes.c_int
+
+
+def bucket_range(index: int) -> tuple:
+    """Inclusive [low, high] nanoseconds of histogram bucket `index`."""
+    low, high = ctypes.c_uint64(), ctypes.c_uint64()
+    vm_core.syscall_profile_bucket_range(index, ctypes.byref(low), ctypes.byref(high))
+    return low.value, high.value
+
+
+def syscall_names() -> Dict[int, str]:
+    """Class names of the registered syscalls, by ID."""
+    from syscalls import get_syscall_classes
+    return {cls.SYSCALL_ID: cls.__name__.removesuffix("Syscall") for cls in get_syscall_classes()}
+
+
+class SyscallProfile:
+    """Thread-safe latency histograms per syscall ID."""
+
+    def __init__(self):
+        self._handle = vm_core.syscall_profile_new()
+        if not self._handle:
+            raise MemoryError("Could not allocate syscall profile")
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            vm_core.syscall_profile_free(self._handle)
+            self._handle = None
+
+    def activate(self) -> None:
+        """Records run_c roundtrips of the calling thread into this profile."""
+        vm_core.syscall_profile_activate(self._handle)
+
+    @staticmethod
+    def deactivate() -> None:
+        vm_core.syscall_profile_activate(None)
+
+    def record(self, kind: int, syscall_id: int, ns: int) -> None:
+        vm_core.syscall_profile_record(self._handle, kind, syscall_id, ns)
+
+    def record_handler(self, syscall_id: int, ns: int) -> None:
+        vm_core.syscall_profile_record(self._handle, HANDLER, syscall_id, ns)
+
+    def reset(self) -> None:
+        vm_core.syscall_profile_reset(self._handle)
+
+    def stats(self, kind: int, syscall_id: int) -> SyscallLatency:
+        out = SyscallLatency()
+        vm_core.syscall_profile_stats(self._handle, kind, syscall_id, ctypes.byref(out))
+        return out
+
+    def histogram(self, kind: int, syscall_id: int) -> List[int]:
+        """Call counts per bucket, see bucket_range."""
+        out = (ctypes.c_uint64 * BUCKETS)()
+        vm_core.syscall_profile_histogram(self._handle, kind, syscall_id, out)
+        return list(out)
+
+    def quantiles(self, kind: int, syscall_id: int, qs: Sequence[float]) -> Optional[List[float]]:
+        """Latency quantiles in nanoseconds, or None without calls."""
+        q = (ctypes.c_double * len(qs))(*qs)
+        out = (ctypes.c_double * len(qs))()
+        if vm_core.syscall_profile_quantiles(self._handle, kind, syscall_id, q, len(qs), out) != 0:
+            return None
+        return list(out)
+
+    def syscall_ids(self) -> List[int]:
+        """IDs with at least one recorded call of any kind."""
+        return [i for i in range(IDS) if any(self.stats(kind, i).count for kind in KINDS.values())]
+
+    def dump(self, file: TextIO = sys.stdout, names: Optional[Dict[int, str]] = None) -> None:
+        """Table of every profiled syscall, most total time first."""
+        names = syscall_names() if names is None else names
+        rows = []
+        for syscall_id in self.syscall_ids():
+            per_kind = {name: self.stats(kind, syscall_id) for name, kind in KINDS.items()}
+            total = max(s.total_ns for s in per_kind.values())
+            rows.append((total, syscall_id, per_kind))
+        rows.sort(reverse=True)
+
+        print(f"{'syscall':>18s} {'kind':9s} {'calls':>10s} {'total ms':>10s} {'mean ns':>9s} "
+              f"{'p50':>8s} {'p90':>8s} {'p99':>8s} {'max':>9s}", file=file)
+        for _, syscall_id, per_kind in rows:
+            label = f"{names.get(syscall_id, '?')} 0x{syscall_id:02X}"
+            for name, kind in KINDS.items():
+                s = per_kind[name]
+                if not s.count:
+                    continue
+                p50, p90, p99 = self.quantiles(kind, syscall_id, DUMP_QUANTILES)
+                print(f"{label:>18s} {name:9s} {s.count:10d} {s.total_ns / 1e6:10.3f} {s.total_ns / s.count:9.0f} "
+                      f"{p50:8.0f} {p90:8.0f} {p99:8.0f} {s.max_ns:9d}", file=file)
+                label = ""
+            roundtrip, handler = per_kind["roundtrip"], per_kind["handler"]
+            if roundtrip.count and handler.count:
+                overhead = roundtrip.total_ns / roundtrip.count - handler.total_ns / handler.count
+                print(f"{'':>18s} {'boundary':9s} {'':>10s} {'':>10s} {overhead:9.0f}  (mean roundtrip - handler)",
+                      file=file)
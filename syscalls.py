@@ -1,30 +1,38 @@
 from __future__ import annotations
 import sys
 from abc import ABC, abstractmethod
-from typing import TYPE_CHECKING, List, Dict, Type, Callable, TextIO
-from misc import MiscVM
+from typing import TYPE_CHECKING, List, Dict, Type, Callable, TextIO, Optional
+from misc import MiscVM, SYSTABLE_SIZE
 
 if TYPE_CHECKING :
+    from maze_game import Maze
     from misc import VMState as Runtime
 
 class OutputStream:
-    """A file-like object that captures written characters and can optionally echo to stdout."""
+    """
+    A file-like object that captures written characters in a byte buffer and can
+    optionally echo them to stdout. Echoed output is batched: it goes out on
+    `flush` (or when Python flushes stdout), not once per character.
+    """
     def __init__(self, echo: bool = False):
-        self.buffer: List[str] = []
+        self.buffer = bytearray()
         self.echo = echo
 
     def write(self, s: int) -> int:
-        self.buffer.append(s)
+        self.buffer.append(s & 0xFF)
         if self.echo:
-            sys.stdout.write(chr(s))
-            sys.stdout.flush()
+            sys.stdout.write(chr(s & 0xFF))
         return 1
 
+    def flush(self) -> None:
+        if self.echo:
+            sys.stdout.flush()
+
     def clear(self) -> None:
         self.buffer.clear()
 
     def get_output(self) -> str:
-        return "".join(self.buffer)
+        return self.buffer.decode("latin-1")
 
 # --- Syscall Framework ---
 
@@ -48,6 +56,13 @@ class Syscall(ABC):
         """The main logic of the syscall, operating on the VM's stack."""
         pass
 
+    def bind(self, *, maze: Optional[Maze] = None, stream: Optional[TextIO] = None) -> None:
+        """
+        Points an existing instance at a new maze or stream, whichever is given.
+        Overridden by syscalls that hold either; it only reassigns them and must
+        not redo any other constructor work.
+        """
+
 
 def get_syscall_classes() -> List[Type[Syscall]]:
     """Returns a list of all registered syscall classes."""
@@ -60,6 +75,25 @@ def build_systable(**kwargs) -> Dict[int, Callable[[List[int]], None]]:
     return {instance.SYSCALL_ID: instance.execute for instance in syscall_instances}
 
 
+class SyscallTable:
+    """
+    Every registered syscall, instantiated once, in a fixed SYSTABLE_SIZE-slot
+    list indexed by syscall ID (None for unknown IDs) that MiscVM dispatches on
+    directly. Build one per worker and `bind` it to each run's maze and stream.
+    `classes` limits the table to those syscalls, e.g. for a task without a maze.
+    """
+    def __init__(self, classes: Optional[List[Type[Syscall]]] = None, **kwargs):
+        self.syscalls = [cls(**kwargs) for cls in (get_syscall_classes() if classes is None else classes)]
+        self.slots: List[Optional[Callable[[Runtime], None]]] = [None] * SYSTABLE_SIZE
+        for instance in self.syscalls:
+            self.slots[instance.SYSCALL_ID] = instance.execute
+
+    def bind(self, *, maze: Optional[Maze] = None, stream: Optional[TextIO] = None) -> None:
+        """Rebinds every syscall to a run's maze and stream, e.g. bind(stream=stream, maze=maze)."""
+        for instance in self.syscalls:
+            instance.bind(maze=maze, stream=stream)
+
+
 # --- Concrete Syscall Implementations ---
 
 class ExitSyscall(Syscall):
@@ -86,6 +120,10 @@ class PutcSyscall(Syscall):
     def __init__(self, stream: TextIO, **_kwargs):
         self.stream = stream
 
+    def bind(self, *, stream: Optional[TextIO] = None, **_kwargs) -> None:
+        if stream is not None:
+            self.stream = stream
+
     def execute(self, rt: Runtime) -> Runtime:
         char_code = rt.registers[0]
         self.stream.write(char_code)
@@ -0,0 +1,232 @@
+"""
+telemetry.py
+
+Per-generation timing and throughput telemetry for GeneticAlgo.
+
+For every generation GeneticAlgo times its test, select and reproduce phases
+(wall clock and CPU). CPU time includes the pool workers: threads are covered
+by the process' own CPU time and worker processes by the children's rusage,
+which the OS adds when the per-generation pool exits. From those it derives
+evaluations per second and worker utilization. With hardware performance
+counters (perf_counters.py), the test phase (or, with the native backend, just
+its vm_env_evaluate batch, the "native" phase) is also measured in cycles,
+instructions, branches and misses, giving IPC and branch-miss rate. Test functions may report
+extra counters (e.g. ``maze_runs``, or ``cache_hits`` / ``cache_lookups``)
+through the ``telemetry`` keyword argument they are given.
+
+Records go to one or more sinks: in memory, JSON lines, or a binary run log
+with one row per generation (see runlog.py).
+"""
+from __future__ import annotations
+
+import json
+import resource
+import time
+from dataclasses import asdict, dataclass, field
+from typing import TYPE_CHECKING, Dict, List, Optional, Sequence, TextIO
+
+import numpy as np
+
+from runlog import RunLogWriter
+
+if TYPE_CHECKING:
+    from perf_counters import PerfCounters
+
+PHASES = ("test", "select", "reproduce")
+
+
+@dataclass
+class GenerationTelemetry:
+    generation: int
+    population: int
+    wall: Dict[str, float] = field(default_factory=dict)  # Seconds per phase
+    cpu: Dict[str, float] = field(default_factory=dict)   # CPU seconds per phase, workers included
+    evaluations: int = 0                        # Genomes tested
+    evaluations_per_second: float = 0.0
+    worker_utilization: Optional[float] = None  # Test CPU time / (test wall time x workers)
+    cache_hit_rate: Optional[float] = None      # Only when the test function reports cache lookups
+    counters: Dict[str, int] = field(default_factory=dict)
+    hardware: Optional[Dict[str, Optional[int]]] = None  # Perf events of Telemetry.perf_phase
+    ipc: Optional[float] = None
+    branch_miss_rate: Optional[float] = None
+
+
+def _cpu_seconds() -> float:
+    children = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return time.process_time() + children.ru_utime + children.ru_stime
+
+
+class _Phase:
+    __slots__ = ("telemetry", "name", "perf", "wall", "cpu")
+
+    def __init__(self, telemetry: Telemetry, name: str, perf: Optional[PerfCounters]):
+        self.telemetry = telemetry
+        self.name = name
+        self.perf = perf
+
+    def __enter__(self) -> None:
+        if self.perf is not None:
+            self.perf.start()
+        self.wall = time.perf_counter()
+        self.cpu = _cpu_seconds()
+
+    def __exit__(self, *_) -> None:
+        wall = time.perf_counter() - self.wall
+        cpu = _cpu_seconds() - self.cpu
+        sample = self.perf.stop() if self.perf is not None else None
+        record = self.telemetry.current
+        if record is not None:
+            record.wall[self.name] = record.wall.get(self.name, 0.0) + wall
+            record.cpu[self.name] = record.cpu.get(self.name, 0.0) + cpu
+            if sample is not None:
+                record.hardware = asdict(sample)
+                record.ipc = sample.ipc
+                record.branch_miss_rate = sample.branch_miss_rate
+
+
+class Sink:
+    def write(self, record: GenerationTelemetry) -> None:
+        raise NotImplementedError
+
+    def close(self) -> None:
+        pass
+
+
+class MemorySink(Sink):
+    """Keeps every record in `records`."""
+
+    def __init__(self):
+        self.records: List[GenerationTelemetry] = []
+
+    def write(self, record: GenerationTelemetry) -> None:
+        self.records.append(record)
+
+
+class JsonLinesSink(Sink):
+    """One JSON object per generation."""
+
+    def __init__(self, path: str):
+        self._file: TextIO = open(path, "w", encoding="utf-8")
+
+    def write(self, record: GenerationTelemetry) -> None:
+        self._file.write(json.dumps(asdict(record)) + "\n")
+        self._file.flush()
+
+    def close(self) -> None:
+        self._file.close()
+
+
+# One row per generation; a missing value (e.g. no cache) is NaN
+TELEMETRY_COLUMNS = (
+    ("generation", "<u4"),
+    ("population", "<u4"),
+    *((f"{phase}_wall", "<f8") for phase in PHASES),
+    *((f"{phase}_cpu", "<f8") for phase in PHASES),
+    ("evaluations", "<u8"),
+    ("evals_per_sec", "<f8"),
+    ("worker_util", "<f8"),
+    ("cache_hit_rate", "<f8"),
+    ("ipc", "<f8"),
+    ("branch_miss_rate", "<f8"),
+)
+
+
+class RunLogSink(Sink):
+    """Binary columnar log with TELEMETRY_COLUMNS, readable with runlog.RunLogReader."""
+
+    def __init__(self, path: str, resume_generation: Optional[int] = None):
+        self._writer = RunLogWriter(path, chunk_rows=256, columns=TELEMETRY_COLUMNS,
+                                    resume_generation=resume_generation)
+
+    def write(self, record: GenerationTelemetry) -> None:
+        nan = float("nan")
+        values = {
+            "population": [record.population],
+            "evaluations": [record.evaluations],
+            "evals_per_sec": [record.evaluations_per_second],
+            "worker_util": [nan if record.worker_utilization is None else record.worker_utilization],
+            "cache_hit_rate": [nan if record.cache_hit_rate is None else record.cache_hit_rate],
+            "ipc": [nan if record.ipc is None else record.ipc],
+            "branch_miss_rate": [nan if record.branch_miss_rate is None else record.branch_miss_rate],
+        }
+        for phase in PHASES:
+            values[f"{phase}_wall"] = [record.wall.get(phase, nan)]
+            values[f"{phase}_cpu"] = [record.cpu.get(phase, nan)]
+        self._writer.append(record.generation, **{k: np.asarray(v) for k, v in values.items()})
+
+    def close(self) -> None:
+        self._writer.close()
+
+
+class Telemetry:
+    """
+    Collects one GenerationTelemetry per generation and hands it to the sinks.
+    `workers` is the evaluation pool size, used for worker utilization.
+    `perf_counters` (see perf_counters.PerfCounters.open) are read around the
+    `perf_phase` phase, "test" or the native backend's "native".
+    """
+
+    def __init__(self, sinks: Sequence[Sink] = (), workers: int = 1,
+                 perf_counters: Optional[PerfCounters] = None, perf_phase: str = "test"):
+        self.sinks = list(sinks)
+        self.workers = max(1, workers)
+        self.perf_counters = perf_counters
+        self.perf_phase = perf_phase
+        self.current: Optional[GenerationTelemetry] = None
+
+    def phase(self, name: str) -> _Phase:
+        return _Phase(self, name, self.perf_counters if name == self.perf_phase else None)
+
+    def count(self, name: str, value: int = 1) -> None:
+        """Adds to a counter of the current generation (for test functions)."""
+        if self.current is not None:
+            self.current.counters[name] = self.current.counters.get(name, 0) + value
+
+    def begin_generation(self, generation: int, population: int) -> None:
+        self.current = GenerationTelemetry(generation, population)
+
+    def end_generation(self, evaluations: int) -> None:
+        record = self.current
+        if record is None:
+            return
+        self.current = None
+        record.evaluations = evaluations
+        test_wall = record.wall.get("test", 0.0)
+        if test_wall > 0:
+            record.evaluations_per_second = record.evaluations / test_wall
+            record.worker_utilization = record.cpu.get("test", 0.0) / (test_wall * self.workers)
+        lookups = record.counters.get("cache_lookups", 0)
+        if lookups:
+            record.cache_hit_rate = record.counters.get("cache_hits", 0) / lookups
+        for sink in self.sinks:
+            sink.write(record)
+
+    def close(self) -> None:
+        for sink in self.sinks:
+            sink.close()
+        if self.perf_counters is not None:
+            self.perf_counters.close()
+
+
+class NullTelemetry(Telemetry):
+    """Telemetry that records nothing, used when none is configured."""
+
+    class _NullPhase:
+        __slots__ = ()
+
+        def __enter__(self) -> None:
+            pass
+
+        def __exit__(self, *_) -> None:
+            pass
+
+    _NULL_PHASE = _NullPhase()
+
+    def phase(self, name: str) -> _NullPhase:
+        return self._NULL_PHASE
+
+    def begin_generation(self, generation: int, population: int) -> None:
+        pass
+
+    def end_generation(self, evaluations: int) -> None:
+        pass
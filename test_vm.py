@@ -1,5 +1,12 @@
+import bisect
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
 import unittest
-from misc import MiscVM, Systable
+from misc import MiscVM, Systable, VMContext
 from asm import assemble
 
 class TestVM(unittest.TestCase):
@@ -123,5 +130,586 @@ class TestVM(unittest.TestCase):
         self.assertIn("Register is protected", str(result.error))
 
 
+class TestScorerParity(unittest.TestCase):
+    """The native environments (vm_env_evaluate) score exactly like the Python scorers."""
+
+    def _population(self, count: int = 300):
+        rng = random.Random(1)
+        programs = [bytes(rng.getrandbits(8) for _ in range(2 * rng.randint(1, 32))) for _ in range(count)]
+        # Walkers and printers, so that every scoring term is exercised
+        for _ in range(count // 4):
+            lines = [f"MOV_REG_IMM r0, {rng.choice(b'hello world')}\nSYSCALL 1" if rng.random() < 0.3
+                     else f"SYSCALL {rng.randrange(0x10, 0x16)}" for _ in range(rng.randint(1, 40))]
+            programs.append(assemble("\n".join(lines)))
+        with open("hello.asm") as f:
+            programs.append(assemble(f.read()))
+        with open("BEST.asm") as f:
+            programs.append(bytes.fromhex(f.read().strip()))
+        return programs
+
+    def _compare(self, **kwargs):
+        import runner
+        population = self._population()
+        results = {}
+        for backend in ("serial", "native"):
+            random.seed(4)  # Same maze choice on both backends
+            results[backend] = runner.test(population, endian="big", log=False, backend=backend, processes=2,
+                                           **kwargs)
+        for serial, native in zip(results["serial"], results["native"]):
+            self.assertEqual((serial.score, serial.result.steps, serial.result.halted),
+                             (native.score, native.result.steps, native.result.halted),
+                             f"Program {serial.program_bytes.hex()} scored differently")
+
+    def test_maze(self):
+        from maze_game import Maze
+        random.seed(3)
+        self._compare(maze_test_set=[Maze(width=8, height=8) for _ in range(5)], task="maze")
+
+    def test_new_maze_set(self):
+        # Refilling the list keeps its id(), as a new list may reuse a freed one's; the
+        # native tasks of the old mazes must not be reused
+        from maze_game import Maze
+        mazes = []
+        for seed in range(4):
+            random.seed(seed)
+            mazes[:] = [Maze(width=8, height=8) for _ in range(3)]
+            self._compare(maze_test_set=mazes, task="maze")
+
+    def test_putc(self):
+        for max_mismatches in (0, 3):
+            self._compare(maze_test_set=[], task="putc", target=b"hello world\n", max_mismatches=max_mismatches)
+
+
+class TestVMContext(unittest.TestCase):
+    """PUTC into the native output buffer of a VMContext (run_ctx)."""
+
+    def setUp(self):
+        from syscalls import ExitSyscall, OutputStream, PutcSyscall, SyscallTable
+        self.systable = SyscallTable(classes=[ExitSyscall, PutcSyscall], stream=OutputStream(), maze=None).slots
+        with open("hello.asm") as f:
+            self.hello = assemble(f.read())
+
+    def _run(self, context: VMContext):
+        return MiscVM(systable=self.systable, context=context).run(self.hello, max_steps=500)
+
+    def test_output_buffered(self):
+        context = VMContext(64)
+        result = self._run(context)
+        self.assertIsNone(result.error)
+        self.assertEqual(result.exit_code, 0)
+        self.assertEqual(result.output, b"hello world\n")
+        self.assertEqual(result.syscalls, 13)  # 12 PUTC and the EXIT
+
+    def test_reset_between_runs(self):
+        context = VMContext(64)
+        vm = MiscVM(systable=self.systable, context=context)
+        for _ in range(2):
+            self.assertEqual(vm.run(self.hello, max_steps=500).output, b"hello world\n")
+        self.assertEqual(context.total, 12)
+
+    def test_overflow_policies(self):
+        result = self._run(VMContext(5, "truncate"))
+        self.assertIsNone(result.error)
+        self.assertEqual(result.output, b"hello")
+        self.assertEqual(self._run(VMContext(5, "ring")).output, b"orld\n")
+        result = self._run(VMContext(5, "stop"))
+        self.assertIn("Output buffer full", str(result.error))
+        self.assertEqual(result.output, b"hello")
+        with self.assertRaises(ValueError):
+            VMContext(5, "drop")
+
+    def test_target_matching(self):
+        context = VMContext(64)
+        context.set_target(b"hello there")
+        result = self._run(context)
+        self.assertIn("Output diverged from target", str(result.error))
+        self.assertEqual(result.output, b"hello ")
+        self.assertEqual((result.output_match.prefix, result.output_match.mismatches), (6, 1))
+        context.set_target(b"hello there", 20)
+        result = self._run(context)
+        self.assertIsNone(result.error)
+        match = result.output_match
+        self.assertEqual((match.prefix, match.matched, match.mismatches), (6, 6, 6))
+        context.set_target(None)
+        self.assertIsNone(self._run(context).output_match)
+
+    def test_flush(self):
+        context = VMContext(64)
+        self._run(context)
+        read_fd, write_fd = os.pipe()
+        try:
+            self.assertEqual(context.flush(write_fd), 12)
+            self.assertEqual(os.read(read_fd, 64), b"hello world\n")
+        finally:
+            os.close(read_fd)
+            os.close(write_fd)
+        self.assertEqual(context.output(), b"")
+
+
+class TestScoreStats(unittest.TestCase):
+    """Exact moments and the KLL quantile sketch of score_stats.ScoreStats."""
+
+    def test_exact_moments(self):
+        import statistics
+        from score_stats import ScoreStats
+        rng = random.Random(2)
+        values = [rng.randint(-10**6, 10**6) for _ in range(5000)]
+        stats = ScoreStats()
+        stats.add_many(values)
+        self.assertEqual(len(stats), len(values))
+        self.assertEqual(stats.sum, sum(values))
+        self.assertEqual((stats.min, stats.max), (min(values), max(values)))
+        self.assertAlmostEqual(stats.mean, statistics.fmean(values), places=6)
+        self.assertAlmostEqual(stats.variance / statistics.pvariance(values), 1.0, places=9)
+
+    def test_small_input_exact(self):
+        from score_stats import ScoreStats
+        stats = ScoreStats(k=64)
+        stats.add_many([5, 1, 4, 2, 3])
+        self.assertEqual(stats.quantiles([0.0, 0.5, 1.0]), [1.0, 3.0, 5.0])
+
+    def test_quantile_rank_error(self):
+        from score_stats import ScoreStats
+        rng = random.Random(3)
+        values = [rng.random() for _ in range(200000)]
+        stats = ScoreStats(k=200, seed=1)
+        for v in values:
+            stats.add(v)
+        ordered = sorted(values)
+        qs = [0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99]
+        for q, estimate in zip(qs, stats.quantiles(qs)):
+            rank = bisect.bisect_right(ordered, estimate) / len(values)
+            self.assertLess(abs(rank - q), 2 * 1.7 / 200, f"q={q}")
+
+    def test_merge(self):
+        from score_stats import ScoreStats
+        rng = random.Random(4)
+        values = [rng.gauss(0, 100) for _ in range(30000)]
+        whole, left, right = ScoreStats(seed=1), ScoreStats(seed=2), ScoreStats(seed=3)
+        whole.add_many(values)
+        left.add_many(values[:10000])
+        right.add_many(values[10000:])
+        left.merge(right)
+        self.assertEqual(len(left), len(whole))
+        self.assertAlmostEqual(left.mean, whole.mean, places=9)
+        self.assertAlmostEqual(left.variance, whole.variance, places=6)
+        self.assertAlmostEqual(left.sum, whole.sum, places=6)
+        self.assertAlmostEqual(left.median, whole.median, delta=0.05 * whole.stddev)
+        with self.assertRaises(ValueError):
+            left.merge(ScoreStats(k=100))
+
+    def test_errors_and_empty(self):
+        from score_stats import ScoreStats
+        with self.assertRaises(ValueError):
+            ScoreStats(k=4)
+        stats = ScoreStats()
+        self.assertEqual(stats.quantiles([0.5]), [0.0])
+        self.assertEqual((len(stats), stats.sum, stats.mean), (0, 0.0, 0.0))
+        with self.assertRaises(ValueError):
+            stats.add(float("nan"))
+        stats.add(1.0)
+        with self.assertRaises(ValueError):
+            stats.quantile(1.5)
+        stats.reset()
+        self.assertEqual(len(stats), 0)
+
+
+class TestRunLog(unittest.TestCase):
+    """runlog.RunLogWriter / RunLogReader round trips, torn tails and resuming."""
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.tmp.name, "run.log")
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def _write(self, generations, resume_generation=None, chunk_rows=7):
+        from runlog import RunLogWriter
+        with RunLogWriter(self.path, chunk_rows=chunk_rows, resume_generation=resume_generation) as log:
+            for g in generations:
+                log.append(g, individual=list(range(5)), score=[g * 100 + i for i in range(5)])
+
+    def _load(self, *args):
+        from runlog import RunLogReader
+        with RunLogReader(self.path) as reader:
+            return reader.load(*args)
+
+    def test_round_trip(self):
+        self._write(range(10))
+        data = self._load()
+        self.assertEqual(data["generation"].tolist(), [g for g in range(10) for _ in range(5)])
+        self.assertEqual(data["score"].tolist(), [g * 100 + i for g in range(10) for i in range(5)])
+        self.assertEqual(set(data["parent1"].tolist()), {-1})  # Columns not given
+        self.assertEqual(self._load(3, 4, ["score"])["score"].tolist(), [300, 301, 302, 303, 304,
+                                                                          400, 401, 402, 403, 404])
+
+    def test_torn_tail_ignored(self):
+        self._write(range(10))
+        with open(self.path, "ab") as f:
+            f.write(b"CHNK\x05\x00")
+        self.assertEqual(len(self._load()["score"]), 50)
+        with open(self.path, "r+b") as f:
+            f.truncate(os.path.getsize(self.path) - 20)
+        self.assertLess(len(self._load()["score"]), 50)
+
+    def test_resume_appends(self):
+        self._write(range(6))
+        with open(self.path, "ab") as f:
+            f.write(b"CHNK\x05\x00")  # Torn tail left by the interruption
+        self._write(range(4, 10), resume_generation=4)
+        data = self._load()
+        self.assertEqual(data["generation"].tolist(), [g for g in range(10) for _ in range(5)])
+        self.assertEqual(data["score"].tolist(), [g * 100 + i for g in range(10) for i in range(5)])
+
+    def test_resume_rejects_other_columns(self):
+        from runlog import RunLogWriter
+        self._write(range(2))
+        with self.assertRaises(ValueError):
+            RunLogWriter(self.path, columns=(("generation", "<u4"), ("x", "<f8")), resume_generation=1)
+
+    def test_not_a_run_log(self):
+        from runlog import RunLogReader
+        open(self.path, "wb").close()
+        with self.assertRaises(ValueError):
+            RunLogReader(self.path)
+
+
+class TestGenomeArchive(unittest.TestCase):
+    """genome_archive round trips, patch chains, reindexing and resuming."""
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.tmp.name, "genomes.gar")
+        rng = random.Random(5)
+        # A lineage of lightly mutated children, so most records are patches
+        self.genomes = [bytes(rng.getrandbits(8) for _ in range(32))]
+        for _ in range(2000):
+            child = bytearray(self.genomes[rng.randrange(max(0, len(self.genomes) - 50), len(self.genomes))])
+            child[rng.randrange(len(child))] ^= 1 << rng.randrange(8)
+            if rng.random() < 0.1:
+                child += bytes([rng.getrandbits(8)])
+            self.genomes.append(bytes(child))
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def _write(self, genomes, resume=False):
+        from genome_archive import GenomeArchive
+        archive = GenomeArchive(self.path, block_size=1024, max_chain=4, resume=resume)
+        for i, genome in enumerate(genomes):
+            archive.add(genome, genomes[i - 1] if i else None)
+        return archive
+
+    def _check(self):
+        from genome_archive import GenomeArchiveReader, genome_hash
+        reader = GenomeArchiveReader(self.path)
+        try:
+            unique = list(dict.fromkeys(self.genomes))
+            self.assertEqual(len(reader), len(unique))
+            self.assertEqual(list(reader), unique)
+            for genome in unique[::97]:
+                self.assertEqual(reader.get(genome_hash(genome)), genome)
+            self.assertIsNone(reader.get(genome_hash(b"not archived")))
+            self.assertLessEqual(int(reader.depths().max()), 4)
+        finally:
+            reader.close()
+
+    def test_round_trip(self):
+        archive = self._write(self.genomes)
+        self.assertEqual(archive.add(self.genomes[10]), archive.add(self.genomes[10]))  # Deduplicated
+        archive.close()
+        self._check()
+
+    def test_reindex_without_close(self):
+        archive = self._write(self.genomes)
+        archive.flush()
+        archive._file.close()
+        self._check()
+
+    def test_resume_appends(self):
+        self._write(self.genomes[:1200]).close()
+        self._write(self.genomes[1000:], resume=True).close()
+        self._check()
+
+    def test_hash_runs(self):
+        from genome_archive import _SortedHashes
+        hashes = _SortedHashes(pending_limit=16)
+        keys = [os.urandom(16) for _ in range(3000)]
+        for i, key in enumerate(keys):
+            hashes.insert(key, i)
+        self.assertLess(len(hashes.runs), 12)
+        self.assertEqual(hashes.lookup(keys[::7]).tolist(), list(range(0, 3000, 7)))
+        self.assertEqual(hashes.lookup([b"\0" * 16]).tolist(), [-1])
+        merged, ids = hashes.merge()
+        self.assertTrue((merged[:-1] < merged[1:]).all())
+        self.assertEqual(len(ids), 3000)
+
+
+class TestCheckpoint(unittest.TestCase):
+    """checkpoint encoding, corruption checks and resuming a run."""
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def _checkpoint(self):
+        import numpy as np
+        from checkpoint import Checkpoint
+        from genetics import LINEAGE_DTYPE
+        from maze_game import Maze
+        random.seed(6)
+        population = [bytes(random.getrandbits(8) for _ in range(random.randint(0, 20))) for _ in range(30)]
+        lineage = np.zeros(30, dtype=LINEAGE_DTYPE)
+        lineage["parent1"] = np.arange(30)
+        lineage["crossover"] = -1
+        novelty = np.arange(12, dtype=np.float32).reshape(4, 3)
+        front = [(population[0], 120, 7), (b"", -50, 0)]
+        return Checkpoint(9, population, list(range(-15, 15)), [Maze(width=5, height=7)], random.getstate(),
+                          lineage, novelty, front)
+
+    def test_round_trip(self):
+        from checkpoint import decode, encode
+        original = self._checkpoint()
+        restored = decode(encode(original))
+        self.assertEqual((restored.generation, restored.population, restored.scores),
+                         (original.generation, original.population, original.scores))
+        self.assertEqual(restored.rng_state, original.rng_state)
+        self.assertEqual(restored.mazes[0].to_dict(), original.mazes[0].to_dict())
+        self.assertEqual(restored.lineage.tolist(), original.lineage.tolist())
+        self.assertEqual(restored.novelty.tolist(), original.novelty.tolist())
+        self.assertEqual(restored.front, original.front)
+
+    def test_optional_sections(self):
+        from checkpoint import decode, encode
+        checkpoint = self._checkpoint()
+        checkpoint.lineage = checkpoint.novelty = checkpoint.front = None
+        restored = decode(encode(checkpoint))
+        self.assertIsNone(restored.lineage)
+        self.assertIsNone(restored.novelty)
+        self.assertIsNone(restored.front)
+
+    def test_corruption_detected(self):
+        from checkpoint import decode, encode
+        data = bytearray(encode(self._checkpoint()))
+        with self.assertRaises(ValueError):
+            decode(bytes(data[:-10]))
+        data[40] ^= 1
+        with self.assertRaises(ValueError):
+            decode(bytes(data))
+
+    def test_checkpointer_writes_atomically(self):
+        from checkpoint import Checkpointer, load
+        path = os.path.join(self.tmp.name, "run.ckpt")
+        checkpoint = self._checkpoint()
+        writer = Checkpointer(path, checkpoint.mazes, every=2)
+        writer(3, checkpoint.population, [])  # Not a multiple of `every`
+        writer(4, checkpoint.population, [])
+        writer.close()
+        self.assertIsNone(writer.error)
+        self.assertEqual(load(path).generation, 4)
+        self.assertEqual(os.listdir(self.tmp.name), ["run.ckpt"])
+
+    def test_resume_matches_uninterrupted_run(self):
+        def run(*args):
+            subprocess.run([sys.executable, "runner.py", "--count", "100", "--no-live", "--nsga2", *args],
+                           check=True, stdout=subprocess.DEVNULL, cwd=os.path.dirname(os.path.abspath(__file__)))
+        path = lambda name: os.path.join(self.tmp.name, name)
+        run("--seed", "7", "--generations", "5", "--save-population", path("full.json"))
+        run("--seed", "7", "--generations", "3", "--checkpoint", path("run.ckpt"))
+        run("--generations", "5", "--resume", path("run.ckpt"), "--save-population", path("resumed.json"))
+        with open(path("full.json")) as full, open(path("resumed.json")) as resumed:
+            self.assertEqual(full.read(), resumed.read())
+
+
+_COUNTER_PLUGIN = r"""
+#include <string.h>
+#include "vm_core.h"
+
+typedef struct { uint32_t calls; } Run;
+
+static void* create(const uint8_t* config, uint32_t config_len) {
+    (void)config;
+    static int task;
+    return config_len == 0 ? &task : NULL;
+}
+static void destroy(void* task) { (void)task; }
+static void reset(const void* task, void* run) { (void)task; memset(run, 0, sizeof(Run)); }
+static int tick(const void* task, void* run, VMState* state) {
+    (void)task; (void)state;
+    return ++((Run*)run)->calls < 3 ? VM_ENV_CONTINUE : VM_ENV_EXIT;
+}
+static int64_t score(const void* task, const void* run, const VMEnvResult* result) {
+    (void)task;
+    return (int64_t)((const Run*)run)->calls * 7 - (result->halted ? 1 : 0);
+}
+static VMEnvironment env = {
+    .abi_version = ABI, .name = NAME, .run_size = sizeof(Run), .descriptor_dims = 0,
+    .create = create, .destroy = destroy, .reset = reset, .syscalls = { [0x20] = tick }, .score = score,
+};
+const VMEnvironment* vm_environment(void) { return &env; }
+"""
+
+
+@unittest.skipUnless(shutil.which("cc"), "needs a C compiler to build environment plugins")
+class TestEnvironments(unittest.TestCase):
+    """The native environment registry, the plugin ABI and vm_env_evaluate."""
+
+    @classmethod
+    def setUpClass(cls):
+        cls.tmp = tempfile.TemporaryDirectory()
+        source = os.path.join(cls.tmp.name, "counter.c")
+        with open(source, "w") as f:
+            f.write(_COUNTER_PLUGIN)
+        here = os.path.dirname(os.path.abspath(__file__))
+        for name, abi in (("counter", "VM_ENV_ABI_VERSION"), ("counter_old_abi", "(VM_ENV_ABI_VERSION + 1)")):
+            subprocess.run(["cc", "-shared", "-fPIC", "-I", here, f"-DNAME=\"{name}\"", f"-DABI={abi}",
+                            "-o", os.path.join(cls.tmp.name, name + ".so"), source], check=True)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tmp.cleanup()
+
+    def _plugin(self, name: str) -> str:
+        return os.path.join(self.tmp.name, name + ".so")
+
+    def test_builtins_registered(self):
+        import environments
+        self.assertEqual(environments.names()[:2], ["maze", "putc"])
+        self.assertEqual(environments.Environment("maze").descriptor_dims, 24)
+        with self.assertRaises(KeyError):
+            environments.Environment("no_such_environment")
+
+    def test_bad_config_rejected(self):
+        import environments
+        with self.assertRaises(ValueError):
+            environments.Environment("maze").task(b"\x01")
+        with self.assertRaises(ValueError):
+            environments.Environment("putc").task(b"")
+
+    def test_plugin_load_and_evaluate(self):
+        import environments
+        if "counter" not in environments.names():
+            self.assertEqual(environments.load(self._plugin("counter")), "counter")
+        with self.assertRaises(OSError):  # Duplicate name
+            environments.load(self._plugin("counter"))
+        task = environments.Environment("counter").task()
+        programs = [assemble("SYSCALL 0x20\n" * n) for n in (1, 2, 3, 4)] + [assemble("SYSCALL 0x21")]
+        results = environments.evaluate([task], [0] * len(programs), programs, threads=2)
+        # The third tick exits; running off the end or an unknown syscall halts
+        self.assertEqual([r.score for r in results], [6, 13, 21, 21, -1])
+        self.assertEqual([r.halted for r in results], [1, 1, 0, 0, 1])
+        self.assertEqual(results[4].state.interrupt, 0x21)
+
+    def test_plugin_abi_mismatch_rejected(self):
+        import environments
+        with self.assertRaises(OSError):
+            environments.load(self._plugin("counter_old_abi"))
+        self.assertNotIn("counter_old_abi", environments.names())
+        with self.assertRaises(OSError):
+            environments.load(os.path.join(self.tmp.name, "missing.so"))
+
+    def test_evaluate_picks_task_per_program(self):
+        import environments
+        putc = environments.Environment("putc")
+        tasks = [putc.task(environments.putc_config(b"hi")), putc.task(environments.putc_config(b"ho"))]
+        program = assemble("MOV_REG_IMM r0, 104\nSYSCALL 1\nMOV_REG_IMM r0, 105\nSYSCALL 1\nSYSCALL 0")
+        results = environments.evaluate(tasks, [0, 1, 0], [program] * 3)
+        self.assertEqual(results[0].score, results[2].score)
+        self.assertGreater(results[0].score, results[1].score)
+        with self.assertRaises(ValueError):
+            environments.evaluate(tasks, [2], [program])
+
+
+class TestTriage(unittest.TestCase):
+    """Crash buckets, corpus minimization and test-case reduction (triage.py)."""
+
+    def setUp(self):
+        import environments
+        self.task = environments.Environment("putc").task(environments.putc_config(b"hi"))
+
+    def _buckets(self, programs):
+        import triage
+        return [t.bucket for t in triage.triage(self.task, programs, coverage=False)[0]]
+
+    def test_bucket(self):
+        import triage
+        program = assemble("NOP\nNOP\nSYSCALL 0x21\nNOP")
+        triaged = triage.triage(self.task, [program, b"\0\0"], coverage=False)[0]
+        self.assertEqual(triaged[0].bucket, (0x21, 4, 1))
+        self.assertEqual(triage.bucket_name(triaged[0]), "syscall21-pc0004-op1")
+        self.assertEqual(triage.bucket_name(triaged[1]), "illegal_pc-pc0002-opend")
+
+    def test_reduce_keeps_bucket(self):
+        import triage
+        rng = random.Random(5)
+        programs = [bytes(rng.getrandbits(8) for _ in range(rng.randint(1, 40))) for _ in range(500)]
+        reduced = triage.reduce(self.task, programs)
+        self.assertEqual(self._buckets(reduced), self._buckets(programs))
+        self.assertLess(sum(map(len, reduced)), sum(map(len, programs)))
+        for before, after in zip(programs, reduced):
+            self.assertLessEqual(len(after), len(before))
+
+    def test_reduce_odd_tail(self):
+        import triage
+        # JZ r9, r8, 1 jumps to pc 3, past the end only while the trailing byte is there
+        jump = bytes.fromhex("9f1800")
+        self.assertEqual(self._buckets([jump, jump[:2]]), [(-3, 3, 0xFF), (-3, 1, 0xFF)])
+        self.assertEqual(triage.reduce(self.task, [jump]), [jump])
+        # Dropped when the bucket does not depend on it
+        self.assertEqual(triage.reduce(self.task, [b"\0\0\0"]), [b"\0\0"])
+
+    def test_minimize_drops_covered(self):
+        import triage
+        # The second runs exactly like the first, one byte longer; the third takes a new edge
+        programs = [b"\0\0\0\0", b"\0\0\0\0\0", bytes.fromhex("9f1800")]
+        triaged, traces = triage.triage(self.task, programs)
+        self.assertEqual(triage.minimize(triaged, traces), [0, 2])
+        self.assertEqual(triage.minimize(*triage.triage(self.task, programs[1:])), [0, 1])
+
+
+def _brute_force_fronts(points):
+    """Front index of each point by repeatedly peeling off the nondominated ones, O(N^2) per front."""
+    def dominates(a, b):
+        return all(x <= y for x, y in zip(a, b)) and any(x < y for x, y in zip(a, b))
+    ranks = [None] * len(points)
+    remaining = set(range(len(points)))
+    front = 0
+    while remaining:
+        current = {i for i in remaining if not any(dominates(points[j], points[i]) for j in remaining)}
+        for i in current:
+            ranks[i] = front
+        remaining -= current
+        front += 1
+    return ranks
+
+
+class TestNSGA(unittest.TestCase):
+    """The native nondominated sort and crowding distance (nsga.py)."""
+
+    def test_sort_matches_brute_force(self):
+        import nsga
+        rng = random.Random(9)
+        for dims in (2, 3):
+            for _ in range(50):
+                # Few distinct values, so ties and duplicate points are common
+                points = [tuple(float(rng.randint(0, 5)) for _ in range(dims)) for _ in range(rng.randint(1, 40))]
+                points += rng.sample(points, min(len(points), 5))
+                self.assertEqual(nsga.non_dominated_sort(points).tolist(), _brute_force_fronts(points), points)
+
+    def test_crowding_extremes_infinite(self):
+        import nsga
+        points = [(0.0, 4.0), (1.0, 2.0), (2.0, 1.0), (4.0, 0.0), (3.0, 3.0)]
+        ranks = nsga.non_dominated_sort(points)
+        self.assertEqual(ranks.tolist(), [0, 0, 0, 0, 1])
+        distance = nsga.crowding_distance(points, ranks)
+        self.assertEqual(distance[0], float("inf"))
+        self.assertEqual(distance[3], float("inf"))
+        self.assertTrue(0 < distance[1] < float("inf") and 0 < distance[2] < float("inf"))
+        self.assertEqual(distance[4], float("inf"))  # Alone in its front
+
+
 if __name__ == '__main__':
     unittest.main()
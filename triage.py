@@ -0,0 +1,165 @@
+"""
+triage.py
+
+Corpus minimization and crash bucketing for fuzzing campaigns (see fuzz.py).
+
+Every program is run once more on native threads, recording its classified
+edge coverage and its crash bucket: the interrupt it ended with, the pc of the
+instruction that raised it and that instruction's opcode. The minimized
+corpus is an afl-cmin style cover: programs whose coverage is contained in
+that of smaller kept ones are dropped, leaving few, small programs that
+together reach every edge and hit-count class. The smallest program of each
+halted bucket is then shrunk, keeping its bucket, by deleting instructions and
+blanking them to NOP.
+
+`write_corpus` writes each program as a raw .bin file holding just its bytes
+(not the genome_archive format), as run by misc.py and read by disasm.py:
+  DIR/<genome hash>.bin                            minimized corpus
+  DIR/crashes/<reason>-pc<PC>-op<OPCODE>.bin       reduced crash per bucket
+"""
+from __future__ import annotations
+
+import ctypes
+import os
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Sequence, Tuple
+
+from environments import Task, VMEnvResult
+from fuzz import COVERAGE_MAP_SIZE, outcome
+from genome_archive import genome_hash
+from metrics_server import termination_reason
+from misc import vm_core
+
+
+class VMCrashBucket(ctypes.Structure):
+    _fields_ = [
+        ("interrupt", ctypes.c_int16),
+        ("pc", ctypes.c_uint16),
+        ("opcode", ctypes.c_uint8),
+    ]
+
+
+_i32p = ctypes.POINTER(ctypes.c_int32)
+
+vm_core.vm_env_triage.argtypes = [
+    ctypes.c_void_p, ctypes.c_char_p, _i32p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+    ctypes.c_void_p, ctypes.POINTER(VMCrashBucket), ctypes.POINTER(VMEnvResult),
+]
+vm_core.vm_env_triage.restype = ctypes.c_int
+
+vm_core.coverage_minimize.argtypes = [ctypes.c_void_p, ctypes.c_int, _i32p, ctypes.POINTER(ctypes.c_uint8)]
+vm_core.coverage_minimize.restype = ctypes.c_int
+
+vm_core.vm_env_reduce.argtypes = [
+    ctypes.c_void_p, ctypes.c_void_p, _i32p, _i32p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+]
+vm_core.vm_env_reduce.restype = ctypes.c_int
+
+# (interrupt, pc, opcode); opcode 0xFF when pc is past the end of the program
+Bucket = Tuple[int, int, int]
+
+
+@dataclass
+class Triaged:
+    program: bytes
+    bucket: Bucket
+    outcome: int  # As fuzz.outcome
+
+
+def _offsets(programs: Sequence[bytes]) -> ctypes.Array:
+    offsets = (ctypes.c_int32 * (len(programs) + 1))()
+    position = 0
+    for i, program in enumerate(programs):
+        offsets[i] = position
+        position += len(program)
+    offsets[len(programs)] = position
+    return offsets
+
+
+def bucket_name(triaged: Triaged) -> str:
+    """File name stem of a bucket, e.g. illegal_pc-pc001C-op9."""
+    interrupt, pc, opcode = triaged.bucket
+    reason = termination_reason(triaged.outcome)
+    if reason == "unknown_syscall":
+        reason = f"syscall{interrupt:02X}"
+    op = "end" if opcode == 0xFF else f"{opcode:X}"
+    return f"{reason}-pc{pc:04X}-op{op}"
+
+
+def triage(task: Task, programs: Sequence[bytes], max_steps: int = 500, threads: Optional[int] = None,
+           coverage: bool = True) -> Tuple[List[Triaged], Optional[ctypes.Array]]:
+    """Runs every program; returns their buckets and, with `coverage`, their classified traces."""
+    count = len(programs)
+    traces = (ctypes.c_uint8 * (count * COVERAGE_MAP_SIZE))() if coverage and count else None
+    buckets = (VMCrashBucket * count)()
+    out = (VMEnvResult * count)()
+    if vm_core.vm_env_triage(task._handle, b"".join(programs), _offsets(programs), count, max_steps,
+                             max(1, threads or os.cpu_count() or 1), traces, buckets, out) != 0:
+        raise MemoryError("Native triage failed")
+    triaged = [Triaged(programs[i], (buckets[i].interrupt, buckets[i].pc, buckets[i].opcode), outcome(out[i]))
+               for i in range(count)]
+    return triaged, traces
+
+
+def minimize(triaged: Sequence[Triaged], traces: ctypes.Array) -> List[int]:
+    """Indices of the smallest programs that together cover every edge and hit-count class."""
+    count = len(triaged)
+    if not count:
+        return []
+    sizes = (ctypes.c_int32 * count)(*(len(t.program) for t in triaged))
+    keep = (ctypes.c_uint8 * count)()
+    if vm_core.coverage_minimize(traces, count, sizes, keep) < 0:
+        raise MemoryError("Native corpus minimization failed")
+    return [i for i in range(count) if keep[i]]
+
+
+def reduce(task: Task, programs: Sequence[bytes], max_steps: int = 500, threads: Optional[int] = None) -> List[bytes]:
+    """Each program shrunk as far as it goes without leaving its crash bucket."""
+    count = len(programs)
+    if not count:
+        return []
+    offsets = _offsets(programs)
+    lengths = (ctypes.c_int32 * count)(*(len(p) for p in programs))
+    buffer = ctypes.create_string_buffer(b"".join(programs), offsets[count])
+    if vm_core.vm_env_reduce(task._handle, buffer, offsets, lengths, count, max_steps,
+                             max(1, threads or os.cpu_count() or 1)) != 0:
+        raise MemoryError("Native test-case reduction failed")
+    raw = buffer.raw
+    return [raw[offsets[i]:offsets[i] + lengths[i]] for i in range(count)]
+
+
+@dataclass
+class CorpusSummary:
+    programs: int         # Programs triaged
+    kept: int             # Minimized corpus size
+    buckets: int          # Distinct buckets
+    crashes: int          # Halted buckets written to crashes/
+    bytes_before: int     # Total size of crash representatives before reduction
+    bytes_after: int
+
+
+def write_corpus(directory: str, task: Task, programs: Sequence[bytes], max_steps: int = 500,
+                 threads: Optional[int] = None) -> CorpusSummary:
+    """Triages, minimizes and reduces `programs` and writes the corpus directory."""
+    programs = [p for p in programs if p]
+    triaged, traces = triage(task, programs, max_steps, threads)
+    kept = minimize(triaged, traces)
+
+    representatives: Dict[Bucket, Triaged] = {}
+    for t in triaged:
+        best = representatives.get(t.bucket)
+        if best is None or len(t.program) < len(best.program):
+            representatives[t.bucket] = t
+    crashes = [t for t in representatives.values() if termination_reason(t.outcome) != "exit"]
+    reduced = reduce(task, [t.program for t in crashes], max_steps, threads)
+
+    os.makedirs(os.path.join(directory, "crashes"), exist_ok=True)
+    for i in kept:
+        program = triaged[i].program
+        with open(os.path.join(directory, genome_hash(program).hex() + ".bin"), "wb") as f:
+            f.write(program)
+    for t, program in zip(crashes, reduced):
+        with open(os.path.join(directory, "crashes", bucket_name(t) + ".bin"), "wb") as f:
+            f.write(program)
+    return CorpusSummary(len(programs), len(kept), len(representatives), len(crashes),
+                         sum(len(t.program) for t in crashes), sum(len(p) for p in reduced))
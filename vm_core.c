@@ -1,8 +1,34 @@
+// Build: cc -O2 -shared -fPIC -o vm_core.so vm_core.c -lm
+// The AVX2 diversity kernels are compiled in on x86-64 and picked at run time.
+// Requires POSIX threads and C11 atomics; environment plugins (vm_env_load)
+// need dlopen and are unavailable on other platforms.
 #include "vm_core.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VM_CORE_DLOPEN 1
+#include <dlfcn.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VM_CORE_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
 
 // This constant is used to determine protected registers
 const unsigned char protected_registers[] = 
@@ -11,7 +37,35 @@ const unsigned char protected_registers[] =
      0, 0, 0, 0,
      0, 0, 0, 1};
 
-void run_c(VMState* state, const uint8_t* program, int program_len, int max_steps, bool debug) {
+// Syscall profiling of run_c, per thread (see syscall_profile_activate)
+static _Thread_local SyscallProfile* syscall_profile_active = NULL;
+static _Thread_local const VMState* syscall_pending_state = NULL;
+static _Thread_local uint64_t syscall_pending_ns = 0;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Native counters of run_c, per thread (see vm_counters_activate)
+static _Thread_local VMCounters* vm_counters_active = NULL;
+
+// Edge coverage of one run, AFL style: map[location ^ prev]++ per instruction
+typedef struct {
+    uint8_t* map;   // COVERAGE_MAP_SIZE wrapping hit counts
+    uint32_t prev;  // Previous location >> 1, so A->B and B->A differ
+} CoverageTrace;
+
+static inline uint32_t coverage_location(uint16_t pc) {
+    return ((uint32_t)(pc >> 1) * 0x9E3779B1u) >> (32 - COVERAGE_MAP_BITS);
+}
+
+// The interpreter. Inlined into run_c twice, with and without counters, so the
+// uncounted copy has no per-instruction check, and once more with coverage for fuzzing.
+static inline __attribute__((always_inline))
+void run_core(VMState* state, const uint8_t* program, int program_len, int max_steps, bool debug,
+              VMCounters* counters, CoverageTrace* coverage) {
     // Check if the state needs to be picked up after a signal
     uint8_t op, rd, rs;
     Instruction *instr;
@@ -27,6 +81,11 @@ void run_c(VMState* state, const uint8_t* program, int program_len, int max_step
         goto DEBUG_PICKUP;
     }
     else { // a syscall was just completed
+        if (syscall_profile_active && state->interrupt >= 0 && syscall_pending_state == state) {
+            syscall_profile_record(syscall_profile_active, SYSCALL_PROFILE_ROUNDTRIP, state->interrupt,
+                                   monotonic_ns() - syscall_pending_ns);
+        }
+        syscall_pending_state = NULL;
         state->interrupt = INTERRUPT_NONE;
         instr = (Instruction *)(program + state->pc);
         goto SYSCALL_PICKUP;
@@ -42,6 +101,12 @@ void run_c(VMState* state, const uint8_t* program, int program_len, int max_step
             return;
         }
 
+        if (coverage) {
+            uint32_t location = coverage_location(state->pc);
+            coverage->map[location ^ coverage->prev]++;
+            coverage->prev = location >> 1;
+        }
+
         // --- Fast Instruction Fetch and Decode ---
         // Decode directly into local variables. This is much faster than writing
         // to the VMState struct in memory on every cycle. The compiler can
@@ -62,6 +127,7 @@ void run_c(VMState* state, const uint8_t* program, int program_len, int max_step
             return;
         }
 DEBUG_PICKUP:
+        if (counters) counters->opcodes[op]++;
         state->pc += INSTRUCTION_LENGTH;
         state->registers[PC_REG] = state->pc;
         state->steps++;
@@ -96,6 +162,10 @@ DEBUG_PICKUP:
                 state->interrupt = instr->op_imm.imm & 0xFF;
                 if (state->interrupt == 0) {
                 }
+                if (syscall_profile_active) {
+                    syscall_pending_state = state;
+                    syscall_pending_ns = monotonic_ns();
+                }
                 return; // Return to Python to handle syscall
 
             case OP_MOV_REG_IMM:
@@ -194,6 +264,33 @@ SYSCALL_PICKUP:
     }
 }
 
+void run_c(VMState* state, const uint8_t* program, int program_len, int max_steps, bool debug) {
+    VMCounters* counters = vm_counters_active;
+    if (!counters) {
+        run_core(state, program, program_len, max_steps, debug, NULL, NULL);
+        return;
+    }
+    uint64_t start = monotonic_ns();
+    uint32_t steps = state->steps;
+    run_core(state, program, program_len, max_steps, debug, counters, NULL);
+    counters->run_c_ns += monotonic_ns() - start;
+    counters->run_c_calls++;
+    counters->instructions += state->steps - steps;
+    if (state->interrupt >= 0 && state->interrupt != INTERRUPT_DEBUG) {
+        counters->syscalls[state->interrupt & 0xFF]++;
+    }
+}
+
+// run_c recording edge coverage; the counters are left to run_c
+static void run_c_coverage(VMState* state, const uint8_t* program, int program_len, int max_steps,
+                           CoverageTrace* coverage) {
+    run_core(state, program, program_len, max_steps, false, NULL, coverage);
+}
+
+void vm_counters_activate(VMCounters* counters) {
+    vm_counters_active = counters;
+}
+
 void free_memory(void* ptr) {
     if (ptr) {
         free(ptr);
@@ -363,4 +460,2578 @@ int assemble_instruction(const char* mnemonic, uint16_t op1, uint16_t op2, uint1
     // Since the union and uint16_t are the same size, we can cast the address
     // of the union to a uint16_t pointer and dereference it.
     return 0;
-}
\ No newline at end of file
+}
+
+// --- Population diversity ---
+
+// splitmix64, used to seed and drive the samplers in this file
+static inline uint64_t rng_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Hamming distance between two arena rows. stride is a multiple of 8, so rows
+// are processed as whole 64-bit words.
+static uint32_t hamming_rows_scalar(const uint8_t* a, const uint8_t* b, int stride) {
+    const int words = stride / 8;
+    uint64_t total = 0;
+    for (int w = 0; w < words; w++) {
+        uint64_t x, y;
+        memcpy(&x, a + w * 8, 8);
+        memcpy(&y, b + w * 8, 8);
+        total += (uint64_t)__builtin_popcountll(x ^ y);
+    }
+    return (uint32_t)total;
+}
+
+#if defined(VM_CORE_AVX2_DISPATCH)
+// The same, four words at a time; only called when the CPU has AVX2
+__attribute__((target("avx2,popcnt")))
+static uint32_t hamming_rows_avx2(const uint8_t* a, const uint8_t* b, int stride) {
+    const int words = stride / 8;
+    uint64_t total = 0;
+    int w = 0;
+    // Nibble lookup popcount (Mula et al.), summed per 64-bit lane with SAD
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i acc = _mm256_setzero_si256();
+    for (; w + 4 <= words; w += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + w * 8)),
+                                     _mm256_loadu_si256((const __m256i*)(b + w * 8)));
+        __m256i lo = _mm256_and_si256(x, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    total += (uint64_t)_mm256_extract_epi64(acc, 0) + (uint64_t)_mm256_extract_epi64(acc, 1)
+           + (uint64_t)_mm256_extract_epi64(acc, 2) + (uint64_t)_mm256_extract_epi64(acc, 3);
+    for (; w < words; w++) {
+        uint64_t x, y;
+        memcpy(&x, a + w * 8, 8);
+        memcpy(&y, b + w * 8, 8);
+        total += (uint64_t)__builtin_popcountll(x ^ y);
+    }
+    return (uint32_t)total;
+}
+#endif
+
+typedef uint32_t (*HammingRows)(const uint8_t* a, const uint8_t* b, int stride);
+
+// The fastest kernel this CPU runs, checked once per call of the public functions
+static HammingRows hamming_kernel(void) {
+#if defined(VM_CORE_AVX2_DISPATCH)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return hamming_rows_avx2;
+#endif
+    return hamming_rows_scalar;
+}
+
+static int arena_args_valid(const uint8_t* arena, int count, int stride) {
+    return arena != NULL && count >= 0 && stride > 0 && stride % 8 == 0;
+}
+
+int hamming_pairwise(const uint8_t* arena, int count, int stride, uint32_t* out) {
+    if (!arena_args_valid(arena, count, stride) || !out) return -1;
+    HammingRows hamming_rows = hamming_kernel();
+    size_t k = 0;
+    for (int i = 0; i < count; i++) {
+        const uint8_t* row = arena + (size_t)i * stride;
+        for (int j = i + 1; j < count; j++) {
+            out[k++] = hamming_rows(row, arena + (size_t)j * stride, stride);
+        }
+    }
+    return 0;
+}
+
+int hamming_sampled(const uint8_t* arena, int count, int stride, uint64_t pairs, uint64_t seed,
+                    uint32_t* out, uint32_t* out_a, uint32_t* out_b) {
+    if (!arena_args_valid(arena, count, stride) || !out || count < 2) return -1;
+    HammingRows hamming_rows = hamming_kernel();
+    uint64_t rng = seed;
+    for (uint64_t k = 0; k < pairs; k++) {
+        uint32_t a = (uint32_t)(rng_next(&rng) % (uint64_t)count);
+        uint32_t b = (uint32_t)(rng_next(&rng) % (uint64_t)(count - 1));
+        if (b >= a) b++;
+        out[k] = hamming_rows(arena + (size_t)a * stride, arena + (size_t)b * stride, stride);
+        if (out_a) out_a[k] = a;
+        if (out_b) out_b[k] = b;
+    }
+    return 0;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Content hash of one genome, used to count unique genomes
+static uint64_t hash_row(const uint8_t* row, uint32_t length) {
+    uint64_t h = 0xCBF29CE484222325ULL ^ length;
+    for (uint32_t i = 0; i < length; i++) {
+        h = (h ^ row[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static inline void account_distance(DiversityStats* out, double* sum, uint32_t d) {
+    *sum += d;
+    if (d < out->min_distance) out->min_distance = d;
+    if (d > out->max_distance) out->max_distance = d;
+}
+
+int diversity_stats(const uint8_t* arena, const uint32_t* lengths, int count, int stride,
+                    uint64_t sample_pairs, uint64_t seed, double* bit_entropy, DiversityStats* out) {
+    if (!arena_args_valid(arena, count, stride) || !lengths || !out) return -1;
+    memset(out, 0, sizeof(*out));
+    HammingRows hamming_rows = hamming_kernel();
+
+    // --- Pairwise distances, exact or sampled ---
+    const uint64_t all_pairs = (uint64_t)count * (uint64_t)(count > 0 ? count - 1 : 0) / 2;
+    double sum = 0.0;
+    out->min_distance = UINT32_MAX;
+    if (all_pairs > 0 && (sample_pairs == 0 || sample_pairs >= all_pairs)) {
+        for (int i = 0; i < count; i++) {
+            const uint8_t* row = arena + (size_t)i * stride;
+            for (int j = i + 1; j < count; j++) {
+                account_distance(out, &sum, hamming_rows(row, arena + (size_t)j * stride, stride));
+            }
+        }
+        out->pairs = all_pairs;
+    } else if (all_pairs > 0) {
+        uint64_t rng = seed;
+        for (uint64_t k = 0; k < sample_pairs; k++) {
+            uint32_t a = (uint32_t)(rng_next(&rng) % (uint64_t)count);
+            uint32_t b = (uint32_t)(rng_next(&rng) % (uint64_t)(count - 1));
+            if (b >= a) b++;
+            account_distance(out, &sum, hamming_rows(arena + (size_t)a * stride, arena + (size_t)b * stride, stride));
+        }
+        out->pairs = sample_pairs;
+    }
+    if (out->pairs == 0) out->min_distance = 0;
+    out->mean_distance = out->pairs ? sum / (double)out->pairs : 0.0;
+
+    // --- Unique genomes ---
+    if (count > 0) {
+        uint64_t* hashes = (uint64_t*)malloc(sizeof(uint64_t) * (size_t)count);
+        if (!hashes) return -1;
+        for (int i = 0; i < count; i++) {
+            uint32_t len = lengths[i] < (uint32_t)stride ? lengths[i] : (uint32_t)stride;
+            hashes[i] = hash_row(arena + (size_t)i * stride, len);
+        }
+        qsort(hashes, (size_t)count, sizeof(uint64_t), compare_u64);
+        out->unique_genomes = 1;
+        for (int i = 1; i < count; i++) {
+            if (hashes[i] != hashes[i - 1]) out->unique_genomes++;
+        }
+        free(hashes);
+    }
+
+    // --- Per-bit entropy over the positions covered by at least two genomes ---
+    const size_t bits = (size_t)stride * 8;
+    uint32_t* ones = (uint32_t*)calloc(bits, sizeof(uint32_t));
+    uint32_t* covered = (uint32_t*)calloc((size_t)stride + 1, sizeof(uint32_t));
+    if (!ones || !covered) {
+        free(ones);
+        free(covered);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        const uint8_t* row = arena + (size_t)i * stride;
+        uint32_t len = lengths[i] < (uint32_t)stride ? lengths[i] : (uint32_t)stride;
+        covered[len]++;
+        for (uint32_t byte = 0; byte < len; byte++) {
+            uint8_t v = row[byte];
+            if (!v) continue;
+            uint32_t* o = ones + (size_t)byte * 8;
+            for (int bit = 0; bit < 8; bit++) o[bit] += (v >> (7 - bit)) & 1;
+        }
+    }
+    // covered[len] holds how many genomes have exactly len bytes; turn it into
+    // "genomes with more than `byte` bytes" by a suffix sum.
+    uint32_t running = 0;
+    double entropy_sum = 0.0;
+    for (int byte = stride; byte >= 0; byte--) {
+        uint32_t with_byte = running;
+        running += covered[byte];
+        if (byte == stride) continue;
+        for (int bit = 0; bit < 8; bit++) {
+            size_t pos = (size_t)byte * 8 + bit;
+            double h = -1.0;
+            if (with_byte >= 2) {
+                double p = (double)ones[pos] / (double)with_byte;
+                h = 0.0;
+                if (p > 0.0 && p < 1.0) h = -p * log2(p) - (1.0 - p) * log2(1.0 - p);
+                entropy_sum += h;
+                out->bit_positions++;
+            }
+            if (bit_entropy) bit_entropy[pos] = h;
+        }
+    }
+    out->mean_bit_entropy = out->bit_positions ? entropy_sum / out->bit_positions : 0.0;
+    free(ones);
+    free(covered);
+    return 0;
+}
+
+// --- Novelty archive ---
+
+struct NoveltyArchive {
+    int dim;
+    int capacity;
+    int size;
+    uint64_t rng;
+    float* data; // capacity rows of dim floats
+};
+
+NoveltyArchive* novelty_archive_new(int dim, int capacity, uint64_t seed) {
+    if (dim <= 0 || capacity <= 0) return NULL;
+    NoveltyArchive* archive = (NoveltyArchive*)calloc(1, sizeof(NoveltyArchive));
+    if (!archive) return NULL;
+    archive->data = (float*)malloc(sizeof(float) * (size_t)dim * (size_t)capacity);
+    if (!archive->data) {
+        free(archive);
+        return NULL;
+    }
+    archive->dim = dim;
+    archive->capacity = capacity;
+    archive->rng = seed;
+    return archive;
+}
+
+void novelty_archive_free(NoveltyArchive* archive) {
+    if (!archive) return;
+    free(archive->data);
+    free(archive);
+}
+
+int novelty_archive_size(const NoveltyArchive* archive) {
+    return archive ? archive->size : 0;
+}
+
+int novelty_archive_add(NoveltyArchive* archive, const float* descriptors, int count) {
+    if (!archive || (!descriptors && count > 0) || count < 0) return -1;
+    const size_t row = sizeof(float) * (size_t)archive->dim;
+    for (int i = 0; i < count; i++) {
+        int slot = archive->size < archive->capacity
+                 ? archive->size++
+                 : (int)(rng_next(&archive->rng) % (uint64_t)archive->capacity);
+        memcpy(archive->data + (size_t)slot * archive->dim, descriptors + (size_t)i * archive->dim, row);
+    }
+    return count;
+}
+
+int novelty_archive_get(const NoveltyArchive* archive, float* out) {
+    if (!archive || !out) return 0;
+    memcpy(out, archive->data, sizeof(float) * (size_t)archive->dim * (size_t)archive->size);
+    return archive->size;
+}
+
+// Vantage-point tree stored implicitly in `items`: the node covering items[lo..hi)
+// has its vantage point at items[lo], the points closer than mu[lo] in
+// items[lo+1..mid) and the rest in items[mid..hi), with mid splitting the
+// remaining points in half. Points are distinct descriptors; `weight` counts
+// how many archive or population entries share each one.
+typedef struct {
+    const float* points;
+    const uint32_t* weight;
+    int dim;
+    uint32_t* items;
+    float* mu;
+    float* scratch;
+    uint64_t rng;
+} VPTree;
+
+static inline float vp_distance(const float* a, const float* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sqrtf(sum);
+}
+
+static inline int vp_mid(int lo, int hi) {
+    return lo + 1 + (hi - lo - 1) / 2;
+}
+
+static inline void vp_swap(VPTree* t, int a, int b) {
+    uint32_t item = t->items[a];
+    float dist = t->scratch[a];
+    t->items[a] = t->items[b];
+    t->scratch[a] = t->scratch[b];
+    t->items[b] = item;
+    t->scratch[b] = dist;
+}
+
+// Three-way quickselect on scratch[lo..hi) so that position nth holds its sorted value
+static void vp_select(VPTree* t, int lo, int hi, int nth) {
+    while (hi - lo > 1) {
+        float pivot = t->scratch[lo + (int)(rng_next(&t->rng) % (uint64_t)(hi - lo))];
+        int lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            if (t->scratch[i] < pivot) vp_swap(t, lt++, i++);
+            else if (t->scratch[i] > pivot) vp_swap(t, i, --gt);
+            else i++;
+        }
+        if (nth < lt) hi = lt;
+        else if (nth >= gt) lo = gt;
+        else return;
+    }
+}
+
+static void vp_build(VPTree* t, int lo, int hi) {
+    if (hi - lo <= 1) return;
+    vp_swap(t, lo, lo + (int)(rng_next(&t->rng) % (uint64_t)(hi - lo)));
+    const float* vp = t->points + (size_t)t->items[lo] * t->dim;
+    for (int i = lo + 1; i < hi; i++) {
+        t->scratch[i] = vp_distance(vp, t->points + (size_t)t->items[i] * t->dim, t->dim);
+    }
+    int mid = vp_mid(lo, hi);
+    vp_select(t, lo + 1, hi, mid);
+    t->mu[lo] = t->scratch[mid];
+    vp_build(t, lo + 1, mid);
+    vp_build(t, mid, hi);
+}
+
+// The k best candidate distances so far, in ascending order
+typedef struct {
+    int k;
+    int found;
+    float* dist;
+} KnnList;
+
+static inline float knn_tau(const KnnList* h) {
+    return h->found < h->k ? INFINITY : h->dist[h->k - 1];
+}
+
+// Offers `copies` neighbours at distance d
+static inline void knn_push(KnnList* h, float d, uint32_t copies) {
+    for (uint32_t c = 0; c < copies; c++) {
+        if (h->found == h->k && d >= h->dist[h->k - 1]) return;
+        int i = h->found < h->k ? h->found++ : h->k - 1;
+        while (i > 0 && h->dist[i - 1] > d) {
+            h->dist[i] = h->dist[i - 1];
+            i--;
+        }
+        h->dist[i] = d;
+    }
+}
+
+static void vp_search(const VPTree* t, int lo, int hi, const float* q, uint32_t self, KnnList* h) {
+    if (lo >= hi) return;
+    uint32_t vp = t->items[lo];
+    float d = vp_distance(q, t->points + (size_t)vp * t->dim, t->dim);
+    // The query itself is one of the entries sharing its point
+    knn_push(h, d, vp == self ? t->weight[vp] - 1 : t->weight[vp]);
+    if (hi - lo == 1) return;
+    int mid = vp_mid(lo, hi);
+    float mu = t->mu[lo];
+    if (d < mu) {
+        vp_search(t, lo + 1, mid, q, self, h);
+        if (d + knn_tau(h) >= mu) vp_search(t, mid, hi, q, self, h);
+    } else {
+        vp_search(t, mid, hi, q, self, h);
+        if (d - knn_tau(h) <= mu) vp_search(t, lo + 1, mid, q, self, h);
+    }
+}
+
+typedef struct {
+    uint64_t hash;
+    uint32_t row;
+} RowHash;
+
+static int compare_row_hash(const void* a, const void* b) {
+    const RowHash* x = (const RowHash*)a;
+    const RowHash* y = (const RowHash*)b;
+    if (x->hash != y->hash) return (x->hash > y->hash) - (x->hash < y->hash);
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+int novelty_scores(const NoveltyArchive* archive, const float* population, int count, int k, float* out_scores) {
+    if (!archive || count < 0 || k <= 0 || (count > 0 && (!population || !out_scores))) return -1;
+    if (count == 0) return 0;
+    const int dim = archive->dim;
+    const int total = archive->size + count;
+    const size_t row_bytes = sizeof(float) * (size_t)dim;
+
+    RowHash* hashes = (RowHash*)malloc(sizeof(RowHash) * (size_t)total);
+    uint32_t* unique_of = (uint32_t*)malloc(sizeof(uint32_t) * (size_t)total);
+    float* points = (float*)malloc(row_bytes * (size_t)total);
+    uint32_t* weight = (uint32_t*)calloc((size_t)total, sizeof(uint32_t));
+    uint32_t* items = (uint32_t*)malloc(sizeof(uint32_t) * (size_t)total);
+    float* mu = (float*)malloc(sizeof(float) * (size_t)total);
+    float* scratch = (float*)malloc(sizeof(float) * (size_t)total);
+    float* novelty = (float*)malloc(sizeof(float) * (size_t)total);
+    float* knn = (float*)malloc(sizeof(float) * (size_t)k);
+    int rc = -1;
+    if (!hashes || !unique_of || !points || !weight || !items || !mu || !scratch || !novelty || !knn) goto done;
+
+    // Collapse identical descriptors (GA populations are full of clones) into
+    // weighted points, so the tree is built and queried once per behaviour.
+    #define NOVELTY_ROW(i) ((size_t)(i) < (size_t)archive->size \
+                                ? archive->data + (size_t)(i) * dim \
+                                : population + ((size_t)(i) - (size_t)archive->size) * dim)
+    for (int i = 0; i < total; i++) {
+        hashes[i].hash = hash_row((const uint8_t*)NOVELTY_ROW(i), (uint32_t)row_bytes);
+        hashes[i].row = (uint32_t)i;
+    }
+    qsort(hashes, (size_t)total, sizeof(RowHash), compare_row_hash);
+    int unique = 0;
+    for (int i = 0; i < total; i++) {
+        const float* row = NOVELTY_ROW(hashes[i].row);
+        int match = -1;
+        // Compare against the distinct rows already seen with the same hash
+        for (int j = i - 1; j >= 0 && hashes[j].hash == hashes[i].hash; j--) {
+            uint32_t u = unique_of[hashes[j].row];
+            if (memcmp(points + (size_t)u * dim, row, row_bytes) == 0) {
+                match = (int)u;
+                break;
+            }
+        }
+        if (match < 0) {
+            match = unique++;
+            memcpy(points + (size_t)match * dim, row, row_bytes);
+        }
+        unique_of[hashes[i].row] = (uint32_t)match;
+        weight[match]++;
+    }
+    #undef NOVELTY_ROW
+
+    for (int i = 0; i < unique; i++) {
+        items[i] = (uint32_t)i;
+        novelty[i] = -1.0f;
+    }
+    VPTree tree = { points, weight, dim, items, mu, scratch, archive->rng ^ (uint64_t)total };
+    vp_build(&tree, 0, unique);
+
+    for (int i = 0; i < count; i++) {
+        uint32_t u = unique_of[archive->size + i];
+        if (novelty[u] < 0.0f) {
+            KnnList h = { k, 0, knn };
+            vp_search(&tree, 0, unique, points + (size_t)u * dim, u, &h);
+            float sum = 0.0f;
+            for (int j = 0; j < h.found; j++) sum += h.dist[j];
+            novelty[u] = h.found ? sum / (float)h.found : 0.0f;
+        }
+        out_scores[i] = novelty[u];
+    }
+    rc = 0;
+
+done:
+    free(hashes);
+    free(unique_of);
+    free(points);
+    free(weight);
+    free(items);
+    free(mu);
+    free(scratch);
+    free(novelty);
+    free(knn);
+    return rc;
+}
+
+// --- MAP-Elites archive ---
+
+struct MapElites {
+    int dims;
+    int bins[MAP_ELITES_MAX_DIMS];
+    double lows[MAP_ELITES_MAX_DIMS];
+    double highs[MAP_ELITES_MAX_DIMS];
+    int stride;
+    int32_t cells;
+    uint64_t rng;
+    int32_t occupied_count;
+    int32_t* occupied;  // Occupied cell indices, in fill order
+    uint8_t* filled;    // Per cell: 1 if it holds an elite
+    double* scores;     // Per cell: elite score
+    uint32_t* lengths;  // Per cell: elite length in bytes
+    uint8_t* genomes;   // Per cell: `stride` bytes of elite genome
+};
+
+MapElites* map_elites_new(int dims, const int* bins, const double* lows, const double* highs,
+                          int stride, uint64_t seed) {
+    if (dims <= 0 || dims > MAP_ELITES_MAX_DIMS || !bins || !lows || !highs || stride <= 0) return NULL;
+    int64_t cells = 1;
+    for (int d = 0; d < dims; d++) {
+        if (bins[d] <= 0 || !(highs[d] > lows[d])) return NULL;
+        cells *= bins[d];
+        if (cells > INT32_MAX) return NULL;
+    }
+    MapElites* me = (MapElites*)calloc(1, sizeof(MapElites));
+    if (!me) return NULL;
+    me->dims = dims;
+    memcpy(me->bins, bins, sizeof(int) * dims);
+    memcpy(me->lows, lows, sizeof(double) * dims);
+    memcpy(me->highs, highs, sizeof(double) * dims);
+    me->stride = stride;
+    me->cells = (int32_t)cells;
+    me->rng = seed;
+    me->occupied = (int32_t*)malloc(sizeof(int32_t) * (size_t)cells);
+    me->filled = (uint8_t*)calloc((size_t)cells, 1);
+    me->scores = (double*)malloc(sizeof(double) * (size_t)cells);
+    me->lengths = (uint32_t*)calloc((size_t)cells, sizeof(uint32_t));
+    me->genomes = (uint8_t*)malloc((size_t)cells * (size_t)stride);
+    if (!me->occupied || !me->filled || !me->scores || !me->lengths || !me->genomes) {
+        map_elites_free(me);
+        return NULL;
+    }
+    return me;
+}
+
+void map_elites_free(MapElites* me) {
+    if (!me) return;
+    free(me->occupied);
+    free(me->filled);
+    free(me->scores);
+    free(me->lengths);
+    free(me->genomes);
+    free(me);
+}
+
+int map_elites_size(const MapElites* me) {
+    return me ? me->occupied_count : 0;
+}
+
+static int32_t map_elites_cell(const MapElites* me, const double* features) {
+    int32_t cell = 0;
+    for (int d = 0; d < me->dims; d++) {
+        double t = (features[d] - me->lows[d]) / (me->highs[d] - me->lows[d]);
+        // Clamp before the cast: NaN lands in bucket 0, +inf and anything past
+        // the high bound in the last one, so the conversion never overflows
+        int bin;
+        if (!(t > 0.0)) bin = 0;
+        else if (t >= 1.0) bin = me->bins[d] - 1;
+        else bin = (int)(t * me->bins[d]);
+        if (bin >= me->bins[d]) bin = me->bins[d] - 1;
+        cell = cell * me->bins[d] + bin;
+    }
+    return cell;
+}
+
+int map_elites_insert(MapElites* me, const double* features, const double* scores,
+                      const uint8_t* arena, const uint32_t* lengths, int count, int arena_stride,
+                      uint8_t* inserted) {
+    if (!me || count < 0 || (count > 0 && (!features || !scores || !arena || !lengths)) || arena_stride <= 0) {
+        return -1;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        int32_t cell = map_elites_cell(me, features + (size_t)i * me->dims);
+        int better = !me->filled[cell] || scores[i] > me->scores[cell];
+        if (inserted) inserted[i] = (uint8_t)better;
+        if (!better) continue;
+        if (!me->filled[cell]) {
+            me->filled[cell] = 1;
+            me->occupied[me->occupied_count++] = cell;
+        }
+        uint32_t len = lengths[i];
+        if (len > (uint32_t)arena_stride) len = (uint32_t)arena_stride;
+        if (len > (uint32_t)me->stride) len = (uint32_t)me->stride;
+        uint8_t* row = me->genomes + (size_t)cell * me->stride;
+        memcpy(row, arena + (size_t)i * arena_stride, len);
+        memset(row + len, 0, (size_t)me->stride - len);
+        me->lengths[cell] = len;
+        me->scores[cell] = scores[i];
+        kept++;
+    }
+    return kept;
+}
+
+int map_elites_sample(MapElites* me, int count, uint8_t* out_arena, uint32_t* out_lengths,
+                      int32_t* out_cells) {
+    if (!me || me->occupied_count == 0 || count <= 0 || !out_arena || !out_lengths) return 0;
+    for (int i = 0; i < count; i++) {
+        int32_t cell = me->occupied[rng_next(&me->rng) % (uint64_t)me->occupied_count];
+        memcpy(out_arena + (size_t)i * me->stride, me->genomes + (size_t)cell * me->stride, (size_t)me->stride);
+        out_lengths[i] = me->lengths[cell];
+        if (out_cells) out_cells[i] = cell;
+    }
+    return count;
+}
+
+int map_elites_export(const MapElites* me, int32_t* out_cells, double* out_scores,
+                      uint8_t* out_arena, uint32_t* out_lengths) {
+    if (!me) return 0;
+    for (int32_t i = 0; i < me->occupied_count; i++) {
+        int32_t cell = me->occupied[i];
+        if (out_cells) out_cells[i] = cell;
+        if (out_scores) out_scores[i] = me->scores[cell];
+        if (out_arena) memcpy(out_arena + (size_t)i * me->stride, me->genomes + (size_t)cell * me->stride, (size_t)me->stride);
+        if (out_lengths) out_lengths[i] = me->lengths[cell];
+    }
+    return me->occupied_count;
+}
+
+// --- Multi-objective selection ---
+
+typedef struct {
+    double f[3];
+    int32_t index;
+} NdsPoint;
+
+static int compare_nds_point(const void* a, const void* b) {
+    const NdsPoint* x = (const NdsPoint*)a;
+    const NdsPoint* y = (const NdsPoint*)b;
+    for (int i = 0; i < 3; i++) {
+        if (x->f[i] < y->f[i]) return -1;
+        if (x->f[i] > y->f[i]) return 1;
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// The points of one front projected on (f2, f3), reduced to the ones no other
+// member beats on both: sorted by ascending f2, hence strictly descending f3.
+typedef struct {
+    double* f2;
+    double* f3;
+    int size;
+    int capacity;
+} Staircase;
+
+// Index of the first step with f2 > value
+static int staircase_upper(const Staircase* s, double value) {
+    int lo = 0, hi = s->size;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s->f2[mid] <= value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Points are visited in lexicographic order, so every member of a front
+// already has f1 <= the query's; it dominates the query if it also wins on f2 and f3.
+static int staircase_dominates(const Staircase* s, const double* f) {
+    int pos = staircase_upper(s, f[1]);
+    return pos > 0 && s->f3[pos - 1] <= f[2];
+}
+
+static int staircase_insert(Staircase* s, const double* f) {
+    int pos = staircase_upper(s, f[1]);
+    // Later steps that the new point beats on both f2 and f3 are no longer needed
+    int end = pos;
+    while (end < s->size && s->f3[end] >= f[2]) end++;
+    int removed = end - pos;
+    if (removed == 0 && s->size == s->capacity) {
+        int capacity = s->capacity ? s->capacity * 2 : 8;
+        double* f2 = (double*)realloc(s->f2, sizeof(double) * (size_t)capacity);
+        if (!f2) return -1;
+        s->f2 = f2;
+        double* f3 = (double*)realloc(s->f3, sizeof(double) * (size_t)capacity);
+        if (!f3) return -1;
+        s->f3 = f3;
+        s->capacity = capacity;
+    }
+    if (removed != 1) {
+        memmove(s->f2 + pos + 1, s->f2 + end, sizeof(double) * (size_t)(s->size - end));
+        memmove(s->f3 + pos + 1, s->f3 + end, sizeof(double) * (size_t)(s->size - end));
+        s->size += 1 - removed;
+    }
+    s->f2[pos] = f[1];
+    s->f3[pos] = f[2];
+    return 0;
+}
+
+int nondominated_sort(const double* objectives, int count, int m, int32_t* out_rank) {
+    if (!objectives || !out_rank || count < 0 || m < 2 || m > 3) return -1;
+    if (count == 0) return 0;
+
+    NdsPoint* points = (NdsPoint*)malloc(sizeof(NdsPoint) * (size_t)count);
+    Staircase* fronts = (Staircase*)calloc((size_t)count, sizeof(Staircase));
+    int num_fronts = 0;
+    int rc = -1;
+    if (!points || !fronts) goto done;
+
+    for (int i = 0; i < count; i++) {
+        points[i].f[0] = objectives[(size_t)i * m];
+        points[i].f[1] = objectives[(size_t)i * m + 1];
+        points[i].f[2] = m == 3 ? objectives[(size_t)i * m + 2] : 0.0;
+        points[i].index = i;
+    }
+    qsort(points, (size_t)count, sizeof(NdsPoint), compare_nds_point);
+
+    for (int i = 0; i < count; i++) {
+        const double* f = points[i].f;
+        // Identical points never dominate each other and share a front
+        if (i > 0 && memcmp(f, points[i - 1].f, sizeof(points[i].f)) == 0) {
+            out_rank[points[i].index] = out_rank[points[i - 1].index];
+            continue;
+        }
+        // If front k dominates the point, so does every front before it:
+        // binary search for the first front that does not.
+        int lo = 0, hi = num_fronts;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (staircase_dominates(&fronts[mid], f)) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == num_fronts) num_fronts++;
+        if (staircase_insert(&fronts[lo], f) != 0) goto done;
+        out_rank[points[i].index] = lo;
+    }
+    rc = num_fronts;
+
+done:
+    if (fronts) {
+        for (int i = 0; i < num_fronts; i++) {
+            free(fronts[i].f2);
+            free(fronts[i].f3);
+        }
+    }
+    free(fronts);
+    free(points);
+    return rc;
+}
+
+typedef struct {
+    double key;
+    int32_t index;
+} KeyedIndex;
+
+static int compare_keyed_index(const void* a, const void* b) {
+    const KeyedIndex* x = (const KeyedIndex*)a;
+    const KeyedIndex* y = (const KeyedIndex*)b;
+    if (x->key < y->key) return -1;
+    if (x->key > y->key) return 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+int crowding_distance(const double* objectives, const int32_t* ranks, int count, int m, double* out_distance) {
+    if (!objectives || !ranks || !out_distance || count < 0 || m <= 0) return -1;
+    if (count == 0) return 0;
+
+    // Group point indices by front with a counting sort
+    int32_t num_fronts = 0;
+    for (int i = 0; i < count; i++) {
+        if (ranks[i] < 0) return -1;
+        if (ranks[i] + 1 > num_fronts) num_fronts = ranks[i] + 1;
+    }
+    int32_t* start = (int32_t*)calloc((size_t)num_fronts + 1, sizeof(int32_t));
+    int32_t* order = (int32_t*)malloc(sizeof(int32_t) * (size_t)count);
+    KeyedIndex* keyed = (KeyedIndex*)malloc(sizeof(KeyedIndex) * (size_t)count);
+    if (!start || !order || !keyed) {
+        free(start);
+        free(order);
+        free(keyed);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) start[ranks[i] + 1]++;
+    for (int32_t r = 0; r < num_fronts; r++) start[r + 1] += start[r];
+    for (int i = 0; i < count; i++) out_distance[i] = 0.0;
+    {
+        int32_t* fill = (int32_t*)malloc(sizeof(int32_t) * (size_t)num_fronts);
+        if (!fill) {
+            free(start);
+            free(order);
+            free(keyed);
+            return -1;
+        }
+        memcpy(fill, start, sizeof(int32_t) * (size_t)num_fronts);
+        for (int i = 0; i < count; i++) order[fill[ranks[i]]++] = i;
+        free(fill);
+    }
+
+    for (int32_t r = 0; r < num_fronts; r++) {
+        int32_t lo = start[r], n = start[r + 1] - start[r];
+        if (n == 0) continue;
+        for (int obj = 0; obj < m; obj++) {
+            for (int32_t j = 0; j < n; j++) {
+                keyed[j].index = order[lo + j];
+                keyed[j].key = objectives[(size_t)order[lo + j] * m + obj];
+            }
+            qsort(keyed, (size_t)n, sizeof(KeyedIndex), compare_keyed_index);
+            out_distance[keyed[0].index] = INFINITY;
+            out_distance[keyed[n - 1].index] = INFINITY;
+            double span = keyed[n - 1].key - keyed[0].key;
+            if (span <= 0.0) continue;
+            for (int32_t j = 1; j < n - 1; j++) {
+                out_distance[keyed[j].index] += (keyed[j + 1].key - keyed[j - 1].key) / span;
+            }
+        }
+    }
+    free(start);
+    free(order);
+    free(keyed);
+    return 0;
+}
+
+// --- Streaming score statistics ---
+
+// KLL sketch: level h holds values of weight 2^h. When a level reaches its
+// capacity it is sorted and every other value (random parity) is promoted to
+// the next level. Capacities shrink geometrically (2/3) below the top level.
+struct ScoreStats {
+    uint64_t count;
+    double mean;
+    double m2;
+    double sum;
+    double sum_error;  // Neumaier compensation term of `sum`
+    double min;
+    double max;
+    int k;
+    uint64_t rng;
+    int levels;
+    int size[SCORE_STATS_MAX_LEVELS];
+    int alloc[SCORE_STATS_MAX_LEVELS];
+    double* items[SCORE_STATS_MAX_LEVELS];
+};
+
+ScoreStats* score_stats_new(int k, uint64_t seed) {
+    if (k < 8) return NULL;
+    ScoreStats* s = (ScoreStats*)calloc(1, sizeof(ScoreStats));
+    if (!s) return NULL;
+    s->k = k;
+    s->rng = seed;
+    score_stats_reset(s);
+    return s;
+}
+
+void score_stats_free(ScoreStats* s) {
+    if (!s) return;
+    for (int h = 0; h < SCORE_STATS_MAX_LEVELS; h++) free(s->items[h]);
+    free(s);
+}
+
+void score_stats_reset(ScoreStats* s) {
+    if (!s) return;
+    s->count = 0;
+    s->mean = 0.0;
+    s->m2 = 0.0;
+    s->sum = 0.0;
+    s->sum_error = 0.0;
+    s->min = INFINITY;
+    s->max = -INFINITY;
+    s->levels = 1;
+    memset(s->size, 0, sizeof(s->size));
+}
+
+static int kll_capacity(const ScoreStats* s, int level) {
+    double cap = ceil(s->k * pow(2.0 / 3.0, s->levels - 1 - level));
+    return cap < 2.0 ? 2 : (int)cap;
+}
+
+static int kll_reserve(ScoreStats* s, int level, int extra) {
+    int needed = s->size[level] + extra;
+    if (needed <= s->alloc[level]) return 0;
+    int alloc = s->alloc[level] ? s->alloc[level] : s->k;
+    while (alloc < needed) alloc *= 2;
+    double* items = (double*)realloc(s->items[level], sizeof(double) * (size_t)alloc);
+    if (!items) return -1;
+    s->items[level] = items;
+    s->alloc[level] = alloc;
+    return 0;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int kll_compress(ScoreStats* s) {
+    for (int h = 0; h < s->levels; h++) {
+        if (s->size[h] < kll_capacity(s, h)) continue;
+        if (h + 1 == s->levels) {
+            if (s->levels == SCORE_STATS_MAX_LEVELS) return -1;
+            s->levels++;
+        }
+        double* items = s->items[h];
+        qsort(items, (size_t)s->size[h], sizeof(double), compare_double);
+        // An odd value out (the smallest) stays behind at this level
+        int keep = s->size[h] & 1;
+        int pairs = (s->size[h] - keep) / 2;
+        if (kll_reserve(s, h + 1, pairs) != 0) return -1;
+        int parity = (int)(rng_next(&s->rng) & 1);
+        double* up = s->items[h + 1] + s->size[h + 1];
+        for (int i = 0; i < pairs; i++) up[i] = items[keep + 2 * i + parity];
+        s->size[h + 1] += pairs;
+        s->size[h] = keep;
+    }
+    return 0;
+}
+
+static inline void sum_add(ScoreStats* s, double value) {
+    double t = s->sum + value;
+    s->sum_error += fabs(s->sum) >= fabs(value) ? (s->sum - t) + value : (value - t) + s->sum;
+    s->sum = t;
+}
+
+static inline void moments_add(ScoreStats* s, double value) {
+    s->count++;
+    sum_add(s, value);
+    double delta = value - s->mean;
+    s->mean += delta / (double)s->count;
+    s->m2 += delta * (value - s->mean);
+    if (value < s->min) s->min = value;
+    if (value > s->max) s->max = value;
+}
+
+int score_stats_add(ScoreStats* s, double value) {
+    if (!s || isnan(value)) return -1;
+    if (kll_reserve(s, 0, 1) != 0) return -1;
+    moments_add(s, value);
+    s->items[0][s->size[0]++] = value;
+    return s->size[0] >= kll_capacity(s, 0) ? kll_compress(s) : 0;
+}
+
+int score_stats_add_many(ScoreStats* s, const double* values, int count) {
+    if (!s || (!values && count > 0) || count < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        if (score_stats_add(s, values[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+int score_stats_merge(ScoreStats* s, const ScoreStats* other) {
+    if (!s || !other || s->k != other->k) return -1;
+    if (other->count == 0) return 0;
+    if (other->levels > s->levels) s->levels = other->levels;
+    for (int h = 0; h < other->levels; h++) {
+        if (kll_reserve(s, h, other->size[h]) != 0) return -1;
+        memcpy(s->items[h] + s->size[h], other->items[h], sizeof(double) * (size_t)other->size[h]);
+        s->size[h] += other->size[h];
+    }
+    // Chan et al. pairwise update of the moments
+    double n_a = (double)s->count, n_b = (double)other->count, n = n_a + n_b;
+    double delta = other->mean - s->mean;
+    s->mean += delta * n_b / n;
+    s->m2 += other->m2 + delta * delta * n_a * n_b / n;
+    s->count += other->count;
+    sum_add(s, other->sum);
+    sum_add(s, other->sum_error);
+    if (other->min < s->min) s->min = other->min;
+    if (other->max > s->max) s->max = other->max;
+    return kll_compress(s);
+}
+
+void score_stats_summary(const ScoreStats* s, ScoreSummary* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(ScoreSummary));
+    if (!s || s->count == 0) return;
+    out->count = s->count;
+    out->mean = s->mean;
+    out->variance = s->count > 1 ? s->m2 / (double)s->count : 0.0;
+    out->min = s->min;
+    out->max = s->max;
+    out->sum = s->sum + s->sum_error;
+}
+
+typedef struct {
+    double value;
+    uint64_t weight;
+} WeightedValue;
+
+static int compare_weighted_value(const void* a, const void* b) {
+    return compare_double(&((const WeightedValue*)a)->value, &((const WeightedValue*)b)->value);
+}
+
+int score_stats_quantiles(const ScoreStats* s, const double* qs, int n, double* out) {
+    if (!s || !qs || !out || n < 0 || s->count == 0) return -1;
+    int total = 0;
+    for (int h = 0; h < s->levels; h++) total += s->size[h];
+    WeightedValue* points = (WeightedValue*)malloc(sizeof(WeightedValue) * (size_t)total);
+    if (!points) return -1;
+    int p = 0;
+    uint64_t weight_sum = 0;
+    for (int h = 0; h < s->levels; h++) {
+        for (int i = 0; i < s->size[h]; i++) {
+            points[p].value = s->items[h][i];
+            points[p].weight = 1ULL << h;
+            weight_sum += points[p++].weight;
+        }
+    }
+    qsort(points, (size_t)total, sizeof(WeightedValue), compare_weighted_value);
+
+    for (int j = 0; j < n; j++) {
+        double q = qs[j];
+        if (!(q >= 0.0 && q <= 1.0)) { free(points); return -1; }
+        if (q == 0.0) { out[j] = s->min; continue; }
+        if (q == 1.0) { out[j] = s->max; continue; }
+        double rank = q * (double)weight_sum;
+        uint64_t seen = 0;
+        out[j] = s->max;
+        for (int i = 0; i < total; i++) {
+            seen += points[i].weight;
+            if ((double)seen >= rank) { out[j] = points[i].value; break; }
+        }
+    }
+    free(points);
+    return 0;
+}
+
+
+// --- Hardware performance counters ---
+
+struct PerfCounters {
+    int fds[PERF_COUNTER_COUNT];
+    uint64_t base[PERF_COUNTER_COUNT][3];  // value, time enabled, time running at start
+};
+
+#if defined(__linux__)
+
+static const uint64_t perf_event_configs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+static int perf_read(int fd, uint64_t out[3]) {
+    return read(fd, out, sizeof(uint64_t) * 3) == (ssize_t)(sizeof(uint64_t) * 3) ? 0 : -1;
+}
+
+PerfCounters* perf_counters_open(int inherit, int* error) {
+    if (error) *error = 0;
+    PerfCounters* c = (PerfCounters*)calloc(1, sizeof(PerfCounters));
+    if (!c) {
+        if (error) *error = ENOMEM;
+        return NULL;
+    }
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = perf_event_configs[i];
+        attr.inherit = inherit ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        c->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (c->fds[i] < 0) {
+            if (error && !*error) *error = errno;
+            continue;
+        }
+        opened++;
+    }
+    if (!opened) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void perf_counters_free(PerfCounters* c) {
+    if (!c) return;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (c->fds[i] >= 0) close(c->fds[i]);
+    }
+    free(c);
+}
+
+int perf_counters_start(PerfCounters* c) {
+    if (!c) return -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (c->fds[i] >= 0 && perf_read(c->fds[i], c->base[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+int perf_counters_stop(PerfCounters* c, int64_t out[PERF_COUNTER_COUNT]) {
+    if (!c || !out) return -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t now[3];
+        out[i] = -1;
+        if (c->fds[i] < 0) continue;
+        if (perf_read(c->fds[i], now) != 0) return -1;
+        uint64_t value = now[0] - c->base[i][0];
+        uint64_t enabled = now[1] - c->base[i][1];
+        uint64_t running = now[2] - c->base[i][2];
+        if (running == 0) continue;
+        // Scale up for the time the counter was multiplexed out
+        out[i] = running < enabled ? (int64_t)((double)value * (double)enabled / (double)running) : (int64_t)value;
+    }
+    return 0;
+}
+
+#else
+
+PerfCounters* perf_counters_open(int inherit, int* error) {
+    (void)inherit;
+    if (error) *error = -1;
+    return NULL;
+}
+
+void perf_counters_free(PerfCounters* c) { free(c); }
+
+int perf_counters_start(PerfCounters* c) { (void)c; return -1; }
+
+int perf_counters_stop(PerfCounters* c, int64_t out[PERF_COUNTER_COUNT]) { (void)c; (void)out; return -1; }
+
+#endif
+
+int perf_counters_available(const PerfCounters* c) {
+    int mask = 0;
+    if (!c) return 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (c->fds[i] >= 0) mask |= 1 << i;
+    }
+    return mask;
+}
+
+
+// --- Syscall latency profile ---
+
+struct SyscallProfile {
+    SyscallLatency stats[SYSCALL_PROFILE_KINDS][SYSCALL_PROFILE_IDS];
+    uint64_t* buckets[SYSCALL_PROFILE_KINDS][SYSCALL_PROFILE_IDS];  // Allocated on first use
+};
+
+SyscallProfile* syscall_profile_new(void) {
+    SyscallProfile* p = (SyscallProfile*)calloc(1, sizeof(SyscallProfile));
+    if (!p) return NULL;
+    syscall_profile_reset(p);
+    return p;
+}
+
+void syscall_profile_free(SyscallProfile* p) {
+    if (!p) return;
+    for (int k = 0; k < SYSCALL_PROFILE_KINDS; k++) {
+        for (int id = 0; id < SYSCALL_PROFILE_IDS; id++) free(p->buckets[k][id]);
+    }
+    free(p);
+}
+
+void syscall_profile_reset(SyscallProfile* p) {
+    if (!p) return;
+    for (int k = 0; k < SYSCALL_PROFILE_KINDS; k++) {
+        for (int id = 0; id < SYSCALL_PROFILE_IDS; id++) {
+            SyscallLatency* s = &p->stats[k][id];
+            s->count = s->total_ns = s->max_ns = 0;
+            s->min_ns = UINT64_MAX;
+            if (p->buckets[k][id]) memset(p->buckets[k][id], 0, sizeof(uint64_t) * SYSCALL_PROFILE_BUCKETS);
+        }
+    }
+}
+
+int syscall_profile_bucket_index(uint64_t ns) {
+    if (ns < (1u << SYSCALL_PROFILE_SUB_BITS)) return (int)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    int shift = exponent - SYSCALL_PROFILE_SUB_BITS;
+    int sub = (int)((ns >> shift) & ((1u << SYSCALL_PROFILE_SUB_BITS) - 1));
+    return ((shift + 1) << SYSCALL_PROFILE_SUB_BITS) | sub;
+}
+
+void syscall_profile_bucket_range(int index, uint64_t* low, uint64_t* high) {
+    uint64_t lo, hi;
+    if (index < (1 << SYSCALL_PROFILE_SUB_BITS)) {
+        lo = hi = (uint64_t)(index < 0 ? 0 : index);
+    } else {
+        int shift = (index >> SYSCALL_PROFILE_SUB_BITS) - 1;
+        uint64_t sub = (uint64_t)(index & ((1 << SYSCALL_PROFILE_SUB_BITS) - 1));
+        lo = (((uint64_t)1 << SYSCALL_PROFILE_SUB_BITS) | sub) << shift;
+        hi = lo + (((uint64_t)1 << shift) - 1);
+    }
+    if (low) *low = lo;
+    if (high) *high = hi;
+}
+
+int syscall_profile_record(SyscallProfile* p, int kind, int id, uint64_t ns) {
+    if (!p || kind < 0 || kind >= SYSCALL_PROFILE_KINDS || id < 0 || id >= SYSCALL_PROFILE_IDS) return -1;
+    uint64_t* buckets = __atomic_load_n(&p->buckets[kind][id], __ATOMIC_ACQUIRE);
+    if (!buckets) {
+        uint64_t* fresh = (uint64_t*)calloc(SYSCALL_PROFILE_BUCKETS, sizeof(uint64_t));
+        if (!fresh) return -1;
+        // Another thread may have won the race
+        if (__atomic_compare_exchange_n(&p->buckets[kind][id], &buckets, fresh, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            buckets = fresh;
+        } else {
+            free(fresh);
+        }
+    }
+    SyscallLatency* s = &p->stats[kind][id];
+    __atomic_fetch_add(&buckets[syscall_profile_bucket_index(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->total_ns, ns, __ATOMIC_RELAXED);
+    uint64_t seen = __atomic_load_n(&s->min_ns, __ATOMIC_RELAXED);
+    while (ns < seen && !__atomic_compare_exchange_n(&s->min_ns, &seen, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+    seen = __atomic_load_n(&s->max_ns, __ATOMIC_RELAXED);
+    while (ns > seen && !__atomic_compare_exchange_n(&s->max_ns, &seen, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+    return 0;
+}
+
+void syscall_profile_activate(SyscallProfile* p) {
+    syscall_profile_active = p;
+    syscall_pending_state = NULL;
+}
+
+int syscall_profile_stats(const SyscallProfile* p, int kind, int id, SyscallLatency* out) {
+    if (!p || !out || kind < 0 || kind >= SYSCALL_PROFILE_KINDS || id < 0 || id >= SYSCALL_PROFILE_IDS) return -1;
+    *out = p->stats[kind][id];
+    return 0;
+}
+
+int syscall_profile_histogram(const SyscallProfile* p, int kind, int id, uint64_t* out) {
+    if (!p || !out || kind < 0 || kind >= SYSCALL_PROFILE_KINDS || id < 0 || id >= SYSCALL_PROFILE_IDS) return -1;
+    if (p->buckets[kind][id]) {
+        memcpy(out, p->buckets[kind][id], sizeof(uint64_t) * SYSCALL_PROFILE_BUCKETS);
+    } else {
+        memset(out, 0, sizeof(uint64_t) * SYSCALL_PROFILE_BUCKETS);
+    }
+    return 0;
+}
+
+int syscall_profile_quantiles(const SyscallProfile* p, int kind, int id, const double* qs, int n, double* out) {
+    if (!p || !qs || !out || n < 0 || kind < 0 || kind >= SYSCALL_PROFILE_KINDS || id < 0 || id >= SYSCALL_PROFILE_IDS) return -1;
+    const SyscallLatency* s = &p->stats[kind][id];
+    const uint64_t* buckets = p->buckets[kind][id];
+    if (!s->count || !buckets) return -1;
+    for (int i = 0; i < n; i++) {
+        double q = qs[i] < 0.0 ? 0.0 : (qs[i] > 1.0 ? 1.0 : qs[i]);
+        uint64_t rank = (uint64_t)ceil(q * (double)s->count);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        int b = 0;
+        for (; b < SYSCALL_PROFILE_BUCKETS - 1; b++) {
+            seen += buckets[b];
+            if (seen >= rank) break;
+        }
+        uint64_t lo, hi;
+        syscall_profile_bucket_range(b, &lo, &hi);
+        double value = ((double)lo + (double)hi) / 2.0;
+        if (value < (double)s->min_ns) value = (double)s->min_ns;
+        if (value > (double)s->max_ns) value = (double)s->max_ns;
+        out[i] = value;
+    }
+    return 0;
+}
+
+
+// --- VM context ---
+
+struct VMContext {
+    uint8_t* output;
+    uint32_t capacity;
+    uint32_t length;  // Bytes buffered
+    uint32_t start;   // Oldest byte, for OUTPUT_OVERFLOW_RING
+    uint64_t total;   // Bytes written since the last reset
+    int policy;
+    uint8_t* target;  // Expected output, NULL without one
+    uint32_t target_length;
+    uint32_t max_mismatches;
+    VMOutputMatch match;
+};
+
+VMContext* vm_context_new(uint32_t output_capacity, int overflow_policy) {
+    if (overflow_policy < OUTPUT_OVERFLOW_TRUNCATE || overflow_policy > OUTPUT_OVERFLOW_STOP) return NULL;
+    VMContext* ctx = (VMContext*)calloc(1, sizeof(VMContext));
+    if (!ctx) return NULL;
+    if (output_capacity) {
+        ctx->output = (uint8_t*)malloc(output_capacity);
+        if (!ctx->output) {
+            free(ctx);
+            return NULL;
+        }
+    }
+    ctx->capacity = output_capacity;
+    ctx->policy = overflow_policy;
+    return ctx;
+}
+
+void vm_context_free(VMContext* ctx) {
+    if (!ctx) return;
+    free(ctx->output);
+    free(ctx->target);
+    free(ctx);
+}
+
+void vm_context_reset(VMContext* ctx) {
+    if (!ctx) return;
+    ctx->length = 0;
+    ctx->start = 0;
+    ctx->total = 0;
+    memset(&ctx->match, 0, sizeof(ctx->match));
+}
+
+uint64_t vm_context_output_total(const VMContext* ctx) {
+    return ctx ? ctx->total : 0;
+}
+
+int vm_context_output(const VMContext* ctx, uint8_t* out, int capacity) {
+    if (!ctx || (!out && capacity > 0) || capacity < 0) return -1;
+    uint32_t n = ctx->length < (uint32_t)capacity ? ctx->length : (uint32_t)capacity;
+    uint32_t first = ctx->capacity - ctx->start;  // Bytes before the ring wraps
+    if (first > n) first = n;
+    if (n) {
+        memcpy(out, ctx->output + ctx->start, first);
+        memcpy(out + first, ctx->output, n - first);
+    }
+    return (int)ctx->length;
+}
+
+int vm_context_flush(VMContext* ctx, int fd) {
+    if (!ctx) return -1;
+    int written = 0;
+#if defined(__linux__)
+    uint32_t first = ctx->capacity - ctx->start;
+    if (first > ctx->length) first = ctx->length;
+    const uint8_t* parts[2] = {ctx->output + ctx->start, ctx->output};
+    uint32_t sizes[2] = {first, ctx->length - first};
+    for (int i = 0; i < 2; i++) {
+        uint32_t done = 0;
+        while (done < sizes[i]) {
+            ssize_t n = write(fd, parts[i] + done, sizes[i] - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            done += (uint32_t)n;
+        }
+        written += (int)done;
+    }
+#else
+    (void)fd;
+    return -1;
+#endif
+    ctx->length = 0;
+    ctx->start = 0;
+    return written;
+}
+
+int vm_context_set_target(VMContext* ctx, const uint8_t* target, uint32_t length, uint32_t max_mismatches) {
+    if (!ctx) return -1;
+    uint8_t* copy = NULL;
+    if (target && length) {
+        copy = (uint8_t*)malloc(length);
+        if (!copy) return -1;
+        memcpy(copy, target, length);
+    }
+    free(ctx->target);
+    ctx->target = copy;
+    ctx->target_length = copy ? length : 0;
+    ctx->max_mismatches = max_mismatches;
+    memset(&ctx->match, 0, sizeof(ctx->match));
+    return 0;
+}
+
+int vm_context_match(const VMContext* ctx, VMOutputMatch* out) {
+    if (!ctx || !out || !ctx->target) return -1;
+    *out = ctx->match;
+    return 0;
+}
+
+// Compares byte `c` written at `position`; returns false once the output diverged
+static inline bool output_match_byte(VMOutputMatch* m, const uint8_t* target, uint32_t target_length,
+                                     uint32_t max_mismatches, uint64_t position, uint8_t c) {
+    if (position < target_length && target[position] == c) {
+        m->matched++;
+        if (m->prefix == position) m->prefix++;
+        return true;
+    }
+    return ++m->mismatches <= max_mismatches;
+}
+
+static inline bool vm_context_match_byte(VMContext* ctx, uint64_t position, uint8_t c) {
+    return output_match_byte(&ctx->match, ctx->target, ctx->target_length, ctx->max_mismatches, position, c);
+}
+
+// Appends one byte; returns false when the VM must stop with `*interrupt`
+static inline bool vm_context_putc(VMContext* ctx, uint8_t c, int* interrupt) {
+    if (ctx->target && !vm_context_match_byte(ctx, ctx->total, c)) {
+        ctx->total++;  // Still counted as written, like a byte dropped on overflow
+        *interrupt = INTERRUPT_OUTPUT_DIVERGED;
+        return false;
+    }
+    ctx->total++;
+    if (ctx->length < ctx->capacity) {
+        uint32_t end = ctx->start + ctx->length;
+        if (end >= ctx->capacity) end -= ctx->capacity;
+        ctx->output[end] = c;
+        ctx->length++;
+        return true;
+    }
+    switch (ctx->policy) {
+        case OUTPUT_OVERFLOW_RING:
+            if (ctx->capacity) {
+                ctx->output[ctx->start] = c;
+                ctx->start = ctx->start + 1 == ctx->capacity ? 0 : ctx->start + 1;
+            }
+            return true;
+        case OUTPUT_OVERFLOW_STOP:
+            *interrupt = INTERRUPT_OUTPUT_FULL;
+            return false;
+        default:
+            return true;
+    }
+}
+
+void run_ctx(VMContext* ctx, VMState* state, const uint8_t* program, int program_len, int max_steps) {
+    for (;;) {
+        run_c(state, program, program_len, max_steps, false);
+        if (state->interrupt != SYSCALL_PUTC || !ctx) return;
+        int interrupt;
+        if (!vm_context_putc(ctx, state->registers[0], &interrupt)) {
+            state->interrupt = interrupt;
+            return;
+        }
+        if (syscall_pending_state == state) {
+            // Served here, so it is a native call rather than a Python roundtrip
+            syscall_profile_record(syscall_profile_active, SYSCALL_PROFILE_NATIVE, SYSCALL_PUTC,
+                                   monotonic_ns() - syscall_pending_ns);
+            syscall_pending_state = NULL;
+        }
+    }
+}
+
+// --- Environments ---
+
+static pthread_mutex_t vm_env_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t vm_env_builtins_once = PTHREAD_ONCE_INIT;
+static const VMEnvironment* vm_env_registry[VM_ENV_MAX_ENVIRONMENTS];
+static int vm_env_registered = 0;
+
+struct VMEnvTask {
+    const VMEnvironment* env;
+    void* task;
+};
+
+// - Built-in "maze" -
+
+typedef struct {
+    uint8_t height, width;
+    uint8_t start_y, start_x;
+    uint8_t finish_y, finish_x;
+    uint8_t walls[];  // height * width
+} MazeTask;
+
+typedef struct {
+    uint8_t player_y, player_x;
+    uint32_t total_steps;
+    uint32_t valid_moves;
+    uint32_t move_counts[4];  // w, a, s, d
+    uint32_t visited_count;
+    uint8_t visited[(MAZE_MAX_CELLS + 7) / 8];
+} MazeRun;
+
+enum { MAZE_UP, MAZE_LEFT, MAZE_DOWN, MAZE_RIGHT };  // The order of behaviour.MOVE_DIRECTIONS
+
+static void* maze_create(const uint8_t* config, uint32_t config_len) {
+    if (!config || config_len < MAZE_CONFIG_HEADER) return NULL;
+    uint32_t height = config[0], width = config[1];
+    if (!height || !width || config_len != MAZE_CONFIG_HEADER + height * width) return NULL;
+    if (config[2] >= height || config[3] >= width || config[4] >= height || config[5] >= width) return NULL;
+    MazeTask* maze = (MazeTask*)malloc(sizeof(MazeTask) + height * width);
+    if (!maze) return NULL;
+    memcpy(maze, config, config_len);
+    return maze;
+}
+
+static void maze_reset(const void* task, void* run) {
+    const MazeTask* maze = (const MazeTask*)task;
+    MazeRun* r = (MazeRun*)run;
+    uint32_t cells = (uint32_t)maze->height * maze->width;
+    r->player_y = maze->start_y;
+    r->player_x = maze->start_x;
+    r->total_steps = 0;
+    r->valid_moves = 0;
+    memset(r->move_counts, 0, sizeof(r->move_counts));
+    memset(r->visited, 0, (cells + 7) / 8);
+    uint32_t start = (uint32_t)maze->start_y * maze->width + maze->start_x;
+    r->visited[start >> 3] |= (uint8_t)(1u << (start & 7));
+    r->visited_count = 1;
+}
+
+// Same rules as Maze.move
+static inline int maze_move(const MazeTask* maze, MazeRun* r, int direction, int dy, int dx) {
+    r->total_steps++;
+    r->move_counts[direction]++;
+    int ny = r->player_y + dy, nx = r->player_x + dx;
+    if (ny < 0 || ny >= maze->height || nx < 0 || nx >= maze->width) return VM_ENV_CONTINUE;
+    uint32_t cell = (uint32_t)ny * maze->width + (uint32_t)nx;
+    if (maze->walls[cell]) return VM_ENV_CONTINUE;
+    r->player_y = (uint8_t)ny;
+    r->player_x = (uint8_t)nx;
+    uint8_t bit = (uint8_t)(1u << (cell & 7));
+    if (!(r->visited[cell >> 3] & bit)) {
+        r->visited[cell >> 3] |= bit;
+        r->visited_count++;
+    }
+    r->valid_moves++;
+    return VM_ENV_CONTINUE;
+}
+
+static int maze_up(const void* task, void* run, VMState* state) {
+    (void)state;
+    return maze_move((const MazeTask*)task, (MazeRun*)run, MAZE_UP, -1, 0);
+}
+
+static int maze_down(const void* task, void* run, VMState* state) {
+    (void)state;
+    return maze_move((const MazeTask*)task, (MazeRun*)run, MAZE_DOWN, 1, 0);
+}
+
+static int maze_left(const void* task, void* run, VMState* state) {
+    (void)state;
+    return maze_move((const MazeTask*)task, (MazeRun*)run, MAZE_LEFT, 0, -1);
+}
+
+static int maze_right(const void* task, void* run, VMState* state) {
+    (void)state;
+    return maze_move((const MazeTask*)task, (MazeRun*)run, MAZE_RIGHT, 0, 1);
+}
+
+static int maze_finish_pos(const void* task, void* run, VMState* state) {
+    (void)run;
+    state->registers[0] = ((const MazeTask*)task)->finish_y;
+    state->registers[1] = ((const MazeTask*)task)->finish_x;
+    return VM_ENV_CONTINUE;
+}
+
+static int maze_player_pos(const void* task, void* run, VMState* state) {
+    (void)task;
+    state->registers[0] = ((const MazeRun*)run)->player_y;
+    state->registers[1] = ((const MazeRun*)run)->player_x;
+    return VM_ENV_CONTINUE;
+}
+
+// PUTC is available in the maze task too, but its output does not count
+static int maze_putc(const void* task, void* run, VMState* state) {
+    (void)task;
+    (void)run;
+    (void)state;
+    return VM_ENV_CONTINUE;
+}
+
+// maze_scorer.grade_maze_performance
+static int64_t maze_score(const void* task, const void* run, const VMEnvResult* result) {
+    const MazeTask* maze = (const MazeTask*)task;
+    const MazeRun* r = (const MazeRun*)run;
+    int64_t score = 0;
+    if (r->player_y == maze->finish_y && r->player_x == maze->finish_x) score += MAZE_REWARD_FINISH;
+    score += (int64_t)r->visited_count * MAZE_REWARD_UNIQUE_CELL;
+    score += (int64_t)r->valid_moves * MAZE_REWARD_VALID_MOVE;
+    score -= (int64_t)r->total_steps * MAZE_PENALTY_STEP;
+    if (result->halted) score -= MAZE_PENALTY_HALT;
+    return score;
+}
+
+// behaviour.maze_descriptor
+static void maze_describe(const void* task, const void* run, const VMEnvResult* result, double* out) {
+    const MazeTask* maze = (const MazeTask*)task;
+    const MazeRun* r = (const MazeRun*)run;
+    const int grid = 4;
+    double height = maze->height, width = maze->width;
+    double moves = r->total_steps ? r->total_steps : 1;
+    uint32_t occupancy[16] = {0};
+    for (uint32_t y = 0; y < maze->height; y++) {
+        for (uint32_t x = 0; x < maze->width; x++) {
+            uint32_t cell = y * maze->width + x;
+            if (r->visited[cell >> 3] & (1u << (cell & 7))) {
+                occupancy[(y * grid / maze->height) * grid + x * grid / maze->width]++;
+            }
+        }
+    }
+    double cells = r->visited_count;
+    out[0] = r->player_y / height;
+    out[1] = r->player_x / width;
+    out[2] = fmin(1.0, cells / (height * width / 2));
+    out[3] = fmin(1.0, (double)result->state.steps / MAZE_DESCRIPTOR_MAX_STEPS);
+    for (int d = 0; d < 4; d++) out[4 + d] = r->move_counts[d] / moves;
+    for (int i = 0; i < grid * grid; i++) out[8 + i] = occupancy[i] / cells;
+}
+
+static const VMEnvironment maze_environment = {
+    .abi_version = VM_ENV_ABI_VERSION,
+    .name = "maze",
+    .run_size = sizeof(MazeRun),
+    .descriptor_dims = MAZE_DESCRIPTOR_DIMS,
+    .create = maze_create,
+    .destroy = free,
+    .reset = maze_reset,
+    .syscalls = {
+        [SYSCALL_PUTC] = maze_putc,
+        [0x10] = maze_up, [0x11] = maze_down, [0x12] = maze_left, [0x13] = maze_right,
+        [0x14] = maze_finish_pos, [0x15] = maze_player_pos,
+    },
+    .score = maze_score,
+    .describe = maze_describe,
+};
+
+// - Built-in "putc" -
+
+typedef struct {
+    uint32_t max_mismatches;
+    uint32_t length;
+    uint8_t target[];
+} PutcTask;
+
+typedef struct {
+    uint64_t written;
+    VMOutputMatch match;
+} PutcRun;
+
+static void* putc_create(const uint8_t* config, uint32_t config_len) {
+    if (!config || config_len <= PUTC_CONFIG_HEADER) return NULL;
+    uint32_t length = config_len - PUTC_CONFIG_HEADER;
+    PutcTask* putc_task = (PutcTask*)malloc(sizeof(PutcTask) + length);
+    if (!putc_task) return NULL;
+    putc_task->max_mismatches = (uint32_t)config[0] | (uint32_t)config[1] << 8 |
+                                (uint32_t)config[2] << 16 | (uint32_t)config[3] << 24;
+    putc_task->length = length;
+    memcpy(putc_task->target, config + PUTC_CONFIG_HEADER, length);
+    return putc_task;
+}
+
+static void putc_reset(const void* task, void* run) {
+    (void)task;
+    memset(run, 0, sizeof(PutcRun));
+}
+
+static int putc_putc(const void* task, void* run, VMState* state) {
+    const PutcTask* t = (const PutcTask*)task;
+    PutcRun* r = (PutcRun*)run;
+    bool ok = output_match_byte(&r->match, t->target, t->length, t->max_mismatches, r->written++,
+                                state->registers[0]);
+    return ok ? VM_ENV_CONTINUE : INTERRUPT_OUTPUT_DIVERGED;
+}
+
+// output_scorer.grade_output_performance
+static int64_t putc_score(const void* task, const void* run, const VMEnvResult* result) {
+    const PutcTask* t = (const PutcTask*)task;
+    const VMOutputMatch* m = &((const PutcRun*)run)->match;
+    int64_t score = 0;
+    if (m->prefix == t->length && m->mismatches == 0) score += PUTC_REWARD_COMPLETE;
+    score += (int64_t)m->prefix * PUTC_REWARD_PREFIX_CHAR;
+    score += ((int64_t)m->matched - m->prefix) * PUTC_REWARD_MATCHED_CHAR;
+    score -= (int64_t)m->mismatches * PUTC_PENALTY_MISMATCH;
+    score += result->halted ? -PUTC_PENALTY_HALT : PUTC_REWARD_EXIT;
+    return score;
+}
+
+static const VMEnvironment putc_environment = {
+    .abi_version = VM_ENV_ABI_VERSION,
+    .name = "putc",
+    .run_size = sizeof(PutcRun),
+    .descriptor_dims = 0,
+    .create = putc_create,
+    .destroy = free,
+    .reset = putc_reset,
+    .syscalls = { [SYSCALL_PUTC] = putc_putc },
+    .score = putc_score,
+    .describe = NULL,
+};
+
+// - Registry -
+
+static int vm_env_register_locked(const VMEnvironment* env) {
+    if (!env || env->abi_version != VM_ENV_ABI_VERSION || !env->name || !env->create || !env->reset ||
+        !env->score || env->descriptor_dims < 0 || env->descriptor_dims > VM_ENV_MAX_DESCRIPTOR ||
+        (env->descriptor_dims && !env->describe)) {
+        return -1;
+    }
+    for (int i = 0; i < vm_env_registered; i++) {
+        if (strcmp(vm_env_registry[i]->name, env->name) == 0) return -1;
+    }
+    if (vm_env_registered == VM_ENV_MAX_ENVIRONMENTS) return -1;
+    vm_env_registry[vm_env_registered] = env;
+    return vm_env_registered++;
+}
+
+static void vm_env_register_builtins(void) {
+    pthread_mutex_lock(&vm_env_lock);
+    vm_env_register_locked(&maze_environment);
+    vm_env_register_locked(&putc_environment);
+    pthread_mutex_unlock(&vm_env_lock);
+}
+
+int vm_env_register(const VMEnvironment* env) {
+    pthread_once(&vm_env_builtins_once, vm_env_register_builtins);
+    pthread_mutex_lock(&vm_env_lock);
+    int index = vm_env_register_locked(env);
+    pthread_mutex_unlock(&vm_env_lock);
+    return index;
+}
+
+#ifdef VM_CORE_DLOPEN
+
+int vm_env_load(const char* path) {
+    if (!path) return -1;
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) return -1;
+    const VMEnvironment* (*entry)(void) = (const VMEnvironment* (*)(void))dlsym(handle, "vm_environment");
+    int index = entry ? vm_env_register(entry()) : -1;
+    if (index < 0) dlclose(handle);  // Registered environments stay loaded for good
+    return index;
+}
+
+#else
+
+int vm_env_load(const char* path) { (void)path; return -1; }
+
+#endif
+
+int vm_env_count(void) {
+    pthread_once(&vm_env_builtins_once, vm_env_register_builtins);
+    pthread_mutex_lock(&vm_env_lock);
+    int count = vm_env_registered;
+    pthread_mutex_unlock(&vm_env_lock);
+    return count;
+}
+
+const VMEnvironment* vm_env_get(int index) {
+    pthread_once(&vm_env_builtins_once, vm_env_register_builtins);
+    pthread_mutex_lock(&vm_env_lock);
+    const VMEnvironment* env = index >= 0 && index < vm_env_registered ? vm_env_registry[index] : NULL;
+    pthread_mutex_unlock(&vm_env_lock);
+    return env;
+}
+
+const VMEnvironment* vm_env_find(const char* name) {
+    if (!name) return NULL;
+    pthread_once(&vm_env_builtins_once, vm_env_register_builtins);
+    const VMEnvironment* env = NULL;
+    pthread_mutex_lock(&vm_env_lock);
+    for (int i = 0; i < vm_env_registered && !env; i++) {
+        if (strcmp(vm_env_registry[i]->name, name) == 0) env = vm_env_registry[i];
+    }
+    pthread_mutex_unlock(&vm_env_lock);
+    return env;
+}
+
+VMEnvTask* vm_env_task_new(const VMEnvironment* env, const uint8_t* config, uint32_t config_len) {
+    if (!env) return NULL;
+    VMEnvTask* task = (VMEnvTask*)malloc(sizeof(VMEnvTask));
+    if (!task) return NULL;
+    task->env = env;
+    task->task = env->create(config, config_len);
+    if (!task->task) {
+        free(task);
+        return NULL;
+    }
+    return task;
+}
+
+void vm_env_task_free(VMEnvTask* task) {
+    if (!task) return;
+    if (task->env->destroy) task->env->destroy(task->task);
+    free(task);
+}
+
+// - Batch evaluation -
+
+typedef struct {
+    VMEnvTask* const* tasks;
+    const int32_t* task_index;
+    const uint8_t* programs;
+    const int32_t* offsets;
+    int count;
+    int max_steps;
+    uint32_t run_size;  // Largest run state of the tasks
+    VMEnvResult* out;
+    atomic_int next;
+    atomic_int failed;
+    // Triage and reduction only
+    uint8_t* traces;         // COVERAGE_MAP_SIZE per program, or NULL
+    VMCrashBucket* buckets;
+    uint8_t* reduce_programs;  // Reduced in place
+    int32_t* lengths;
+    uint8_t* mismatch;       // Differential testing only
+} VMEnvBatch;
+
+// One run; with `coverage` its edges are recorded and the descriptor is skipped
+static void vm_env_run(const VMEnvTask* task, void* run, const uint8_t* program, int program_len, int max_steps,
+                       VMEnvResult* out, CoverageTrace* coverage) {
+    const VMEnvironment* env = task->env;
+    env->reset(task->task, run);
+    memset(out, 0, sizeof(*out));
+    VMState* state = &out->state;
+    state->interrupt = INTERRUPT_NONE;
+    out->exit_code = -1;
+    out->halted = 1;
+    for (;;) {
+        if (coverage) {
+            run_c_coverage(state, program, program_len, max_steps, coverage);
+        } else {
+            run_c(state, program, program_len, max_steps, false);
+        }
+        if (state->interrupt < INTERRUPT_NONE) break;
+        if (state->interrupt == INTERRUPT_NONE) continue;
+        int id = state->interrupt;
+        out->syscalls++;
+        VMEnvSyscall handler = env->syscalls[id];
+        if (!handler && id != 0) break;  // Unknown syscall, its ID stays in `interrupt`
+        int action = handler ? handler(task->task, run, state) : VM_ENV_EXIT;
+        if (action == VM_ENV_EXIT) {
+            out->exit_code = state->registers[0];
+            out->halted = 0;
+            break;
+        }
+        if (action < 0) {
+            state->interrupt = (int16_t)action;
+            break;
+        }
+    }
+    out->score = env->score(task->task, run, out);
+    if (env->describe && !coverage) env->describe(task->task, run, out, out->descriptor);
+}
+
+// Runs `worker` on up to `threads` threads, the calling one included, until the batch is done
+static int vm_env_parallel(VMEnvBatch* batch, int threads, void* (*worker)(void*)) {
+    if (threads > batch->count) threads = batch->count;
+    if (threads <= 1) {
+        worker(batch);
+        return atomic_load(&batch->failed) ? -1 : 0;
+    }
+    pthread_t* workers = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)(threads - 1));
+    if (!workers) return -1;
+    int started = 0;
+    for (; started < threads - 1; started++) {
+        if (pthread_create(&workers[started], NULL, worker, batch) != 0) break;
+    }
+    worker(batch);
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    free(workers);
+    return atomic_load(&batch->failed) ? -1 : 0;
+}
+
+static void* vm_env_worker(void* arg) {
+    VMEnvBatch* batch = (VMEnvBatch*)arg;
+    void* run = malloc(batch->run_size ? batch->run_size : 1);
+    if (!run) {
+        atomic_store(&batch->failed, 1);
+        return NULL;
+    }
+    for (;;) {
+        int i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count) break;
+        const uint8_t* program = batch->programs + batch->offsets[i];
+        int program_len = batch->offsets[i + 1] - batch->offsets[i];
+        vm_env_run(batch->tasks[batch->task_index[i]], run, program, program_len, batch->max_steps, &batch->out[i],
+                   NULL);
+    }
+    free(run);
+    return NULL;
+}
+
+int vm_env_evaluate(VMEnvTask* const* tasks, int task_count, const int32_t* task_index, const uint8_t* programs,
+                    const int32_t* offsets, int count, int max_steps, int threads, VMEnvResult* out) {
+    if (!tasks || !task_index || !offsets || !out || count < 0 || (!programs && count > 0)) return -1;
+    VMEnvBatch batch = {tasks, task_index, programs, offsets, count, max_steps, 0, out, 0, 0, NULL, NULL, NULL, NULL, NULL};
+    for (int i = 0; i < count; i++) {
+        if (task_index[i] < 0 || task_index[i] >= task_count || !tasks[task_index[i]] ||
+            offsets[i + 1] < offsets[i]) {
+            return -1;
+        }
+        uint32_t size = tasks[task_index[i]]->env->run_size;
+        if (size > batch.run_size) batch.run_size = size;
+    }
+    return vm_env_parallel(&batch, threads, vm_env_worker);
+}
+
+// --- Coverage-guided fuzzing ---
+
+// AFL's hit-count classes: 0, 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+static uint8_t coverage_classes[256];
+static pthread_once_t coverage_classes_once = PTHREAD_ONCE_INIT;
+
+static void coverage_init_classes(void) {
+    for (int n = 0; n < 256; n++) {
+        uint8_t c;
+        if (n == 0) c = 0;
+        else if (n <= 3) c = (uint8_t)(1u << (n - 1));
+        else if (n <= 7) c = 8;
+        else if (n <= 15) c = 16;
+        else if (n <= 31) c = 32;
+        else if (n <= 127) c = 64;
+        else c = 128;
+        coverage_classes[n] = c;
+    }
+}
+
+// Clears the classes of `trace` that are new from `virgin` and zeroes `trace`
+// for the next run, so the map never needs a full memset between runs
+static int coverage_merge(uint8_t* trace, uint8_t* virgin) {
+    int result = COVERAGE_NONE;
+    uint64_t* words = (uint64_t*)trace;
+    for (int w = 0; w < COVERAGE_MAP_SIZE / 8; w++) {
+        if (!words[w]) continue;  // Most of the map is untouched
+        for (int i = w * 8; i < w * 8 + 8; i++) {
+            if (!trace[i]) continue;
+            uint8_t c = coverage_classes[trace[i]];
+            if (c & virgin[i]) {
+                if (virgin[i] == 0xFF) result = COVERAGE_NEW_EDGE;
+                else if (result == COVERAGE_NONE) result = COVERAGE_NEW_COUNT;
+                virgin[i] &= (uint8_t)~c;
+            }
+        }
+        words[w] = 0;
+    }
+    return result;
+}
+
+int vm_env_fuzz(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+                uint8_t* virgin, uint8_t* out_new, VMEnvResult* out) {
+    if (!task || !offsets || !virgin || !out_new || !out || count < 0 || (!programs && count > 0)) return -1;
+    pthread_once(&coverage_classes_once, coverage_init_classes);
+    void* run = malloc(task->env->run_size ? task->env->run_size : 1);
+    uint8_t* map = (uint8_t*)aligned_alloc(64, COVERAGE_MAP_SIZE);
+    if (!run || !map) {
+        free(run);
+        free(map);
+        return -1;
+    }
+    memset(map, 0, COVERAGE_MAP_SIZE);
+    int interesting = 0;
+    for (int i = 0; i < count; i++) {
+        if (offsets[i + 1] < offsets[i]) {
+            interesting = -1;
+            break;
+        }
+        CoverageTrace trace = {map, 0};
+        vm_env_run(task, run, programs + offsets[i], offsets[i + 1] - offsets[i], max_steps, &out[i], &trace);
+        out_new[i] = (uint8_t)coverage_merge(map, virgin);
+        if (out_new[i]) interesting++;
+    }
+    free(run);
+    free(map);
+    return interesting;
+}
+
+// - Havoc -
+
+static const uint8_t fuzz_interesting_bytes[] = {0x00, 0x01, 0x02, 0x0F, 0x10, 0x7F, 0x80, 0xF0, 0xFF};
+
+static inline int fuzz_below(uint64_t* rng, int n) {
+    return (int)(rng_next(rng) % (uint64_t)n);
+}
+
+int fuzz_outcome_index(const VMEnvResult* result) {
+    if (!result) return -1;
+    if (!result->halted) return result->exit_code & 0xFF;
+    int interrupt = result->state.interrupt;
+    if (interrupt < 0) return 256 + (interrupt < -15 ? 15 : -interrupt);
+    return 272 + (interrupt & 0xFF);
+}
+
+// One havoc mutation of child[0 .. *length), an even length of at least one
+// instruction; only whole instructions are inserted, moved or deleted
+static void fuzz_mutate(uint8_t* child, int* length, uint64_t* rng) {
+    int n = *length / INSTRUCTION_LENGTH;
+    int block = 1 + fuzz_below(rng, n < 4 ? n : 4);
+    uint8_t saved[4 * INSTRUCTION_LENGTH];
+    switch (fuzz_below(rng, 10)) {
+    case 0:  // Flip a bit
+        child[fuzz_below(rng, *length)] ^= (uint8_t)(1u << fuzz_below(rng, 8));
+        break;
+    case 1:  // Random byte
+        child[fuzz_below(rng, *length)] = (uint8_t)rng_next(rng);
+        break;
+    case 2:  // Interesting byte
+        child[fuzz_below(rng, *length)] =
+            fuzz_interesting_bytes[fuzz_below(rng, (int)sizeof(fuzz_interesting_bytes))];
+        break;
+    case 3: {  // Add or subtract a small value
+        int delta = 1 + fuzz_below(rng, 35);
+        uint8_t* at = child + fuzz_below(rng, *length);
+        *at = (uint8_t)(rng_next(rng) & 1 ? *at + delta : *at - delta);
+        break;
+    }
+    case 4: {  // Random instruction
+        uint8_t* at = child + fuzz_below(rng, n) * INSTRUCTION_LENGTH;
+        uint64_t r = rng_next(rng);
+        at[0] = (uint8_t)r;
+        at[1] = (uint8_t)(r >> 8);
+        break;
+    }
+    case 5: {  // Insert a random instruction
+        if (*length + INSTRUCTION_LENGTH > FUZZ_MAX_PROGRAM) break;
+        int at = fuzz_below(rng, n + 1) * INSTRUCTION_LENGTH;
+        memmove(child + at + INSTRUCTION_LENGTH, child + at, (size_t)(*length - at));
+        uint64_t r = rng_next(rng);
+        child[at] = (uint8_t)r;
+        child[at + 1] = (uint8_t)(r >> 8);
+        *length += INSTRUCTION_LENGTH;
+        break;
+    }
+    case 6: {  // Delete a block, keeping at least one instruction
+        if (block >= n) block = n - 1;
+        if (block <= 0) break;
+        int at = fuzz_below(rng, n - block + 1) * INSTRUCTION_LENGTH;
+        int size = block * INSTRUCTION_LENGTH;
+        memmove(child + at, child + at + size, (size_t)(*length - at - size));
+        *length -= size;
+        break;
+    }
+    case 7: {  // Duplicate a block somewhere else
+        int size = block * INSTRUCTION_LENGTH;
+        if (*length + size > FUZZ_MAX_PROGRAM) break;
+        memcpy(saved, child + fuzz_below(rng, n - block + 1) * INSTRUCTION_LENGTH, (size_t)size);
+        int at = fuzz_below(rng, n + 1) * INSTRUCTION_LENGTH;
+        memmove(child + at + size, child + at, (size_t)(*length - at));
+        memcpy(child + at, saved, (size_t)size);
+        *length += size;
+        break;
+    }
+    case 8: {  // Overwrite a block with another part of the program
+        int from = fuzz_below(rng, n - block + 1) * INSTRUCTION_LENGTH;
+        int to = fuzz_below(rng, n - block + 1) * INSTRUCTION_LENGTH;
+        memmove(child + to, child + from, (size_t)(block * INSTRUCTION_LENGTH));
+        break;
+    }
+    default: {  // Swap two instructions
+        uint8_t* a = child + fuzz_below(rng, n) * INSTRUCTION_LENGTH;
+        uint8_t* b = child + fuzz_below(rng, n) * INSTRUCTION_LENGTH;
+        uint8_t t0 = a[0], t1 = a[1];
+        a[0] = b[0];
+        a[1] = b[1];
+        b[0] = t0;
+        b[1] = t1;
+        break;
+    }
+    }
+}
+
+// The least fuzzed of a few sampled corpus entries
+static int fuzz_pick(uint32_t* fuzzed, int corpus_count, uint64_t* rng) {
+    int best = fuzz_below(rng, corpus_count);
+    for (int k = 1; k < 4; k++) {
+        int i = fuzz_below(rng, corpus_count);
+        if (fuzzed[i] < fuzzed[best]) best = i;
+    }
+    fuzzed[best]++;
+    return best;
+}
+
+int vm_env_fuzz_havoc(const VMEnvTask* task, const uint8_t* corpus, const int32_t* offsets, int corpus_count,
+                      uint32_t* fuzzed, int executions, int max_steps, double splice_rate, uint64_t* rng,
+                      uint8_t* virgin, uint64_t* outcome_counts, uint8_t* children, int children_capacity,
+                      VMFuzzFind* finds, int max_finds, int* executed) {
+    if (!task || !corpus || !offsets || corpus_count <= 0 || !fuzzed || executions < 0 || !rng || !virgin ||
+        !outcome_counts || !children || !finds || max_finds <= 0 || !executed) {
+        return -1;
+    }
+    *executed = 0;
+    for (int i = 0; i < corpus_count; i++) {
+        if (offsets[i + 1] < offsets[i]) return -1;
+    }
+    pthread_once(&coverage_classes_once, coverage_init_classes);
+    void* run = malloc(task->env->run_size ? task->env->run_size : 1);
+    uint8_t* map = (uint8_t*)aligned_alloc(64, COVERAGE_MAP_SIZE);
+    uint8_t* child = (uint8_t*)malloc(FUZZ_MAX_PROGRAM);
+    if (!run || !map || !child) {
+        free(run);
+        free(map);
+        free(child);
+        return -1;
+    }
+    memset(map, 0, COVERAGE_MAP_SIZE);
+    VMEnvResult result;
+    int found = 0, used = 0, done = 0;
+    while (done < executions && found < max_finds && used + FUZZ_MAX_PROGRAM <= children_capacity) {
+        int parent = fuzz_pick(fuzzed, corpus_count, rng);
+        const uint8_t* head = corpus + offsets[parent];
+        int length = offsets[parent + 1] - offsets[parent];
+        if (length > FUZZ_MAX_PROGRAM) length = FUZZ_MAX_PROGRAM;
+        length &= ~(INSTRUCTION_LENGTH - 1);
+        memcpy(child, head, (size_t)length);
+        if (corpus_count > 1 && (double)(rng_next(rng) >> 11) * 0x1.0p-53 < splice_rate) {
+            // One-point crossover on an instruction boundary, as GeneticAlgo._crossover
+            int other = fuzz_below(rng, corpus_count);
+            int other_length = offsets[other + 1] - offsets[other];
+            if (other_length > FUZZ_MAX_PROGRAM) other_length = FUZZ_MAX_PROGRAM;
+            other_length &= ~(INSTRUCTION_LENGTH - 1);
+            int shorter = length < other_length ? length : other_length;
+            int cut = fuzz_below(rng, shorter / INSTRUCTION_LENGTH + 1) * INSTRUCTION_LENGTH;
+            memcpy(child + cut, corpus + offsets[other] + cut, (size_t)(other_length - cut));
+            length = other_length;
+        }
+        if (length == 0) {
+            uint64_t r = rng_next(rng);
+            child[0] = (uint8_t)r;
+            child[1] = (uint8_t)(r >> 8);
+            length = INSTRUCTION_LENGTH;
+        }
+        int stack = 1 << (1 + fuzz_below(rng, FUZZ_HAVOC_STACK_POW2));
+        for (int m = 0; m < stack; m++) fuzz_mutate(child, &length, rng);
+
+        CoverageTrace trace = {map, 0};
+        vm_env_run(task, run, child, length, max_steps, &result, &trace);
+        int coverage = coverage_merge(map, virgin);
+        int outcome = fuzz_outcome_index(&result);
+        if (outcome_counts[outcome]++ == 0 || coverage != COVERAGE_NONE) {
+            finds[found++] = (VMFuzzFind){parent, done, used, length, outcome, (uint8_t)coverage};
+            memcpy(children + used, child, (size_t)length);
+            used += length;
+        }
+        done++;
+    }
+    free(run);
+    free(map);
+    free(child);
+    *executed = done;
+    return found;
+}
+
+int coverage_edges(const uint8_t* virgin) {
+    if (!virgin) return -1;
+    int edges = 0;
+    for (int i = 0; i < COVERAGE_MAP_SIZE; i++) edges += virgin[i] != 0xFF;
+    return edges;
+}
+
+// --- Triage ---
+
+void crash_bucket(const VMState* state, const uint8_t* program, int program_len, VMCrashBucket* out) {
+    // Most interrupts are raised after the pc moved past the instruction
+    int pc = state->pc;
+    if (state->interrupt != INTERRUPT_ILLEGAL_PC && state->interrupt != INTERRUPT_MAX_STEPS && pc >= INSTRUCTION_LENGTH) {
+        pc -= INSTRUCTION_LENGTH;
+    }
+    out->interrupt = state->interrupt;
+    out->pc = (uint16_t)pc;
+    out->opcode = pc + INSTRUCTION_LENGTH <= program_len ? ((const Instruction*)(program + pc))->op_imm.op : 0xFF;
+}
+
+static inline bool crash_bucket_equal(const VMCrashBucket* a, const VMCrashBucket* b) {
+    return a->interrupt == b->interrupt && a->pc == b->pc && a->opcode == b->opcode;
+}
+
+static void* vm_env_triage_worker(void* arg) {
+    VMEnvBatch* batch = (VMEnvBatch*)arg;
+    const VMEnvTask* task = batch->tasks[0];
+    void* run = malloc(batch->run_size ? batch->run_size : 1);
+    uint8_t* scratch = batch->traces ? NULL : (uint8_t*)malloc(COVERAGE_MAP_SIZE);
+    if (!run || (!batch->traces && !scratch)) {
+        free(run);
+        free(scratch);
+        atomic_store(&batch->failed, 1);
+        return NULL;
+    }
+    for (;;) {
+        int i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count) break;
+        const uint8_t* program = batch->programs + batch->offsets[i];
+        int program_len = batch->offsets[i + 1] - batch->offsets[i];
+        uint8_t* map = batch->traces ? batch->traces + (size_t)i * COVERAGE_MAP_SIZE : scratch;
+        memset(map, 0, COVERAGE_MAP_SIZE);
+        CoverageTrace trace = {map, 0};
+        vm_env_run(task, run, program, program_len, batch->max_steps, &batch->out[i], &trace);
+        for (int j = 0; j < COVERAGE_MAP_SIZE; j++) map[j] = coverage_classes[map[j]];
+        crash_bucket(&batch->out[i].state, program, program_len, &batch->buckets[i]);
+    }
+    free(run);
+    free(scratch);
+    return NULL;
+}
+
+int vm_env_triage(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+                  int threads, uint8_t* traces, VMCrashBucket* buckets, VMEnvResult* out) {
+    if (!task || !offsets || !buckets || !out || count < 0 || (!programs && count > 0)) return -1;
+    for (int i = 0; i < count; i++) {
+        if (offsets[i + 1] < offsets[i]) return -1;
+    }
+    pthread_once(&coverage_classes_once, coverage_init_classes);
+    VMEnvTask* const tasks[1] = {(VMEnvTask*)task};
+    VMEnvBatch batch = {tasks, NULL, programs, offsets, count, max_steps, task->env->run_size, out, 0, 0,
+                        traces, buckets, NULL, NULL, NULL};
+    return vm_env_parallel(&batch, threads, vm_env_triage_worker);
+}
+
+int coverage_minimize(const uint8_t* traces, int count, const int32_t* sizes, uint8_t* keep) {
+    if (!traces || !sizes || !keep || count < 0) return -1;
+    // For every (edge, hit-count class) tuple, the smallest program that has it
+    int32_t* best = (int32_t*)malloc(sizeof(int32_t) * COVERAGE_MAP_SIZE * 8);
+    if (!best) return -1;
+    for (int t = 0; t < COVERAGE_MAP_SIZE * 8; t++) best[t] = -1;
+    for (int i = 0; i < count; i++) {
+        const uint8_t* map = traces + (size_t)i * COVERAGE_MAP_SIZE;
+        for (int e = 0; e < COVERAGE_MAP_SIZE; e++) {
+            if (!map[e]) continue;
+            int t = e * 8 + __builtin_ctz(map[e]);  // Classified counts have a single bit set
+            if (best[t] < 0 || sizes[i] < sizes[best[t]]) best[t] = i;
+        }
+    }
+    // Greedy cover as in afl-cmin: walk the tuples and keep the best program of
+    // each one not yet covered, which covers all of that program's tuples too
+    uint8_t* covered = (uint8_t*)calloc(COVERAGE_MAP_SIZE, 1);
+    if (!covered) {
+        free(best);
+        return -1;
+    }
+    memset(keep, 0, (size_t)count);
+    int kept = 0;
+    for (int t = 0; t < COVERAGE_MAP_SIZE * 8; t++) {
+        int i = best[t];
+        if (i < 0 || (covered[t / 8] & (1u << (t % 8)))) continue;
+        keep[i] = 1;
+        kept++;
+        const uint8_t* map = traces + (size_t)i * COVERAGE_MAP_SIZE;
+        for (int e = 0; e < COVERAGE_MAP_SIZE; e++) covered[e] |= map[e];
+    }
+    free(covered);
+    free(best);
+    return kept;
+}
+
+// Whether a reduction candidate still shows what is being reduced for
+typedef bool (*ReducePredicate)(void* arg, const uint8_t* program, int program_len);
+
+// Delta debugging over whole instructions: drop ever smaller chunks, then blank
+// single instructions to NOP, keeping each change the predicate still holds for.
+// An odd trailing byte is dropped first if the predicate allows, and otherwise
+// kept after the instructions. `candidate` must hold `length` bytes. Returns
+// the new length.
+static int reduce_program(uint8_t* program, int length, uint8_t* candidate, ReducePredicate keep, void* arg) {
+    int words = length / INSTRUCTION_LENGTH;
+    int tail = length - words * INSTRUCTION_LENGTH;
+    if (tail && keep(arg, program, words * INSTRUCTION_LENGTH)) tail = 0;
+    for (int chunk = words / 2; chunk >= 1; chunk /= 2) {
+        for (int start = 0; start + chunk <= words && words > 1;) {
+            int remove = chunk < words ? chunk : words - 1;
+            int head = start * INSTRUCTION_LENGTH, cut = remove * INSTRUCTION_LENGTH;
+            memcpy(candidate, program, (size_t)head);
+            memcpy(candidate + head, program + head + cut, (size_t)(words * INSTRUCTION_LENGTH + tail - head - cut));
+            int candidate_len = (words - remove) * INSTRUCTION_LENGTH + tail;
+            if (keep(arg, candidate, candidate_len)) {
+                memcpy(program, candidate, (size_t)candidate_len);
+                words -= remove;
+            } else {
+                start += chunk;
+            }
+        }
+    }
+    length = words * INSTRUCTION_LENGTH + tail;
+    for (int w = 0; w < words; w++) {
+        uint8_t* word = program + w * INSTRUCTION_LENGTH;
+        if (!word[0] && !word[1]) continue;  // Already a NOP
+        uint8_t saved[INSTRUCTION_LENGTH];
+        memcpy(saved, word, INSTRUCTION_LENGTH);
+        memset(word, 0, INSTRUCTION_LENGTH);
+        if (!keep(arg, program, length)) memcpy(word, saved, INSTRUCTION_LENGTH);
+    }
+    return length;
+}
+
+typedef struct {
+    const VMEnvTask* task;
+    void* run;
+    int max_steps;
+    VMCrashBucket bucket;
+} BucketReduction;
+
+static bool same_bucket(void* arg, const uint8_t* program, int program_len) {
+    BucketReduction* r = (BucketReduction*)arg;
+    VMEnvResult result;
+    VMCrashBucket bucket;
+    vm_env_run(r->task, r->run, program, program_len, r->max_steps, &result, NULL);
+    crash_bucket(&result.state, program, program_len, &bucket);
+    return crash_bucket_equal(&bucket, &r->bucket);
+}
+
+static int vm_env_reduce_one(const VMEnvTask* task, void* run, uint8_t* program, int length, int max_steps,
+                             uint8_t* candidate) {
+    BucketReduction r = {task, run, max_steps, {0, 0, 0}};
+    VMEnvResult result;
+    vm_env_run(task, run, program, length, max_steps, &result, NULL);
+    crash_bucket(&result.state, program, length, &r.bucket);
+    return reduce_program(program, length, candidate, same_bucket, &r);
+}
+
+static void* vm_env_reduce_worker(void* arg) {
+    VMEnvBatch* batch = (VMEnvBatch*)arg;
+    const VMEnvTask* task = batch->tasks[0];
+    int longest = 0;
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->lengths[i] > longest) longest = batch->lengths[i];
+    }
+    void* run = malloc(batch->run_size ? batch->run_size : 1);
+    uint8_t* candidate = (uint8_t*)malloc((size_t)longest + 1);
+    if (!run || !candidate) {
+        free(run);
+        free(candidate);
+        atomic_store(&batch->failed, 1);
+        return NULL;
+    }
+    for (;;) {
+        int i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count) break;
+        uint8_t* program = batch->reduce_programs + batch->offsets[i];
+        batch->lengths[i] = vm_env_reduce_one(task, run, program, batch->lengths[i], batch->max_steps, candidate);
+    }
+    free(run);
+    free(candidate);
+    return NULL;
+}
+
+int vm_env_reduce(const VMEnvTask* task, uint8_t* programs, const int32_t* offsets, int32_t* lengths, int count,
+                  int max_steps, int threads) {
+    if (!task || !offsets || !lengths || count < 0 || (!programs && count > 0)) return -1;
+    for (int i = 0; i < count; i++) {
+        if (lengths[i] < 0) return -1;
+    }
+    VMEnvTask* const tasks[1] = {(VMEnvTask*)task};
+    VMEnvBatch batch = {tasks, NULL, NULL, offsets, count, max_steps, task->env->run_size, NULL, 0, 0,
+                        NULL, NULL, programs, lengths, NULL};
+    return vm_env_parallel(&batch, threads, vm_env_reduce_worker);
+}
+
+// --- Differential testing ---
+
+// What one engine needs besides the program; `task` and `run` only for the environment engines
+typedef struct {
+    const VMEnvTask* task;
+    void* run;
+    uint8_t* map;     // COVERAGE_MAP_SIZE
+    VMContext* ctx;
+    uint8_t output[VM_DIFF_OUTPUT_CAPACITY];
+} VMDiffScratch;
+
+static bool vm_diff_scratch_init(VMDiffScratch* scratch, const VMEnvTask* task) {
+    scratch->task = task;
+    scratch->run = task ? malloc(task->env->run_size ? task->env->run_size : 1) : NULL;
+    scratch->map = (uint8_t*)malloc(COVERAGE_MAP_SIZE);
+    scratch->ctx = vm_context_new(VM_DIFF_OUTPUT_CAPACITY, OUTPUT_OVERFLOW_RING);
+    return (!task || scratch->run) && scratch->map && scratch->ctx;
+}
+
+static void vm_diff_scratch_free(VMDiffScratch* scratch) {
+    free(scratch->run);
+    free(scratch->map);
+    vm_context_free(scratch->ctx);
+}
+
+// Clears what only the debug path writes, the decoded fields of the last instruction
+static inline void vm_diff_clear_decode(VMState* state) {
+    state->op = state->rd = state->rs = 0;
+    state->imm4 = state->imm8 = state->imm12 = 0;
+}
+
+// Copies the architectural state member by member, leaving the decoded fields
+// and the padding after `flags` as zeroed by the caller
+static void vm_diff_copy_state(VMState* dst, const VMState* src) {
+    dst->pc = src->pc;
+    memcpy(dst->registers, src->registers, sizeof(dst->registers));
+    memcpy(dst->memory, src->memory, sizeof(dst->memory));
+    dst->interrupt = src->interrupt;
+    dst->flags = src->flags;
+    dst->steps = src->steps;
+}
+
+static void vm_diff_from_env(const VMEnvResult* result, VMDiffOutcome* out) {
+    memset(out, 0, sizeof(*out));
+    vm_diff_copy_state(&out->state, &result->state);
+    out->score = result->score;
+    out->exit_code = result->exit_code;
+    out->syscalls = result->syscalls;
+}
+
+// The syscall model of the interpreter engines: EXIT stops, PUTC writes to the
+// context and every other syscall returns at once, through the resume path
+static void vm_diff_model(int engine, VMDiffScratch* scratch, const uint8_t* program, int program_len,
+                          int max_steps, VMDiffOutcome* out) {
+    memset(out, 0, sizeof(*out));
+    vm_context_reset(scratch->ctx);
+    VMState* state = &out->state;
+    state->interrupt = INTERRUPT_NONE;
+    out->exit_code = -1;
+    CoverageTrace trace = {scratch->map, 0};
+    if (engine == VM_DIFF_COVERAGE) memset(scratch->map, 0, COVERAGE_MAP_SIZE);
+    for (;;) {
+        switch (engine) {
+            case VM_DIFF_COUNTERS: {
+                VMCounters counters;
+                memset(&counters, 0, sizeof(counters));
+                VMCounters* previous = vm_counters_active;
+                vm_counters_active = &counters;
+                run_c(state, program, program_len, max_steps, false);
+                vm_counters_active = previous;
+                break;
+            }
+            case VM_DIFF_DEBUG:
+                do {
+                    run_c(state, program, program_len, max_steps, true);
+                } while (state->interrupt == INTERRUPT_DEBUG);
+                break;
+            case VM_DIFF_COVERAGE:
+                run_c_coverage(state, program, program_len, max_steps, &trace);
+                break;
+            case VM_DIFF_CONTEXT:
+                run_ctx(scratch->ctx, state, program, program_len, max_steps);
+                break;
+            default:
+                run_c(state, program, program_len, max_steps, false);
+                break;
+        }
+        if (state->interrupt < INTERRUPT_NONE) break;
+        if (state->interrupt == INTERRUPT_NONE) continue;
+        if (state->interrupt == 0) {
+            out->syscalls++;
+            out->exit_code = state->registers[0];
+            break;
+        }
+        if (state->interrupt == SYSCALL_PUTC) {  // Counted in output_total, as run_ctx serves it
+            int interrupt;
+            if (!vm_context_putc(scratch->ctx, state->registers[0], &interrupt)) {
+                state->interrupt = (int16_t)interrupt;
+                break;
+            }
+            continue;
+        }
+        out->syscalls++;
+    }
+    vm_diff_clear_decode(state);
+    out->output_total = vm_context_output_total(scratch->ctx);
+    int length = vm_context_output(scratch->ctx, scratch->output, VM_DIFF_OUTPUT_CAPACITY);
+    out->output_hash = hash_row(scratch->output, (uint32_t)length);
+}
+
+static void vm_diff_engine(int engine, VMDiffScratch* scratch, const uint8_t* program, int program_len,
+                           int max_steps, VMDiffOutcome* out) {
+    if (engine < VM_DIFF_ENV) {
+        vm_diff_model(engine, scratch, program, program_len, max_steps, out);
+        return;
+    }
+    VMEnvResult result;
+    if (engine == VM_DIFF_ENV_BATCH) {
+        VMEnvTask* const tasks[1] = {(VMEnvTask*)scratch->task};
+        const int32_t task_index[1] = {0};
+        const int32_t offsets[2] = {0, program_len};
+        if (vm_env_evaluate(tasks, 1, task_index, program, offsets, 1, max_steps, 1, &result) != 0) {
+            memset(&result, 0, sizeof(result));
+        }
+    } else {
+        CoverageTrace trace = {scratch->map, 0};
+        if (engine == VM_DIFF_ENV_COVERAGE) memset(scratch->map, 0, COVERAGE_MAP_SIZE);
+        vm_env_run(scratch->task, scratch->run, program, program_len, max_steps, &result,
+                   engine == VM_DIFF_ENV_COVERAGE ? &trace : NULL);
+    }
+    vm_diff_from_env(&result, out);
+}
+
+// Field by field, as VMState has padding between `flags` and `steps`
+static bool vm_diff_equal(const VMDiffOutcome* a, const VMDiffOutcome* b) {
+    const VMState* x = &a->state;
+    const VMState* y = &b->state;
+    return x->pc == y->pc && !memcmp(x->registers, y->registers, sizeof(x->registers)) &&
+           !memcmp(x->memory, y->memory, sizeof(x->memory)) && x->interrupt == y->interrupt &&
+           x->flags == y->flags && x->steps == y->steps && x->op == y->op && x->rd == y->rd &&
+           x->rs == y->rs && x->imm4 == y->imm4 && x->imm8 == y->imm8 && x->imm12 == y->imm12 &&
+           a->score == b->score && a->exit_code == b->exit_code && a->syscalls == b->syscalls &&
+           a->output_total == b->output_total && a->output_hash == b->output_hash;
+}
+
+// Engines disagreeing with their reference, as a bit mask. `batch` is the
+// program's result from a threaded vm_env_evaluate, or NULL to evaluate it alone.
+static uint8_t vm_diff_mask(VMDiffScratch* scratch, const uint8_t* program, int program_len, int max_steps,
+                            const VMEnvResult* batch) {
+    VMDiffOutcome reference, outcome;
+    uint8_t mask = 0;
+    vm_diff_engine(VM_DIFF_RUN_C, scratch, program, program_len, max_steps, &reference);
+    for (int engine = VM_DIFF_RUN_C + 1; engine < VM_DIFF_ENV; engine++) {
+        vm_diff_engine(engine, scratch, program, program_len, max_steps, &outcome);
+        if (!vm_diff_equal(&outcome, &reference)) mask |= (uint8_t)(1u << engine);
+    }
+    if (!scratch->task) return mask;
+    vm_diff_engine(VM_DIFF_ENV, scratch, program, program_len, max_steps, &reference);
+    for (int engine = VM_DIFF_ENV + 1; engine < VM_DIFF_ENGINES; engine++) {
+        if (engine == VM_DIFF_ENV_BATCH && batch) {
+            vm_diff_from_env(batch, &outcome);
+        } else {
+            vm_diff_engine(engine, scratch, program, program_len, max_steps, &outcome);
+        }
+        if (!vm_diff_equal(&outcome, &reference)) mask |= (uint8_t)(1u << engine);
+    }
+    return mask;
+}
+
+int vm_diff_run(int engine, const VMEnvTask* task, const uint8_t* program, int program_len, int max_steps,
+                VMDiffOutcome* out) {
+    if (engine < 0 || engine >= VM_DIFF_ENGINES || (engine >= VM_DIFF_ENV && !task) || !out || program_len < 0 ||
+        (!program && program_len > 0)) {
+        return -1;
+    }
+    VMDiffScratch scratch;
+    if (!vm_diff_scratch_init(&scratch, task)) {
+        vm_diff_scratch_free(&scratch);
+        return -1;
+    }
+    vm_diff_engine(engine, &scratch, program, program_len, max_steps, out);
+    vm_diff_scratch_free(&scratch);
+    return 0;
+}
+
+static void* vm_diff_worker(void* arg) {
+    VMEnvBatch* batch = (VMEnvBatch*)arg;
+    VMDiffScratch scratch;
+    if (!vm_diff_scratch_init(&scratch, batch->tasks[0])) {
+        vm_diff_scratch_free(&scratch);
+        atomic_store(&batch->failed, 1);
+        return NULL;
+    }
+    for (;;) {
+        int i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count) break;
+        const uint8_t* program = batch->programs + batch->offsets[i];
+        int program_len = batch->offsets[i + 1] - batch->offsets[i];
+        batch->mismatch[i] = vm_diff_mask(&scratch, program, program_len, batch->max_steps,
+                                          batch->out ? &batch->out[i] : NULL);
+    }
+    vm_diff_scratch_free(&scratch);
+    return NULL;
+}
+
+int vm_diff(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+            int threads, uint8_t* mismatch) {
+    if (!offsets || !mismatch || count < 0 || (!programs && count > 0)) return -1;
+    for (int i = 0; i < count; i++) {
+        if (offsets[i + 1] < offsets[i]) return -1;
+    }
+    VMEnvResult* out = NULL;
+    if (task && count > 0) {
+        // The batch engine: the whole population at once, spread over the threads
+        out = (VMEnvResult*)malloc(sizeof(VMEnvResult) * (size_t)count);
+        int32_t* task_index = (int32_t*)calloc((size_t)count, sizeof(int32_t));
+        VMEnvTask* const tasks[1] = {(VMEnvTask*)task};
+        int status = out && task_index ? vm_env_evaluate(tasks, 1, task_index, programs, offsets, count, max_steps,
+                                                         threads, out) : -1;
+        free(task_index);
+        if (status != 0) {
+            free(out);
+            return -1;
+        }
+    }
+    pthread_once(&coverage_classes_once, coverage_init_classes);
+    VMEnvTask* const tasks[1] = {(VMEnvTask*)task};
+    VMEnvBatch batch = {tasks, NULL, programs, offsets, count, max_steps, 0, out, 0, 0,
+                        NULL, NULL, NULL, NULL, mismatch};
+    int status = vm_env_parallel(&batch, threads, vm_diff_worker);
+    free(out);
+    if (status != 0) return -1;
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) mismatches += mismatch[i] != 0;
+    return mismatches;
+}
+
+typedef struct {
+    VMDiffScratch* scratch;
+    int max_steps;
+    uint8_t engines;
+} DiffReduction;
+
+static bool same_mismatch(void* arg, const uint8_t* program, int program_len) {
+    DiffReduction* r = (DiffReduction*)arg;
+    return vm_diff_mask(r->scratch, program, program_len, r->max_steps, NULL) == r->engines;
+}
+
+int vm_diff_reduce(const VMEnvTask* task, uint8_t* program, int length, int max_steps, uint8_t engines) {
+    if (!program || length < 0) return -1;
+    VMDiffScratch scratch;
+    bool ready = vm_diff_scratch_init(&scratch, task);
+    uint8_t* candidate = (uint8_t*)malloc((size_t)length + 1);
+    if (!ready || !candidate) {
+        free(candidate);
+        vm_diff_scratch_free(&scratch);
+        return -1;
+    }
+    DiffReduction r = {&scratch, max_steps, engines};
+    if (vm_diff_mask(&scratch, program, length, max_steps, NULL) == engines) {
+        length = reduce_program(program, length, candidate, same_mismatch, &r);
+    }
+    vm_diff_scratch_free(&scratch);
+    free(candidate);
+    return length;
+}
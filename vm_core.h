@@ -20,6 +20,8 @@
 #define INTERRUPT_PROTECTED_REG -4
 #define INTERRUPT_UNKNOWN_OPCODE -5
 #define INTERRUPT_MEMORY_ACCESS -6
+#define INTERRUPT_OUTPUT_FULL -7
+#define INTERRUPT_OUTPUT_DIVERGED -8
 #define INTERRUPT_DEBUG 0x7FFF
 
 // Opcodes
@@ -89,6 +91,21 @@ typedef union {
  */
 void run_c(VMState* state, const uint8_t* program, int program_len, int max_steps, bool debug);
 
+// Native profiling counters, accumulated by run_c while activated
+typedef struct {
+    uint64_t run_c_calls;
+    uint64_t run_c_ns;       // Wall time inside run_c
+    uint64_t instructions;
+    uint64_t opcodes[16];    // Executions per 4-bit opcode
+    uint64_t syscalls[256];  // Syscall interrupts per ID
+} VMCounters;
+
+/**
+ * @brief Makes run_c on the calling thread add to `counters`, NULL to stop.
+ * While inactive run_c takes a separate path without any counting.
+ */
+void vm_counters_activate(VMCounters* counters);
+
 /**
  * @brief Assembles a single line of human-readable assembly into a 16-bit instruction.
  * Operands must be pre-resolved to integer strings.
@@ -108,5 +125,677 @@ int disassemble(const uint8_t* program_bytes, int program_len, char** output_str
  */
 void free_memory(void* ptr);
 
+// --- Population diversity ---
+
+// Genomes are passed as an "arena": `count` rows of `stride` bytes each, zero padded
+// past their length. `stride` must be a multiple of 8.
+
+// Summary of population diversity, filled by diversity_stats
+typedef struct {
+    double mean_distance;    // Mean pairwise Hamming distance in bits
+    uint32_t min_distance;   // Smallest pairwise distance seen
+    uint32_t max_distance;   // Largest pairwise distance seen
+    uint64_t pairs;          // Number of pairs measured (all pairs, or the sample size)
+    uint32_t unique_genomes; // Number of distinct genomes (by length and content)
+    uint32_t bit_positions;  // Number of bit positions covered by at least two genomes
+    double mean_bit_entropy; // Mean Shannon entropy (bits) over those positions
+} DiversityStats;
+
+/**
+ * @brief Computes all pairwise Hamming distances of an arena.
+ * out receives count*(count-1)/2 distances in condensed order (0-1, 0-2, ..., 1-2, ...).
+ * @return 0 on success, negative on error.
+ */
+int hamming_pairwise(const uint8_t* arena, int count, int stride, uint32_t* out);
+
+/**
+ * @brief Computes the Hamming distance of `pairs` random pairs of an arena.
+ * Pair indices are written to out_a/out_b when they are not NULL.
+ * @return 0 on success, negative on error.
+ */
+int hamming_sampled(const uint8_t* arena, int count, int stride, uint64_t pairs, uint64_t seed,
+                    uint32_t* out, uint32_t* out_a, uint32_t* out_b);
+
+/**
+ * @brief Computes summary diversity statistics for an arena.
+ * Distances are exact when sample_pairs is 0 or covers every pair, sampled otherwise.
+ * bit_entropy, when not NULL, receives stride*8 per-bit entropies (negative where a
+ * position is covered by fewer than two genomes).
+ * @return 0 on success, negative on error.
+ */
+int diversity_stats(const uint8_t* arena, const uint32_t* lengths, int count, int stride,
+                    uint64_t sample_pairs, uint64_t seed, double* bit_entropy, DiversityStats* out);
+
+// --- Novelty archive ---
+
+// Bounded archive of fixed-length behaviour descriptors (row-major float arrays)
+typedef struct NoveltyArchive NoveltyArchive;
+
+/**
+ * @brief Creates an archive of at most `capacity` descriptors of `dim` floats.
+ * @return The archive, or NULL on error. Free with novelty_archive_free.
+ */
+NoveltyArchive* novelty_archive_new(int dim, int capacity, uint64_t seed);
+
+void novelty_archive_free(NoveltyArchive* archive);
+
+int novelty_archive_size(const NoveltyArchive* archive);
+
+/**
+ * @brief Adds `count` descriptors. Once the archive is full, each new descriptor
+ * replaces a uniformly chosen existing one.
+ * @return The number of descriptors added, negative on error.
+ */
+int novelty_archive_add(NoveltyArchive* archive, const float* descriptors, int count);
+
+/**
+ * @brief Copies the archived descriptors into out (size * dim floats).
+ * @return The number of descriptors copied.
+ */
+int novelty_archive_get(const NoveltyArchive* archive, float* out);
+
+/**
+ * @brief Scores each descriptor of a population by its mean Euclidean distance to its
+ * k nearest neighbours among the archive and the rest of the population.
+ * A vantage-point tree is built over both sets for each call.
+ * @return 0 on success, negative on error.
+ */
+int novelty_scores(const NoveltyArchive* archive, const float* population, int count, int k, float* out_scores);
+
+// --- MAP-Elites archive ---
+
+#define MAP_ELITES_MAX_DIMS 8
+
+// Grid of elites keyed by bucketed behaviour features. Each cell keeps its best
+// genome in a contiguous store of `stride`-byte rows, like a population arena.
+typedef struct MapElites MapElites;
+
+/**
+ * @brief Creates a grid with `dims` feature axes. Axis d has bins[d] buckets
+ * spanning [lows[d], highs[d]); values outside are clamped to the edge buckets.
+ * Genomes longer than `stride` bytes are truncated when stored.
+ * @return The archive, or NULL on error. Free with map_elites_free.
+ */
+MapElites* map_elites_new(int dims, const int* bins, const double* lows, const double* highs,
+                          int stride, uint64_t seed);
+
+void map_elites_free(MapElites* archive);
+
+/**
+ * @brief Number of occupied cells.
+ */
+int map_elites_size(const MapElites* archive);
+
+/**
+ * @brief Offers a batch of evaluated genomes. Row i of `features` (dims doubles)
+ * selects the cell; the genome replaces the elite if the cell is empty or its
+ * score is higher. inserted[i], when not NULL, is set to 1 if genome i was kept.
+ * @return The number of genomes kept, negative on error.
+ */
+int map_elites_insert(MapElites* archive, const double* features, const double* scores,
+                      const uint8_t* arena, const uint32_t* lengths, int count, int arena_stride,
+                      uint8_t* inserted);
+
+/**
+ * @brief Draws `count` elites uniformly (with replacement) from the occupied cells
+ * into an arena of the archive's stride. out_cells, when not NULL, receives the cell indices.
+ * @return The number of elites drawn (0 if the archive is empty).
+ */
+int map_elites_sample(MapElites* archive, int count, uint8_t* out_arena, uint32_t* out_lengths,
+                      int32_t* out_cells);
+
+/**
+ * @brief Copies every elite out, in the order the cells were first filled.
+ * Each output may be NULL.
+ * @return The number of elites copied.
+ */
+int map_elites_export(const MapElites* archive, int32_t* out_cells, double* out_scores,
+                      uint8_t* out_arena, uint32_t* out_lengths);
+
+// --- Multi-objective selection ---
+
+// Objectives are row-major `count` x `m` doubles, all to be minimized.
+
+/**
+ * @brief Non-dominated sort for 2 or 3 objectives in O(N log N) (2) or close to it (3):
+ * points are visited in lexicographic order and binary searched into fronts, each
+ * front keeping a staircase of its last two objectives.
+ * out_rank receives the front index of each point, 0 being the Pareto front.
+ * @return The number of fronts, negative on error (including m outside 2..3).
+ */
+int nondominated_sort(const double* objectives, int count, int m, int32_t* out_rank);
+
+/**
+ * @brief NSGA-II crowding distance of each point within its front.
+ * Boundary points of each objective get INFINITY.
+ * @return 0 on success, negative on error.
+ */
+int crowding_distance(const double* objectives, const int32_t* ranks, int count, int m, double* out_distance);
+
+// --- Streaming score statistics ---
+
+// Count, sum, mean, variance (Welford) and extrema plus a KLL quantile sketch,
+// updated one value (or one batch) at a time so no list of scores has to be kept.
+typedef struct ScoreStats ScoreStats;
+
+typedef struct {
+    uint64_t count;
+    double mean;
+    double variance;  // Population variance, 0 when count < 2
+    double min;
+    double max;
+    double sum;       // Compensated (Neumaier) running sum, exact for integer scores below 2^53
+} ScoreSummary;
+
+#define SCORE_STATS_MAX_LEVELS 48
+
+/**
+ * @brief Creates an empty accumulator. `k` sets the sketch accuracy (rank error
+ * about 1.7 / k); the first k values are kept exactly.
+ * @return The accumulator, or NULL on error. Free with score_stats_free.
+ */
+ScoreStats* score_stats_new(int k, uint64_t seed);
+
+void score_stats_free(ScoreStats* stats);
+
+void score_stats_reset(ScoreStats* stats);
+
+/**
+ * @brief Adds one value.
+ * @return 0 on success, negative on error.
+ */
+int score_stats_add(ScoreStats* stats, double value);
+
+/**
+ * @brief Adds `count` values.
+ * @return 0 on success, negative on error.
+ */
+int score_stats_add_many(ScoreStats* stats, const double* values, int count);
+
+/**
+ * @brief Folds `other` into `stats`, e.g. to combine per-worker accumulators.
+ * Both must have been created with the same k.
+ * @return 0 on success, negative on error.
+ */
+int score_stats_merge(ScoreStats* stats, const ScoreStats* other);
+
+void score_stats_summary(const ScoreStats* stats, ScoreSummary* out);
+
+/**
+ * @brief Estimates the `n` quantiles qs[i] (each in [0, 1]) by nearest rank.
+ * q = 0 and q = 1 return the exact minimum and maximum.
+ * @return 0 on success, negative on error (including an empty accumulator).
+ */
+int score_stats_quantiles(const ScoreStats* stats, const double* qs, int n, double* out);
+
+// --- Hardware performance counters ---
+
+// Linux perf_event_open counters for the calling process (and, with inherit,
+// the threads and processes it starts afterwards), user space only.
+typedef struct PerfCounters PerfCounters;
+
+enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_BRANCHES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+/**
+ * @brief Opens one counter per PERF_COUNTER_* event, each on its own fd (inherited
+ * counters cannot be read as a group). Events the CPU or kernel does not offer are
+ * skipped. With `inherit`, counts of child threads and processes are included,
+ * those of processes once they exit.
+ * @param error Receives the errno of the first failure, may be NULL.
+ * @return The counters, or NULL when no event could be opened (including on
+ * non-Linux systems). Free with perf_counters_free.
+ */
+PerfCounters* perf_counters_open(int inherit, int* error);
+
+void perf_counters_free(PerfCounters* counters);
+
+/**
+ * @brief Bitmask of the opened events, bit i being PERF_COUNTER_* i.
+ */
+int perf_counters_available(const PerfCounters* counters);
+
+/**
+ * @brief Starts a measurement by taking a baseline reading.
+ * @return 0 on success, negative on error.
+ */
+int perf_counters_start(PerfCounters* counters);
+
+/**
+ * @brief Ends a measurement. out[i] receives the count of event i since
+ * perf_counters_start, scaled up when the kernel multiplexed the counter, or -1
+ * when the event is unavailable or never got scheduled.
+ * @return 0 on success, negative on error.
+ */
+int perf_counters_stop(PerfCounters* counters, int64_t out[PERF_COUNTER_COUNT]);
+
+// --- Syscall latency profile ---
+
+// Per syscall ID call counts and latency histograms in nanoseconds. Buckets are
+// HDR-style: exact below 2^SYSCALL_PROFILE_SUB_BITS, then each power of two is
+// split into 2^SYSCALL_PROFILE_SUB_BITS linear sub-buckets (relative error < 12.5%).
+// Recording is thread safe (atomic counters).
+typedef struct SyscallProfile SyscallProfile;
+
+enum {
+    SYSCALL_PROFILE_ROUNDTRIP,  // run_c returning for the syscall until run_c resumes
+    SYSCALL_PROFILE_HANDLER,    // The Python handler alone
+    SYSCALL_PROFILE_NATIVE,     // Handlers run in C
+    SYSCALL_PROFILE_KINDS
+};
+
+#define SYSCALL_PROFILE_IDS 256
+#define SYSCALL_PROFILE_SUB_BITS 3
+#define SYSCALL_PROFILE_BUCKETS ((64 - SYSCALL_PROFILE_SUB_BITS + 1) << SYSCALL_PROFILE_SUB_BITS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;  // UINT64_MAX when count is 0
+    uint64_t max_ns;
+} SyscallLatency;
+
+SyscallProfile* syscall_profile_new(void);
+
+void syscall_profile_free(SyscallProfile* profile);
+
+void syscall_profile_reset(SyscallProfile* profile);
+
+/**
+ * @brief Records one call of syscall `id` (0..255) taking `ns` nanoseconds.
+ * @return 0 on success, negative on error.
+ */
+int syscall_profile_record(SyscallProfile* profile, int kind, int id, uint64_t ns);
+
+/**
+ * @brief Makes run_c on the calling thread record SYSCALL_PROFILE_ROUNDTRIP
+ * latencies into `profile`, NULL to stop. Costs nothing per instruction and one
+ * clock read at each end of a syscall.
+ */
+void syscall_profile_activate(SyscallProfile* profile);
+
+/**
+ * @brief Count, total, min and max of one syscall ID and kind.
+ * @return 0 on success, negative on error.
+ */
+int syscall_profile_stats(const SyscallProfile* profile, int kind, int id, SyscallLatency* out);
+
+/**
+ * @brief Copies the histogram of one syscall ID and kind (SYSCALL_PROFILE_BUCKETS counts).
+ * @return 0 on success, negative on error.
+ */
+int syscall_profile_histogram(const SyscallProfile* profile, int kind, int id, uint64_t* out);
+
+/**
+ * @brief Bucket index of a latency, and the range [low, high] of a bucket.
+ */
+int syscall_profile_bucket_index(uint64_t ns);
+
+void syscall_profile_bucket_range(int index, uint64_t* low, uint64_t* high);
+
+/**
+ * @brief Estimates the `n` quantiles qs[i] (each in [0, 1]) of one syscall ID and
+ * kind as the midpoint of the bucket holding that rank, clamped to [min, max].
+ * @return 0 on success, negative on error (including no calls).
+ */
+int syscall_profile_quantiles(const SyscallProfile* profile, int kind, int id, const double* qs, int n, double* out);
+
+// --- VM context ---
+
+// State that lives next to a VMState across runs: the output buffer written by
+// the native PUTC handler of run_ctx, and optionally a target it is matched against.
+typedef struct VMContext VMContext;
+
+#define SYSCALL_PUTC 0x01
+
+// What PUTC does when the output buffer is full
+#define OUTPUT_OVERFLOW_TRUNCATE 0  // Keep the first `capacity` bytes, drop the rest
+#define OUTPUT_OVERFLOW_RING 1      // Keep the last `capacity` bytes
+#define OUTPUT_OVERFLOW_STOP 2      // Stop the VM with INTERRUPT_OUTPUT_FULL
+
+/**
+ * @brief Creates a context whose output buffer holds `output_capacity` bytes.
+ * @return The context, or NULL on error (including an unknown policy). Free with vm_context_free.
+ */
+VMContext* vm_context_new(uint32_t output_capacity, int overflow_policy);
+
+void vm_context_free(VMContext* ctx);
+
+/**
+ * @brief Empties the output buffer and clears the dropped count, for the next run.
+ */
+void vm_context_reset(VMContext* ctx);
+
+/**
+ * @brief Number of bytes PUTC was asked to write since the last reset, kept or not.
+ */
+uint64_t vm_context_output_total(const VMContext* ctx);
+
+/**
+ * @brief Copies the buffered output, oldest byte first, into `out` (at most `capacity` bytes).
+ * @return The number of bytes buffered (which may exceed `capacity`), negative on error.
+ */
+int vm_context_output(const VMContext* ctx, uint8_t* out, int capacity);
+
+/**
+ * @brief Writes the buffered output to file descriptor `fd` in one go and empties the buffer.
+ * @return The number of bytes written, negative on error.
+ */
+int vm_context_flush(VMContext* ctx, int fd);
+
+// How the output so far compares with the target, position by position
+typedef struct {
+    uint32_t matched;     // Output bytes equal to the target byte at their position
+    uint32_t prefix;      // Length of the correct prefix
+    uint32_t mismatches;  // Wrong bytes, including any beyond the end of the target
+} VMOutputMatch;
+
+/**
+ * @brief Makes PUTC compare the output against a copy of `target` as it is written.
+ * Once more than `max_mismatches` bytes were wrong the run stops with
+ * INTERRUPT_OUTPUT_DIVERGED. A NULL or empty target turns matching off.
+ * @return 0 on success, negative on error.
+ */
+int vm_context_set_target(VMContext* ctx, const uint8_t* target, uint32_t length, uint32_t max_mismatches);
+
+/**
+ * @brief The match counts of the output since the last reset.
+ * @return 0 on success, negative on error (including no target).
+ */
+int vm_context_match(const VMContext* ctx, VMOutputMatch* out);
+
+/**
+ * @brief run_c with the syscalls that have native handlers (PUTC) served in C.
+ * Returns like run_c, for any other syscall, halt or error.
+ */
+void run_ctx(VMContext* ctx, VMState* state, const uint8_t* program, int program_len, int max_steps);
+
+// --- Environments ---
+
+// A task programs are scored on, written in C so whole batches run without
+// Python. An environment is a vtable: `create` builds an immutable task from a
+// config blob (e.g. one maze) that every thread shares; each run gets
+// `run_size` bytes of run state that `reset` prepares and the syscall handlers
+// update; `score` and `describe` read it once the run has ended. New
+// environments can be built as shared objects exporting
+//     const VMEnvironment* vm_environment(void);
+// and loaded with vm_env_load. They only need this header, not vm_core.so.
+#define VM_ENV_ABI_VERSION 1
+#define VM_ENV_MAX_ENVIRONMENTS 32
+#define VM_ENV_MAX_DESCRIPTOR 32
+
+// What a syscall handler returns; a negative value stops the run with that interrupt
+#define VM_ENV_CONTINUE 0
+#define VM_ENV_EXIT 1  // Graceful exit, the exit code is registers[0]
+
+// How one program run ended
+typedef struct {
+    int64_t score;
+    int32_t exit_code;  // -1 unless the program exited gracefully
+    uint8_t halted;     // True unless the program exited gracefully
+    uint32_t syscalls;  // Syscalls issued, including the one that ended the run
+    double descriptor[VM_ENV_MAX_DESCRIPTOR];  // Behaviour descriptor, `descriptor_dims` values
+    VMState state;      // The runtime at the end; an unknown syscall leaves its ID in `interrupt`
+} VMEnvResult;
+
+typedef int (*VMEnvSyscall)(const void* task, void* run, VMState* state);
+
+typedef struct {
+    uint32_t abi_version;  // VM_ENV_ABI_VERSION
+    const char* name;
+    uint32_t run_size;     // Bytes of run state
+    int descriptor_dims;   // Values written by `describe`, at most VM_ENV_MAX_DESCRIPTOR
+    void* (*create)(const uint8_t* config, uint32_t config_len);  // NULL on a bad config
+    void (*destroy)(void* task);
+    void (*reset)(const void* task, void* run);  // The run state is not zeroed beforehand
+    // Handlers by syscall ID, NULL for unknown IDs. Without a handler of its own
+    // syscall 0 is EXIT.
+    VMEnvSyscall syscalls[256];
+    int64_t (*score)(const void* task, const void* run, const VMEnvResult* result);
+    void (*describe)(const void* task, const void* run, const VMEnvResult* result, double* out);  // May be NULL
+} VMEnvironment;
+
+typedef struct VMEnvTask VMEnvTask;
+
+/**
+ * @brief Adds an environment to the registry; the built-in "maze" and "putc" are always there.
+ * @return Its registry index, negative on error (ABI mismatch, duplicate name or full registry).
+ */
+int vm_env_register(const VMEnvironment* env);
+
+/**
+ * @brief dlopens a shared object and registers the environment its vm_environment() returns.
+ * @return Its registry index, negative on error.
+ */
+int vm_env_load(const char* path);
+
+int vm_env_count(void);
+
+/**
+ * @brief The registered environment at `index`, NULL when out of range.
+ */
+const VMEnvironment* vm_env_get(int index);
+
+/**
+ * @brief The registered environment called `name`, or NULL.
+ */
+const VMEnvironment* vm_env_find(const char* name);
+
+/**
+ * @brief Builds a task of `env` from its config. Free with vm_env_task_free.
+ * @return The task, or NULL if the config was rejected or on allocation failure.
+ */
+VMEnvTask* vm_env_task_new(const VMEnvironment* env, const uint8_t* config, uint32_t config_len);
+
+void vm_env_task_free(VMEnvTask* task);
+
+/**
+ * @brief Runs and scores `count` programs, program i being
+ * programs[offsets[i] .. offsets[i + 1]) on tasks[task_index[i]], on up to
+ * `threads` threads. Tasks are only read, so they can be reused across calls.
+ * @return 0 on success, negative on error.
+ */
+int vm_env_evaluate(VMEnvTask* const* tasks, int task_count, const int32_t* task_index, const uint8_t* programs,
+                    const int32_t* offsets, int count, int max_steps, int threads, VMEnvResult* out);
+
+// Config of the built-in "maze": height, width, start y, start x, finish y,
+// finish x (one byte each), then height * width cells row by row, non-zero for
+// a wall. Syscalls 0x10..0x13 move up, down, left, right; 0x14 and 0x15 put the
+// finish and player position (y, x) in R0 and R1. PUTC is accepted and ignored. The score and the
+// descriptor match maze_scorer.py and behaviour.maze_descriptor.
+#define MAZE_CONFIG_HEADER 6
+#define MAZE_MAX_CELLS (255 * 255)
+#define MAZE_DESCRIPTOR_DIMS 24
+#define MAZE_DESCRIPTOR_MAX_STEPS 500  // Step count of a run described as 1.0
+
+// Maze score weights, shared with maze_scorer.py
+#define MAZE_REWARD_FINISH 10000
+#define MAZE_REWARD_UNIQUE_CELL 50
+#define MAZE_REWARD_VALID_MOVE 5
+#define MAZE_PENALTY_STEP 1
+#define MAZE_PENALTY_HALT 100
+
+// Config of the built-in "putc": max mismatches (uint32, little endian), then
+// the target. Scored like output_scorer.py.
+#define PUTC_CONFIG_HEADER 4
+
+// Putc score weights, shared with output_scorer.py
+#define PUTC_REWARD_COMPLETE 10000
+#define PUTC_REWARD_PREFIX_CHAR 100
+#define PUTC_REWARD_MATCHED_CHAR 20
+#define PUTC_PENALTY_MISMATCH 50
+#define PUTC_REWARD_EXIT 10
+#define PUTC_PENALTY_HALT 100
+
+// --- Coverage-guided fuzzing ---
+
+// Edge coverage over (previous pc, pc) pairs, hashed into a map of wrapping
+// hit counts as in AFL. Programs are short, so a 4 KiB map keeps collisions
+// rare and is cheap to clear for every run.
+#define COVERAGE_MAP_BITS 12
+#define COVERAGE_MAP_SIZE (1 << COVERAGE_MAP_BITS)
+
+// What a run added to the virgin map
+#define COVERAGE_NONE 0
+#define COVERAGE_NEW_COUNT 1  // A seen edge in a new hit-count class
+#define COVERAGE_NEW_EDGE 2   // An edge never seen before
+
+/**
+ * @brief Runs `count` programs (as in vm_env_evaluate) on one task on the calling
+ * thread, recording the edge coverage of each. `virgin` is a COVERAGE_MAP_SIZE
+ * map of not yet seen hit-count classes, all 0xFF at the start of a campaign;
+ * out_new[i] is the COVERAGE_* value of program i, and its bits are cleared from
+ * `virgin` before the next program runs. Descriptors are not computed.
+ * @return The number of programs with new coverage, negative on error.
+ */
+int vm_env_fuzz(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+                uint8_t* virgin, uint8_t* out_new, VMEnvResult* out);
+
+/**
+ * @brief Number of edges seen in a virgin map, negative on error.
+ */
+int coverage_edges(const uint8_t* virgin);
+
+// Havoc stage: mutants are made from the corpus and run without leaving C, and
+// only the ones worth keeping are handed back
+#define FUZZ_MAX_PROGRAM 1024     // Bytes; mutations never grow a child past this
+#define FUZZ_HAVOC_STACK_POW2 4   // A child gets 2, 4, 8 or 16 stacked mutations
+#define FUZZ_OUTCOMES 528         // Exit codes 0..255, interrupts -1..-15, unknown syscalls 0..255
+
+typedef struct {
+    int32_t parent;    // Corpus index it was made from
+    int32_t execution; // Children run in this call before it
+    int32_t offset;    // The child is children[offset .. offset + length)
+    int32_t length;
+    int32_t outcome;   // fuzz_outcome_index of how it ended
+    uint8_t coverage;  // COVERAGE_* value; COVERAGE_NONE when only its outcome was new
+} VMFuzzFind;
+
+/**
+ * @brief How a run ended as a slot of the outcome counts of vm_env_fuzz_havoc,
+ * in [0, FUZZ_OUTCOMES): the exit code, 256 + -interrupt, or 272 + the unknown
+ * syscall ID. Negative on error.
+ */
+int fuzz_outcome_index(const VMEnvResult* result);
+
+/**
+ * @brief AFL-style havoc on the calling thread. Each of up to `executions`
+ * children starts as a corpus entry (entry i is corpus[offsets[i] .. offsets[i + 1]))
+ * picked as the least fuzzed of 4 sampled ones and counted in fuzzed[i]. With
+ * probability `splice_rate` its tail is replaced by another entry's. It then gets
+ * a stack of instruction-aligned mutations (bit flips, random and interesting
+ * bytes, byte arithmetic, instruction replacement, insertion, deletion,
+ * duplication and swaps) and runs with edge coverage as in vm_env_fuzz.
+ * outcome_counts (FUZZ_OUTCOMES slots) counts how runs ended. A child with new
+ * coverage or the first of its outcome is copied to `children` and described in
+ * `finds`. The call stops early at `max_finds` finds or when fewer than
+ * FUZZ_MAX_PROGRAM bytes of `children_capacity` are left. `rng` is the campaign's
+ * generator state, advanced in place.
+ * @return The number of finds, negative on error. *executed is set to the children run.
+ */
+int vm_env_fuzz_havoc(const VMEnvTask* task, const uint8_t* corpus, const int32_t* offsets, int corpus_count,
+                      uint32_t* fuzzed, int executions, int max_steps, double splice_rate, uint64_t* rng,
+                      uint8_t* virgin, uint64_t* outcome_counts, uint8_t* children, int children_capacity,
+                      VMFuzzFind* finds, int max_finds, int* executed);
+
+// --- Triage ---
+
+// Where and how a run ended: its interrupt (a syscall ID when it stopped on one,
+// 0 for EXIT), the pc of the instruction that raised it and that instruction's
+// opcode, 0xFF when the pc is past the end of the program
+typedef struct {
+    int16_t interrupt;
+    uint16_t pc;
+    uint8_t opcode;
+} VMCrashBucket;
+
+void crash_bucket(const VMState* state, const uint8_t* program, int program_len, VMCrashBucket* out);
+
+/**
+ * @brief Runs `count` programs (laid out as in vm_env_evaluate) on one task on up
+ * to `threads` threads, recording each one's crash bucket and, unless `traces`
+ * is NULL, its coverage with hit counts bucketed into classes (COVERAGE_MAP_SIZE
+ * bytes per program).
+ * @return 0 on success, negative on error.
+ */
+int vm_env_triage(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+                  int threads, uint8_t* traces, VMCrashBucket* buckets, VMEnvResult* out);
+
+/**
+ * @brief Picks a subset of programs with the same coverage as all of them, as
+ * afl-cmin does: for each (edge, hit-count class) the smallest program having
+ * it, skipping tuples already covered. Sets keep[i] to 1 for kept programs.
+ * @return The number kept, negative on error.
+ */
+int coverage_minimize(const uint8_t* traces, int count, const int32_t* sizes, uint8_t* keep);
+
+/**
+ * @brief Shrinks each program in place (program i starts at programs[offsets[i]]
+ * and is lengths[i] bytes long) while its crash bucket stays the same, on up to
+ * `threads` threads. lengths[i] is updated.
+ * @return 0 on success, negative on error.
+ */
+int vm_env_reduce(const VMEnvTask* task, uint8_t* programs, const int32_t* offsets, int32_t* lengths, int count,
+                  int max_steps, int threads);
+
+// --- Differential testing ---
+
+// Execution engines compared by vm_diff. Those below VM_DIFF_ENV run under a
+// fixed syscall model (EXIT stops, PUTC writes to a VMContext, every other
+// syscall returns at once) and are checked against VM_DIFF_RUN_C; the rest run
+// an environment task and are checked against VM_DIFF_ENV.
+#define VM_DIFF_RUN_C 0          // run_c
+#define VM_DIFF_COUNTERS 1       // run_c with VMCounters active
+#define VM_DIFF_DEBUG 2          // run_c single-stepping through INTERRUPT_DEBUG
+#define VM_DIFF_COVERAGE 3       // run_c recording edge coverage
+#define VM_DIFF_CONTEXT 4        // run_ctx, PUTC served natively
+#define VM_DIFF_ENV 5            // One environment run
+#define VM_DIFF_ENV_COVERAGE 6   // The same with edge coverage, as vm_env_fuzz and vm_env_triage
+#define VM_DIFF_ENV_BATCH 7      // vm_env_evaluate
+#define VM_DIFF_ENGINES 8
+#define VM_DIFF_OUTPUT_CAPACITY 64
+
+// What engines must agree on, bit for bit. The decoded-instruction fields of
+// `state` (op .. imm12) are cleared, as only the debug path writes them.
+typedef struct {
+    VMState state;
+    int64_t score;          // Environment engines
+    int32_t exit_code;      // -1 unless the program exited
+    uint32_t syscalls;      // PUTC not included for the model engines
+    uint64_t output_total;  // Model engines: PUTC calls
+    uint64_t output_hash;   // Model engines: hash of the last VM_DIFF_OUTPUT_CAPACITY bytes written
+} VMDiffOutcome;
+
+/**
+ * @brief Runs one program on one engine. `task` is needed by the environment
+ * engines only and may be NULL otherwise.
+ * @return 0 on success, negative on error.
+ */
+int vm_diff_run(int engine, const VMEnvTask* task, const uint8_t* program, int program_len, int max_steps,
+                VMDiffOutcome* out);
+
+/**
+ * @brief Runs every program (laid out as in vm_env_evaluate) on every engine on
+ * up to `threads` threads; with a NULL `task` only the model engines. Sets
+ * mismatch[i] to the mask of engines (1 << VM_DIFF_*) that disagreed with
+ * their reference on program i.
+ * @return The number of programs with a mismatch, negative on error.
+ */
+int vm_diff(const VMEnvTask* task, const uint8_t* programs, const int32_t* offsets, int count, int max_steps,
+            int threads, uint8_t* mismatch);
+
+/**
+ * @brief Shrinks a program in place while the same engines disagree, as
+ * vm_env_reduce does for crash buckets. A mismatch that does not reproduce on
+ * its own (e.g. one only seen in a threaded batch) leaves it unchanged.
+ * @return The new length, negative on error.
+ */
+int vm_diff_reduce(const VMEnvTask* task, uint8_t* program, int length, int max_steps, uint8_t engines);
 
 #endif // VM_CORE_H
\ No newline at end of file